@@ -0,0 +1,255 @@
+#include "assets.h"
+
+#include "profiler.h"
+#include "thread.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Loading mostly waits on the disk or on a parallel_for of the job system, which has its own threads for the work
+#define LOADER_COUNT 2
+
+enum AssetStage
+{
+  ASSET_STAGE_QUEUED,
+  ASSET_STAGE_LOADING,
+  ASSET_STAGE_LOADED, // Waiting for the main thread to upload it
+  ASSET_STAGE_READY,
+  ASSET_STAGE_FAILED
+};
+
+struct Asset
+{
+  AssetFunction load, upload;
+  void* data;
+  enum AssetStage stage;
+  struct Asset* next; // In the load queue while queued, in the upload queue while loaded
+};
+
+// A queue of assets that are linked through their next pointers
+struct AssetQueue
+{
+  struct Asset *head, *tail;
+};
+
+static Thread loaders[LOADER_COUNT];
+static uint32_t loader_count = 0;
+
+static Mutex mutex; // Guards the queues and the stages of all assets
+static Condition queued_condition, loaded_condition;
+static bool quitting = false;
+
+static struct AssetQueue load_queue = { NULL, NULL }, upload_queue = { NULL, NULL };
+
+static void push_asset(struct AssetQueue* queue, struct Asset* asset)
+{
+  asset->next = NULL;
+  if (queue->tail)
+  {
+    queue->tail->next = asset;
+  }
+  else
+  {
+    queue->head = asset;
+  }
+  queue->tail = asset;
+}
+
+static struct Asset* pop_asset(struct AssetQueue* queue)
+{
+  struct Asset* asset = queue->head;
+  if (asset)
+  {
+    queue->head = asset->next;
+    if (!queue->head)
+    {
+      queue->tail = NULL;
+    }
+  }
+
+  return asset;
+}
+
+// Takes the asset out of the queue wherever it is, it has to be in it
+static void remove_asset(struct AssetQueue* queue, struct Asset* asset)
+{
+  struct Asset* previous = NULL;
+  for (struct Asset* other = queue->head; other != asset; other = other->next)
+  {
+    previous = other;
+  }
+
+  if (previous)
+  {
+    previous->next = asset->next;
+  }
+  else
+  {
+    queue->head = asset->next;
+  }
+
+  if (queue->tail == asset)
+  {
+    queue->tail = previous;
+  }
+}
+
+static void loader_main(void* data)
+{
+  lock_mutex(&mutex);
+  for (;;)
+  {
+    while (!quitting && !load_queue.head)
+    {
+      wait_condition(&queued_condition, &mutex);
+    }
+
+    if (quitting)
+    {
+      break;
+    }
+
+    struct Asset* asset = pop_asset(&load_queue);
+    asset->stage = ASSET_STAGE_LOADING;
+    unlock_mutex(&mutex);
+
+    begin_cpu_zone(PROFILE_ZONE_LOAD_ASSET);
+    const bool loaded = asset->load(asset->data);
+    end_cpu_zone(PROFILE_ZONE_LOAD_ASSET);
+
+    lock_mutex(&mutex);
+    if (loaded && asset->upload)
+    {
+      asset->stage = ASSET_STAGE_LOADED;
+      push_asset(&upload_queue, asset);
+    }
+    else
+    {
+      asset->stage = loaded ? ASSET_STAGE_READY : ASSET_STAGE_FAILED;
+    }
+    broadcast_condition(&loaded_condition);
+  }
+  unlock_mutex(&mutex);
+}
+
+// Uploads an asset that was just taken out of the upload queue, the mutex is not held while it uploads
+static void upload_asset(struct Asset* asset)
+{
+  unlock_mutex(&mutex);
+  const bool uploaded = asset->upload(asset->data);
+  lock_mutex(&mutex);
+
+  asset->stage = uploaded ? ASSET_STAGE_READY : ASSET_STAGE_FAILED;
+}
+
+bool init_assets()
+{
+  init_mutex(&mutex);
+  init_condition(&queued_condition);
+  init_condition(&loaded_condition);
+
+  quitting = false;
+
+  for (loader_count = 0; loader_count < LOADER_COUNT; ++loader_count)
+  {
+    if (!start_thread(&loaders[loader_count], loader_main, NULL))
+    {
+      destroy_assets();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void destroy_assets()
+{
+  lock_mutex(&mutex);
+  quitting = true;
+  broadcast_condition(&queued_condition);
+  unlock_mutex(&mutex);
+
+  for (uint32_t loader = 0; loader < loader_count; ++loader)
+  {
+    join_thread(loaders[loader]);
+  }
+  loader_count = 0;
+
+  destroy_condition(&loaded_condition);
+  destroy_condition(&queued_condition);
+  destroy_mutex(&mutex);
+}
+
+struct Asset* request_asset(AssetFunction load, AssetFunction upload, void* data)
+{
+  struct Asset* asset = malloc(sizeof(struct Asset));
+  if (!asset)
+  {
+    printf("Ran out of memory while requesting an asset\n");
+    return NULL;
+  }
+
+  asset->load = load;
+  asset->upload = upload;
+  asset->data = data;
+  asset->stage = ASSET_STAGE_QUEUED;
+
+  lock_mutex(&mutex);
+  push_asset(&load_queue, asset);
+  signal_condition(&queued_condition);
+  unlock_mutex(&mutex);
+
+  return asset;
+}
+
+void release_asset(struct Asset* asset)
+{
+  lock_mutex(&mutex);
+  while (asset->stage == ASSET_STAGE_QUEUED || asset->stage == ASSET_STAGE_LOADING)
+  {
+    wait_condition(&loaded_condition, &mutex);
+  }
+
+  // Uploaded right away, so that whatever it uploads is cleaned up along with the rest of its data
+  if (asset->stage == ASSET_STAGE_LOADED)
+  {
+    remove_asset(&upload_queue, asset);
+    upload_asset(asset);
+  }
+  unlock_mutex(&mutex);
+
+  free(asset);
+}
+
+enum AssetState get_asset_state(struct Asset* asset)
+{
+  lock_mutex(&mutex);
+  const enum AssetStage stage = asset->stage;
+  unlock_mutex(&mutex);
+
+  if (stage == ASSET_STAGE_READY)
+  {
+    return ASSET_STATE_READY;
+  }
+
+  return stage == ASSET_STAGE_FAILED ? ASSET_STATE_FAILED : ASSET_STATE_LOADING;
+}
+
+void update_assets(uint64_t time_budget)
+{
+  const uint64_t start_time = get_profiler_time();
+
+  lock_mutex(&mutex);
+  do
+  {
+    struct Asset* asset = pop_asset(&upload_queue);
+    if (!asset)
+    {
+      break;
+    }
+
+    upload_asset(asset);
+  } while (get_profiler_time() - start_time < time_budget);
+  unlock_mutex(&mutex);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Loads assets in the background, the CPU work on loader threads and the OpenGL uploads on the main thread
+// An asset is whatever its functions fill in through their data, loading may take any time and must not touch OpenGL,
+// uploading should be quick as it is spread over the frames
+typedef bool (*AssetFunction)(void* data);
+
+struct Asset;
+
+enum AssetState
+{
+  ASSET_STATE_LOADING, // Waiting to be loaded or uploaded
+  ASSET_STATE_READY,
+  ASSET_STATE_FAILED // Loading or uploading returned false, the data holds whatever they left in it
+};
+
+bool init_assets();
+void destroy_assets(); // All assets have to be released first
+
+// Queues an asset, load runs on a loader thread and then upload, which may be NULL, on the main thread
+// Returns NULL if the asset could not even be queued
+struct Asset* request_asset(AssetFunction load, AssetFunction upload, void* data);
+
+// Waits for the asset to be loaded, uploads it if it still needs that, and frees the handle, but not the data
+// Call from the main thread
+void release_asset(struct Asset* asset);
+
+// The data of an asset can be used once it is ready, every change that loading and uploading made to it is visible
+enum AssetState get_asset_state(struct Asset* asset);
+
+// Uploads the assets that have been loaded since, in the order they were loaded in, until time_budget nanoseconds
+// have passed, but at least one of them, call from the main thread once per frame
+void update_assets(uint64_t time_budget);
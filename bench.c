@@ -0,0 +1,1002 @@
+// Collision and loading micro-benchmarks, built as the collie_bench target without any window or GPU dependencies
+// Usage: collie_bench [--json <file>] [--level <file>] [--max-triangles <count>]
+
+#include "bvh.h"
+#include "collision.h"
+#include "collision_mesh.h"
+#include "geometry_data.h"
+#include "jobs.h"
+#include "obj.h"
+
+#include <cglm/vec3.h>
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <time.h>
+#endif
+
+#ifdef __linux__
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+#define PAIR_TRIANGLE_COUNT 4096 // Triangles per pair workload, cycled through by the queries
+#define PAIR_QUERY_COUNT 65536
+#define SWEEP_QUERY_COUNT 4096
+#define MIN_BENCH_TIME 0.05 // Seconds, workloads are repeated until they took at least this long
+#define MAX_RESULT_COUNT 128
+#define LOAD_BENCH_PATH "load_bench.obj" // Written next to the benchmark and removed again
+
+#define PLAYER_RADIUS 0.75f
+#define PLAYER_HEIGHT 3.0f
+#define COLLISION_SKIN 0.01f
+
+enum Workload
+{
+  WORKLOAD_RANDOM,   // Spheres and capsules anywhere around the triangle
+  WORKLOAD_INTERIOR, // Penetrating the face of the triangle
+  WORKLOAD_GRAZING,  // Just touching or just missing an edge of the triangle
+  WORKLOAD_MISS,     // Close to the triangle, but not touching it
+  WORKLOAD_COUNT
+};
+
+static const char* workload_names[WORKLOAD_COUNT] = { "random", "interior", "grazing", "miss" };
+
+struct BenchResult
+{
+  char name[64];
+  char workload[32];
+  uint32_t triangle_count;
+  uint64_t query_count;
+  double ns_per_query;
+  double queries_per_second;
+  double cache_misses; // Per query, negative if there are no perf counters
+  double cache_references;
+  uint64_t hits; // Keeps the compiler from dropping the work, and shows that the workloads do what they say
+};
+
+static struct BenchResult results[MAX_RESULT_COUNT];
+static uint32_t result_count = 0;
+
+static uint32_t random_state = 0x12345678u;
+
+static float random_float(float min, float max)
+{
+  // xorshift32
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return min + (max - min) * (float)(random_state >> 8) / (float)(1u << 24);
+}
+
+static void random_unit_vector(vec3 v)
+{
+  do
+  {
+    v[0] = random_float(-1.0f, 1.0f);
+    v[1] = random_float(-1.0f, 1.0f);
+    v[2] = random_float(-1.0f, 1.0f);
+  } while (glm_vec3_norm2(v) < 0.01f || glm_vec3_norm2(v) > 1.0f);
+
+  glm_vec3_normalize(v);
+}
+
+static double get_seconds()
+{
+#ifdef _WIN32
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+// Hardware cache counters, only available on Linux and only if the kernel allows it
+struct PerfCounters
+{
+  int misses_fd;
+  int references_fd;
+};
+
+#ifdef __linux__
+static int open_perf_counter(uint64_t config, int group_fd)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = config;
+  attr.disabled = group_fd < 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+static void open_perf_counters(struct PerfCounters* counters)
+{
+  counters->misses_fd = -1;
+  counters->references_fd = -1;
+
+#ifdef __linux__
+  counters->misses_fd = open_perf_counter(PERF_COUNT_HW_CACHE_MISSES, -1);
+  if (counters->misses_fd >= 0)
+  {
+    counters->references_fd = open_perf_counter(PERF_COUNT_HW_CACHE_REFERENCES, counters->misses_fd);
+  }
+#endif
+}
+
+static void close_perf_counters(struct PerfCounters* counters)
+{
+#ifdef __linux__
+  if (counters->references_fd >= 0)
+  {
+    close(counters->references_fd);
+  }
+
+  if (counters->misses_fd >= 0)
+  {
+    close(counters->misses_fd);
+  }
+#endif
+}
+
+static void start_perf_counters(const struct PerfCounters* counters)
+{
+#ifdef __linux__
+  if (counters->misses_fd >= 0)
+  {
+    ioctl(counters->misses_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counters->misses_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+#else
+  (void)counters;
+#endif
+}
+
+static void stop_perf_counters(const struct PerfCounters* counters, int64_t* misses, int64_t* references)
+{
+  *misses = -1;
+  *references = -1;
+
+#ifdef __linux__
+  if (counters->misses_fd >= 0)
+  {
+    ioctl(counters->misses_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    uint64_t value;
+    if (read(counters->misses_fd, &value, sizeof(value)) == sizeof(value))
+    {
+      *misses = (int64_t)value;
+    }
+
+    if (counters->references_fd >= 0 && read(counters->references_fd, &value, sizeof(value)) == sizeof(value))
+    {
+      *references = (int64_t)value;
+    }
+  }
+#else
+  (void)counters;
+#endif
+}
+
+// Runs a benchmark function until it took long enough and records its result
+// The function runs all queries once and returns how many of them hit
+typedef uint64_t (*BenchFunction)(void* data);
+
+static void run_bench(const char* name,
+                      const char* workload,
+                      uint32_t triangle_count,
+                      uint32_t query_count,
+                      BenchFunction function,
+                      void* data)
+{
+  if (result_count >= MAX_RESULT_COUNT)
+  {
+    printf("Too many benchmark results, skipping %s (%s)\n", name, workload);
+    return;
+  }
+
+  // Warm up the caches and the branch predictors
+  function(data);
+
+  struct PerfCounters counters;
+  open_perf_counters(&counters);
+  start_perf_counters(&counters);
+
+  uint64_t runs = 0, hits = 0;
+  const double start = get_seconds();
+  double elapsed;
+  do
+  {
+    hits += function(data);
+    ++runs;
+    elapsed = get_seconds() - start;
+  } while (elapsed < MIN_BENCH_TIME);
+
+  int64_t misses, references;
+  stop_perf_counters(&counters, &misses, &references);
+  close_perf_counters(&counters);
+
+  struct BenchResult* result = &results[result_count++];
+  snprintf(result->name, sizeof(result->name), "%s", name);
+  snprintf(result->workload, sizeof(result->workload), "%s", workload);
+  result->triangle_count = triangle_count;
+  result->query_count = runs * query_count;
+  result->ns_per_query = elapsed * 1e9 / (double)result->query_count;
+  result->queries_per_second = (double)result->query_count / elapsed;
+  result->cache_misses = misses >= 0 ? (double)misses / (double)result->query_count : -1.0;
+  result->cache_references = references >= 0 ? (double)references / (double)result->query_count : -1.0;
+  result->hits = hits / runs;
+
+  printf("%-28s %-10s %8u tris %10.1f ns/query %12.0f queries/s %6.1f%% hits", result->name, result->workload,
+         result->triangle_count, result->ns_per_query, result->queries_per_second,
+         100.0 * (double)result->hits / (double)query_count);
+  if (result->cache_misses >= 0)
+  {
+    printf(" %8.3f cache misses/query", result->cache_misses);
+  }
+  printf("\n");
+}
+
+static bool write_json(const char* path)
+{
+  FILE* file = fopen(path, "w");
+  if (!file)
+  {
+    printf("Failed to open benchmark output file \"%s\"\n", path);
+    return false;
+  }
+
+  fprintf(file, "{\n  \"batch_isa\": \"%s\",\n  \"results\": [\n", get_batch_collision_isa());
+  for (uint32_t index = 0; index < result_count; ++index)
+  {
+    const struct BenchResult* result = &results[index];
+    fprintf(file,
+            "    { \"name\": \"%s\", \"workload\": \"%s\", \"triangles\": %u, \"queries\": %llu, "
+            "\"ns_per_query\": %.3f, \"queries_per_second\": %.1f, ",
+            result->name, result->workload, result->triangle_count, (unsigned long long)result->query_count,
+            result->ns_per_query, result->queries_per_second);
+
+    if (result->cache_misses >= 0)
+    {
+      fprintf(file, "\"cache_misses_per_query\": %.4f, ", result->cache_misses);
+    }
+    else
+    {
+      fprintf(file, "\"cache_misses_per_query\": null, ");
+    }
+
+    if (result->cache_references >= 0)
+    {
+      fprintf(file, "\"cache_references_per_query\": %.4f }", result->cache_references);
+    }
+    else
+    {
+      fprintf(file, "\"cache_references_per_query\": null }");
+    }
+
+    fprintf(file, index + 1 < result_count ? ",\n" : "\n");
+  }
+  fprintf(file, "  ]\n}\n");
+
+  fclose(file);
+  return true;
+}
+
+// Pair workloads: one sphere or capsule against one triangle per query
+
+struct PairQuery
+{
+  vec3 base, tip; // The same for spheres, which are at base
+  float radius;
+  uint32_t triangle;
+};
+
+struct PairBench
+{
+  struct CollisionMesh* mesh;
+  struct PairQuery* queries;
+  struct CapsuleQuery* capsule_queries;
+};
+
+// Places a sphere center relative to a triangle for the given workload
+static void place_sphere(enum Workload workload,
+                         const vec3 v0,
+                         const vec3 v1,
+                         const vec3 v2,
+                         const vec3 n,
+                         float radius,
+                         vec3 center)
+{
+  // A random point inside the triangle
+  float u = random_float(0.0f, 1.0f), v = random_float(0.0f, 1.0f);
+  if (u + v > 1.0f)
+  {
+    u = 1.0f - u;
+    v = 1.0f - v;
+  }
+
+  vec3 inside;
+  glm_vec3_copy((float*)v0, inside);
+  glm_vec3_muladds((vec3){ v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2] }, u, inside);
+  glm_vec3_muladds((vec3){ v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2] }, v, inside);
+
+  switch (workload)
+  {
+  case WORKLOAD_RANDOM:
+  {
+    vec3 offset;
+    random_unit_vector(offset);
+    glm_vec3_copy(inside, center);
+    glm_vec3_muladds(offset, random_float(0.0f, 2.0f * radius), center);
+    break;
+  }
+  case WORKLOAD_INTERIOR:
+  {
+    glm_vec3_copy(inside, center);
+    glm_vec3_muladds((float*)n, random_float(-0.5f, 0.5f) * radius, center);
+    break;
+  }
+  case WORKLOAD_GRAZING:
+  {
+    // Move out from a point on an edge, perpendicular to it within the plane of the triangle, to just about the radius
+    const float t = random_float(0.0f, 1.0f);
+
+    vec3 edge_point, edge, away;
+    glm_vec3_lerp((float*)v0, (float*)v1, t, edge_point);
+    glm_vec3_sub((float*)v1, (float*)v0, edge);
+    glm_vec3_normalize(edge);
+    glm_vec3_cross(edge, (float*)n, away);
+    if (glm_vec3_dot(away, (vec3){ v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2] }) > 0.0f)
+    {
+      glm_vec3_negate(away);
+    }
+
+    glm_vec3_copy(edge_point, center);
+    glm_vec3_muladds(away, radius * random_float(0.999f, 1.001f), center);
+    break;
+  }
+  case WORKLOAD_MISS:
+  default:
+  {
+    glm_vec3_copy(inside, center);
+    glm_vec3_muladds((float*)n, (random_float(0.0f, 1.0f) < 0.5f ? -1.0f : 1.0f) * radius * random_float(1.1f, 2.0f),
+                     center);
+    break;
+  }
+  }
+}
+
+static bool make_pair_bench(enum Workload workload, bool capsules, struct PairBench* bench)
+{
+  // Random, roughly unit sized triangles spread out through space
+  float* vertices = malloc(sizeof(float) * 3 * 3 * PAIR_TRIANGLE_COUNT);
+  uint32_t* indices = malloc(sizeof(uint32_t) * 3 * PAIR_TRIANGLE_COUNT);
+  bench->queries = malloc(sizeof(struct PairQuery) * PAIR_QUERY_COUNT);
+  bench->capsule_queries = malloc(sizeof(struct CapsuleQuery) * PAIR_QUERY_COUNT);
+  if (!vertices || !indices || !bench->queries || !bench->capsule_queries)
+  {
+    printf("Ran out of memory while generating benchmark workload\n");
+    free(vertices);
+    free(indices);
+    free(bench->queries);
+    free(bench->capsule_queries);
+    return false;
+  }
+
+  for (uint32_t triangle = 0; triangle < PAIR_TRIANGLE_COUNT; ++triangle)
+  {
+    const vec3 center = { random_float(-100.0f, 100.0f), random_float(-100.0f, 100.0f), random_float(-100.0f, 100.0f) };
+    for (uint32_t corner = 0; corner < 3; ++corner)
+    {
+      vec3 offset;
+      random_unit_vector(offset);
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        vertices[(triangle * 3 + corner) * 3 + axis] = center[axis] + offset[axis];
+      }
+      indices[triangle * 3 + corner] = triangle * 3 + corner;
+    }
+  }
+
+  bench->mesh = make_collision_mesh(vertices, 3, indices, PAIR_TRIANGLE_COUNT * 3);
+  free(vertices);
+  free(indices);
+  if (!bench->mesh)
+  {
+    free(bench->queries);
+    free(bench->capsule_queries);
+    return false;
+  }
+
+  for (uint32_t query = 0; query < PAIR_QUERY_COUNT; ++query)
+  {
+    struct PairQuery* q = &bench->queries[query];
+    q->triangle = query % bench->mesh->triangle_count;
+    q->radius = random_float(0.1f, 0.5f);
+
+    vec3 v0, v1, v2, n;
+    get_collision_triangle(bench->mesh, q->triangle, v0, v1, v2, n);
+    place_sphere(workload, v0, v1, v2, n, q->radius, q->base);
+
+    glm_vec3_copy(q->base, q->tip);
+    if (capsules)
+    {
+      // The placed sphere is the lower end of the capsule, which points away from the side of the triangle it is on
+      vec3 axis, offset;
+      random_unit_vector(axis);
+      glm_vec3_sub(q->base, v0, offset);
+      if ((glm_vec3_dot(axis, n) < 0.0f) != (glm_vec3_dot(offset, n) < 0.0f))
+      {
+        glm_vec3_negate(axis);
+      }
+
+      const float height = random_float(3.0f, 6.0f) * q->radius;
+      glm_vec3_muladds(axis, -q->radius, q->base);
+      glm_vec3_copy(q->base, q->tip);
+      glm_vec3_muladds(axis, height, q->tip);
+    }
+
+    make_capsule_query(q->base, q->tip, q->radius, &bench->capsule_queries[query]);
+  }
+
+  return true;
+}
+
+static void destroy_pair_bench(struct PairBench* bench)
+{
+  destroy_collision_mesh(bench->mesh);
+  free(bench->queries);
+  free(bench->capsule_queries);
+}
+
+static uint64_t bench_sphere_triangle(void* data)
+{
+  const struct PairBench* bench = data;
+
+  uint64_t hits = 0;
+  for (uint32_t query = 0; query < PAIR_QUERY_COUNT; ++query)
+  {
+    struct PairQuery* q = &bench->queries[query];
+
+    vec3 v0, v1, v2, n, pen_normal;
+    float pen_depth;
+    get_collision_triangle(bench->mesh, q->triangle, v0, v1, v2, n);
+    hits += sphere_triangle_collision(q->base, q->radius, v0, v1, v2, n, pen_normal, &pen_depth);
+  }
+
+  return hits;
+}
+
+static uint64_t bench_capsule_triangle(void* data)
+{
+  const struct PairBench* bench = data;
+
+  uint64_t hits = 0;
+  for (uint32_t query = 0; query < PAIR_QUERY_COUNT; ++query)
+  {
+    struct PairQuery* q = &bench->queries[query];
+
+    vec3 v0, v1, v2, n, pen_normal;
+    float pen_depth;
+    get_collision_triangle(bench->mesh, q->triangle, v0, v1, v2, n);
+    hits += capsule_triangle_collision(q->base, q->tip, q->radius, v0, v1, v2, n, pen_normal, &pen_depth);
+  }
+
+  return hits;
+}
+
+// Tests each capsule against a batch of its own triangle and the next ones, and counts a hit for its own lane only
+static uint64_t bench_capsule_triangle_batch(void* data)
+{
+  const struct PairBench* bench = data;
+
+  struct TriangleBatch batch;
+  float pen_normals[3][COLLISION_BATCH_SIZE], pen_depths[COLLISION_BATCH_SIZE];
+
+  uint64_t hits = 0;
+  for (uint32_t query = 0; query < PAIR_QUERY_COUNT; query += COLLISION_BATCH_SIZE)
+  {
+    uint32_t triangles[COLLISION_BATCH_SIZE];
+    for (uint32_t lane = 0; lane < COLLISION_BATCH_SIZE; ++lane)
+    {
+      triangles[lane] = bench->queries[query + lane].triangle;
+    }
+    get_collision_triangle_batch(bench->mesh, triangles, COLLISION_BATCH_SIZE, &batch);
+
+    for (uint32_t lane = 0; lane < COLLISION_BATCH_SIZE; ++lane)
+    {
+      const uint32_t mask = capsule_triangle_batch_collision(&bench->capsule_queries[query + lane], &batch,
+                                                             COLLISION_BATCH_SIZE, pen_normals, pen_depths);
+      hits += (mask >> lane) & 1u;
+    }
+  }
+
+  return hits;
+}
+
+static void run_pair_benches()
+{
+  for (int workload = 0; workload < WORKLOAD_COUNT; ++workload)
+  {
+    struct PairBench bench;
+    if (make_pair_bench((enum Workload)workload, false, &bench))
+    {
+      run_bench("sphere_triangle_collision", workload_names[workload], 1, PAIR_QUERY_COUNT, bench_sphere_triangle,
+                &bench);
+      destroy_pair_bench(&bench);
+    }
+
+    if (make_pair_bench((enum Workload)workload, true, &bench))
+    {
+      run_bench("capsule_triangle_collision", workload_names[workload], 1, PAIR_QUERY_COUNT, bench_capsule_triangle,
+                &bench);
+
+      // Every query tests a whole batch, so this is per batch of COLLISION_BATCH_SIZE triangles
+      run_bench("capsule_triangle_batch", workload_names[workload], COLLISION_BATCH_SIZE, PAIR_QUERY_COUNT,
+                bench_capsule_triangle_batch, &bench);
+      destroy_pair_bench(&bench);
+    }
+  }
+}
+
+// Sweep workloads: the player update against a whole level, a capsule swept through the BVH and then pushed out
+
+struct SweepQuery
+{
+  vec3 base;
+  vec3 motion;
+};
+
+struct SweepBench
+{
+  struct CollisionMesh* mesh;
+  struct Bvh* bvh;
+  struct SweepQuery* queries;
+  uint32_t* candidates;
+  uint32_t candidate_capacity;
+};
+
+// Builds the collision mesh and BVH like the level does, with the triangles in BVH leaf order
+static bool make_level_collision(const float* vertices,
+                                 uint32_t floats_per_vertex,
+                                 const uint32_t* indices,
+                                 uint32_t index_count,
+                                 struct SweepBench* bench)
+{
+  bench->mesh = make_collision_mesh(vertices, floats_per_vertex, indices, index_count);
+  if (!bench->mesh)
+  {
+    return false;
+  }
+
+  bench->bvh = make_bvh((const vec3*)bench->mesh->mins, (const vec3*)bench->mesh->maxs, bench->mesh->triangle_count);
+  if (!bench->bvh)
+  {
+    destroy_collision_mesh(bench->mesh);
+    return false;
+  }
+
+  if (!reorder_collision_mesh(bench->mesh, bench->bvh->primitives))
+  {
+    destroy_bvh(bench->bvh);
+    destroy_collision_mesh(bench->mesh);
+    return false;
+  }
+
+  for (uint32_t primitive = 0; primitive < bench->bvh->primitive_count; ++primitive)
+  {
+    bench->bvh->primitives[primitive] = primitive;
+  }
+
+  bench->queries = NULL;
+  bench->candidates = NULL;
+  bench->candidate_capacity = 0;
+
+  return true;
+}
+
+static void destroy_sweep_bench(struct SweepBench* bench)
+{
+  free(bench->candidates);
+  free(bench->queries);
+  destroy_bvh(bench->bvh);
+  destroy_collision_mesh(bench->mesh);
+}
+
+// Places player-sized capsules in the bounds of the mesh, moving the distance of a few frames in a random direction
+static bool make_sweep_queries(struct SweepBench* bench)
+{
+  bench->queries = malloc(sizeof(struct SweepQuery) * SWEEP_QUERY_COUNT);
+  if (!bench->queries)
+  {
+    printf("Ran out of memory while generating sweep queries\n");
+    return false;
+  }
+
+  vec3 min, max;
+  glm_vec3_copy(bench->bvh->nodes[0].min, min);
+  glm_vec3_copy(bench->bvh->nodes[0].max, max);
+
+  for (uint32_t query = 0; query < SWEEP_QUERY_COUNT; ++query)
+  {
+    struct SweepQuery* q = &bench->queries[query];
+    q->base[0] = random_float(min[0], max[0]);
+    q->base[1] = random_float(min[1], max[1] + 1.0f);
+    q->base[2] = random_float(min[2], max[2]);
+
+    q->motion[0] = random_float(-1.0f, 1.0f);
+    q->motion[1] = -0.1f;
+    q->motion[2] = random_float(-1.0f, 1.0f);
+    glm_vec3_scale_as(q->motion, random_float(0.1f, 1.0f), q->motion);
+  }
+
+  return true;
+}
+
+static uint32_t gather_sweep_candidates(struct SweepBench* bench, const vec3 min, const vec3 max)
+{
+  uint32_t count = query_bvh(bench->bvh, min, max, bench->candidates, bench->candidate_capacity);
+  if (count > bench->candidate_capacity)
+  {
+    uint32_t* candidates = realloc(bench->candidates, sizeof(uint32_t) * count);
+    if (!candidates)
+    {
+      printf("Ran out of memory while gathering %u sweep candidates\n", count);
+      return 0;
+    }
+
+    bench->candidates = candidates;
+    bench->candidate_capacity = count;
+    count = query_bvh(bench->bvh, min, max, bench->candidates, bench->candidate_capacity);
+  }
+
+  return count;
+}
+
+static uint64_t bench_level_sweep(void* data)
+{
+  struct SweepBench* bench = data;
+
+  struct TriangleBatch batch;
+  float pen_normals[3][COLLISION_BATCH_SIZE], pen_depths[COLLISION_BATCH_SIZE];
+
+  uint64_t hits = 0;
+  for (uint32_t query = 0; query < SWEEP_QUERY_COUNT; ++query)
+  {
+    const struct SweepQuery* q = &bench->queries[query];
+
+    vec3 base, tip;
+    glm_vec3_copy((float*)q->base, base);
+    glm_vec3_copy(base, tip);
+    tip[1] += PLAYER_HEIGHT;
+
+    // Sweep
+    vec3 min, max;
+    glm_vec3_minv(base, tip, min);
+    glm_vec3_maxv(base, tip, max);
+    glm_vec3_adds(min, -(PLAYER_RADIUS + 2.0f * COLLISION_SKIN), min);
+    glm_vec3_adds(max, PLAYER_RADIUS + 2.0f * COLLISION_SKIN, max);
+    {
+      vec3 end_min, end_max;
+      glm_vec3_add(min, (float*)q->motion, end_min);
+      glm_vec3_add(max, (float*)q->motion, end_max);
+      glm_vec3_minv(min, end_min, min);
+      glm_vec3_maxv(max, end_max, max);
+    }
+
+    float toi = 1.0f;
+    bool hit = false;
+    uint32_t count = gather_sweep_candidates(bench, min, max);
+    for (uint32_t candidate = 0; candidate < count; ++candidate)
+    {
+      vec3 v0, v1, v2, n, hit_normal;
+      float triangle_toi;
+      get_collision_triangle(bench->mesh, bench->candidates[candidate], v0, v1, v2, n);
+      if (capsule_triangle_sweep(base, tip, PLAYER_RADIUS, (float*)q->motion, COLLISION_SKIN, v0, v1, v2, n,
+                                 &triangle_toi, hit_normal) &&
+          triangle_toi < toi)
+      {
+        toi = triangle_toi;
+        hit = true;
+      }
+    }
+
+    glm_vec3_muladds((float*)q->motion, toi, base);
+    glm_vec3_muladds((float*)q->motion, toi, tip);
+
+    // Push out, against the batched kernel like the player does
+    glm_vec3_minv(base, tip, min);
+    glm_vec3_maxv(base, tip, max);
+    glm_vec3_adds(min, -PLAYER_RADIUS, min);
+    glm_vec3_adds(max, PLAYER_RADIUS, max);
+    count = gather_sweep_candidates(bench, min, max);
+
+    struct CapsuleQuery capsule_query;
+    make_capsule_query(base, tip, PLAYER_RADIUS, &capsule_query);
+    for (uint32_t candidate = 0; candidate < count; candidate += COLLISION_BATCH_SIZE)
+    {
+      const uint32_t remaining = count - candidate;
+      const uint32_t batch_count = remaining < COLLISION_BATCH_SIZE ? remaining : COLLISION_BATCH_SIZE;
+      get_collision_triangle_batch(bench->mesh, &bench->candidates[candidate], batch_count, &batch);
+      hit |= capsule_triangle_batch_collision(&capsule_query, &batch, batch_count, pen_normals, pen_depths) != 0;
+    }
+
+    hits += hit;
+  }
+
+  return hits;
+}
+
+// Builds a bumpy grid with roughly the given number of triangles
+static bool make_grid_bench(uint32_t triangle_count, struct SweepBench* bench)
+{
+  const uint32_t cells = (uint32_t)ceilf(sqrtf((float)triangle_count * 0.5f));
+  const uint32_t vertex_count = (cells + 1) * (cells + 1);
+  const uint32_t index_count = cells * cells * 6;
+
+  float* vertices = malloc(sizeof(float) * 3 * vertex_count);
+  uint32_t* indices = malloc(sizeof(uint32_t) * index_count);
+  if (!vertices || !indices)
+  {
+    printf("Ran out of memory while generating a grid with %u triangles\n", triangle_count);
+    free(vertices);
+    free(indices);
+    return false;
+  }
+
+  // One unit per cell, like the level, with some height variation to make the sweeps hit at varying angles
+  for (uint32_t z = 0; z <= cells; ++z)
+  {
+    for (uint32_t x = 0; x <= cells; ++x)
+    {
+      float* vertex = &vertices[(z * (cells + 1) + x) * 3];
+      vertex[0] = (float)x;
+      vertex[1] = sinf((float)x * 0.7f) * cosf((float)z * 0.4f) + random_float(-0.1f, 0.1f);
+      vertex[2] = (float)z;
+    }
+  }
+
+  uint32_t* index = indices;
+  for (uint32_t z = 0; z < cells; ++z)
+  {
+    for (uint32_t x = 0; x < cells; ++x)
+    {
+      const uint32_t v00 = z * (cells + 1) + x;
+      const uint32_t v10 = v00 + 1;
+      const uint32_t v01 = v00 + cells + 1;
+      const uint32_t v11 = v01 + 1;
+      *index++ = v00;
+      *index++ = v01;
+      *index++ = v10;
+      *index++ = v10;
+      *index++ = v01;
+      *index++ = v11;
+    }
+  }
+
+  const bool success = make_level_collision(vertices, 3, indices, index_count, bench);
+  free(vertices);
+  free(indices);
+
+  return success && make_sweep_queries(bench);
+}
+
+static void run_sweep_benches(const char* level_path, uint32_t max_triangles)
+{
+  // The actual level
+  {
+    struct Geometry* level = load_obj(level_path, GEOMETRY_TYPE_TRIS);
+    if (level)
+    {
+      // The collision mesh spans all submeshes, so it needs indices into the whole vertex buffer
+      uint32_t* indices =
+        make_absolute_indices(level->indices, level->index_count, level->submeshes, level->submesh_count);
+
+      struct SweepBench bench;
+      const bool success =
+        indices && make_level_collision(level->vertices, level->floats_per_vertex, indices, level->index_count, &bench);
+      free(indices);
+      free_geometry(level);
+
+      if (success)
+      {
+        if (make_sweep_queries(&bench))
+        {
+          run_bench("level_sweep", "level", bench.mesh->triangle_count, SWEEP_QUERY_COUNT, bench_level_sweep, &bench);
+        }
+        destroy_sweep_bench(&bench);
+      }
+    }
+  }
+
+  // Scaling the triangle count
+  for (uint32_t triangle_count = 100; triangle_count <= max_triangles; triangle_count *= 10)
+  {
+    struct SweepBench bench;
+    if (make_grid_bench(triangle_count, &bench))
+    {
+      run_bench("level_sweep", "grid", bench.mesh->triangle_count, SWEEP_QUERY_COUNT, bench_level_sweep, &bench);
+      destroy_sweep_bench(&bench);
+    }
+  }
+}
+
+// Load workloads: a whole OBJ file read into CPU memory, by the native parser and imported through assimp
+
+static uint64_t bench_load_obj(void* data)
+{
+  struct Geometry* geometry = load_obj(data, GEOMETRY_TYPE_TRIS);
+  if (!geometry)
+  {
+    return 0;
+  }
+
+  free_geometry(geometry);
+  return 1;
+}
+
+static uint64_t bench_import_geometry(void* data)
+{
+  struct Geometry* geometry = import_geometry(data, GEOMETRY_TYPE_TRIS);
+  if (!geometry)
+  {
+    return 0;
+  }
+
+  free_geometry(geometry);
+  return 1;
+}
+
+// Writes a bumpy grid with roughly the given number of triangles as an OBJ file with positions, UVs and normals
+static bool write_grid_obj(const char* path, uint32_t triangle_count)
+{
+  FILE* file = fopen(path, "w");
+  if (!file)
+  {
+    printf("Failed to open benchmark file \"%s\" for writing\n", path);
+    return false;
+  }
+
+  const uint32_t cells = (uint32_t)ceilf(sqrtf((float)triangle_count * 0.5f));
+  for (uint32_t z = 0; z <= cells; ++z)
+  {
+    for (uint32_t x = 0; x <= cells; ++x)
+    {
+      fprintf(file, "v %f %f %f\n", (float)x, random_float(-0.25f, 0.25f), (float)z);
+      fprintf(file, "vt %f %f\n", (float)x / (float)cells, (float)z / (float)cells);
+
+      vec3 normal;
+      random_unit_vector(normal);
+      fprintf(file, "vn %f %f %f\n", normal[0], normal[1], normal[2]);
+    }
+  }
+
+  for (uint32_t z = 0; z < cells; ++z)
+  {
+    for (uint32_t x = 0; x < cells; ++x)
+    {
+      const uint32_t v00 = z * (cells + 1) + x + 1; // 1-based
+      const uint32_t v10 = v00 + 1;
+      const uint32_t v01 = v00 + cells + 1;
+      const uint32_t v11 = v01 + 1;
+      fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", v00, v00, v00, v01, v01, v01, v11, v11, v11, v10, v10,
+              v10);
+    }
+  }
+
+  const bool success = !ferror(file);
+  if (fclose(file) != 0 || !success)
+  {
+    printf("Failed to write benchmark file \"%s\"\n", path);
+    return false;
+  }
+
+  return true;
+}
+
+static void run_load_bench(const char* path, const char* workload)
+{
+  struct Geometry* geometry = load_obj(path, GEOMETRY_TYPE_TRIS);
+  if (!geometry)
+  {
+    return;
+  }
+
+  const uint32_t triangle_count = geometry->index_count / 3;
+  free_geometry(geometry);
+
+  run_bench("load_obj", workload, triangle_count, 1, bench_load_obj, (void*)path);
+
+  // Check once that assimp can load it as well, rather than failing over and over while benchmarking
+  if (bench_import_geometry((void*)path))
+  {
+    run_bench("import_geometry", workload, triangle_count, 1, bench_import_geometry, (void*)path);
+  }
+}
+
+static void run_load_benches(const char* level_path, uint32_t max_triangles)
+{
+  run_load_bench(level_path, "level");
+
+  // Scaling the triangle count
+  for (uint32_t triangle_count = 100; triangle_count <= max_triangles; triangle_count *= 10)
+  {
+    if (write_grid_obj(LOAD_BENCH_PATH, triangle_count))
+    {
+      run_load_bench(LOAD_BENCH_PATH, "grid");
+    }
+
+    remove(LOAD_BENCH_PATH);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  const char* json_path = NULL;
+  const char* level_path = "levels/level.obj";
+  uint32_t max_triangles = 1000000;
+
+  for (int arg = 1; arg < argc; ++arg)
+  {
+    if (strcmp(argv[arg], "--json") == 0 && arg + 1 < argc)
+    {
+      json_path = argv[++arg];
+    }
+    else if (strcmp(argv[arg], "--level") == 0 && arg + 1 < argc)
+    {
+      level_path = argv[++arg];
+    }
+    else if (strcmp(argv[arg], "--max-triangles") == 0 && arg + 1 < argc)
+    {
+      max_triangles = (uint32_t)strtoul(argv[++arg], NULL, 10);
+    }
+    else
+    {
+      printf("Unknown argument \"%s\"\nUsage: %s [--json <file>] [--level <file>] [--max-triangles <count>]\n",
+             argv[arg], argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  init_batch_collision();
+
+  // The native OBJ parser works on all cores
+  if (!init_jobs())
+  {
+    return EXIT_FAILURE;
+  }
+
+  printf("Batched collision functions use %s\n", get_batch_collision_isa());
+
+  run_pair_benches();
+  run_sweep_benches(level_path, max_triangles);
+  run_load_benches(level_path, max_triangles);
+
+  destroy_jobs();
+
+  if (json_path && !write_json(json_path))
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+#include "bvh.h"
+
+#include <cglm/vec3.h>
+
+#include <float.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BVH_BIN_COUNT 16
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_MAX_DEPTH 64
+
+struct BuildContext
+{
+  const vec3* mins;
+  const vec3* maxs;
+  vec3* centroids;
+  struct Bvh* bvh;
+};
+
+struct Bin
+{
+  vec3 min, max;
+  uint32_t count;
+};
+
+static float half_area(const vec3 min, const vec3 max)
+{
+  vec3 extent;
+  glm_vec3_sub((float*)max, (float*)min, extent);
+  return extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0];
+}
+
+static void reset_bounds(vec3 min, vec3 max)
+{
+  glm_vec3_fill(min, FLT_MAX);
+  glm_vec3_fill(max, -FLT_MAX);
+}
+
+static void grow_bounds(vec3 min, vec3 max, const vec3 other_min, const vec3 other_max)
+{
+  glm_vec3_minv(min, (float*)other_min, min);
+  glm_vec3_maxv(max, (float*)other_max, max);
+}
+
+static void build_node(struct BuildContext* context, uint32_t node_index, uint32_t first, uint32_t count, uint32_t depth)
+{
+  struct Bvh* bvh = context->bvh;
+  struct BvhNode* node = &bvh->nodes[node_index];
+
+  // Calculate the bounds of the node and of the primitive centroids
+  vec3 centroid_min, centroid_max;
+  {
+    reset_bounds(node->min, node->max);
+    reset_bounds(centroid_min, centroid_max);
+    for (uint32_t index = first; index < first + count; ++index)
+    {
+      const uint32_t primitive = bvh->primitives[index];
+      grow_bounds(node->min, node->max, context->mins[primitive], context->maxs[primitive]);
+      grow_bounds(centroid_min, centroid_max, context->centroids[primitive], context->centroids[primitive]);
+    }
+  }
+
+  node->first = first;
+  node->count = count;
+
+  if (count <= BVH_MAX_LEAF_SIZE || depth >= BVH_MAX_DEPTH - 1)
+  {
+    return;
+  }
+
+  // Find the cheapest split plane by binning the centroids along each axis
+  int best_axis = -1;
+  uint32_t best_split = 0;
+  float best_cost = half_area(node->min, node->max) * (float)count; // The cost of keeping this node a leaf
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    const float extent = centroid_max[axis] - centroid_min[axis];
+    if (extent <= 0.0f)
+    {
+      continue;
+    }
+
+    struct Bin bins[BVH_BIN_COUNT];
+    for (uint32_t bin = 0; bin < BVH_BIN_COUNT; ++bin)
+    {
+      reset_bounds(bins[bin].min, bins[bin].max);
+      bins[bin].count = 0;
+    }
+
+    const float scale = (float)BVH_BIN_COUNT / extent;
+    for (uint32_t index = first; index < first + count; ++index)
+    {
+      const uint32_t primitive = bvh->primitives[index];
+      uint32_t bin = (uint32_t)((context->centroids[primitive][axis] - centroid_min[axis]) * scale);
+      bin = bin < BVH_BIN_COUNT ? bin : BVH_BIN_COUNT - 1;
+
+      grow_bounds(bins[bin].min, bins[bin].max, context->mins[primitive], context->maxs[primitive]);
+      ++bins[bin].count;
+    }
+
+    // Sweep from the right to accumulate the cost of everything right of each split plane
+    float right_costs[BVH_BIN_COUNT];
+    {
+      vec3 min, max;
+      reset_bounds(min, max);
+      uint32_t right_count = 0;
+      for (uint32_t bin = BVH_BIN_COUNT - 1; bin > 0; --bin)
+      {
+        grow_bounds(min, max, bins[bin].min, bins[bin].max);
+        right_count += bins[bin].count;
+        right_costs[bin] = right_count > 0 ? half_area(min, max) * (float)right_count : 0.0f;
+      }
+    }
+
+    // Then sweep from the left and combine both sides
+    {
+      vec3 min, max;
+      reset_bounds(min, max);
+      uint32_t left_count = 0;
+      for (uint32_t split = 1; split < BVH_BIN_COUNT; ++split)
+      {
+        grow_bounds(min, max, bins[split - 1].min, bins[split - 1].max);
+        left_count += bins[split - 1].count;
+        if (left_count == 0 || left_count == count)
+        {
+          continue;
+        }
+
+        const float cost = half_area(min, max) * (float)left_count + right_costs[split];
+        if (cost < best_cost)
+        {
+          best_cost = cost;
+          best_axis = axis;
+          best_split = split;
+        }
+      }
+    }
+  }
+
+  if (best_axis < 0)
+  {
+    // Splitting would not pay off
+    return;
+  }
+
+  // Partition the primitives around the split plane
+  uint32_t middle = first;
+  {
+    const float scale = (float)BVH_BIN_COUNT / (centroid_max[best_axis] - centroid_min[best_axis]);
+
+    uint32_t last = first + count;
+    while (middle < last)
+    {
+      const uint32_t primitive = bvh->primitives[middle];
+      uint32_t bin = (uint32_t)((context->centroids[primitive][best_axis] - centroid_min[best_axis]) * scale);
+      bin = bin < BVH_BIN_COUNT ? bin : BVH_BIN_COUNT - 1;
+
+      if (bin < best_split)
+      {
+        ++middle;
+      }
+      else
+      {
+        bvh->primitives[middle] = bvh->primitives[--last];
+        bvh->primitives[last] = primitive;
+      }
+    }
+  }
+
+  // Turn the node into an interior node with two consecutive children
+  const uint32_t left = bvh->node_count;
+  bvh->node_count += 2;
+
+  node->first = left;
+  node->count = 0;
+
+  build_node(context, left, first, middle - first, depth + 1);
+  build_node(context, left + 1, middle, first + count - middle, depth + 1);
+}
+
+struct Bvh* make_bvh(const vec3* mins, const vec3* maxs, uint32_t primitive_count)
+{
+  struct Bvh* bvh = malloc(sizeof(struct Bvh));
+  if (!bvh)
+  {
+    printf("Ran out of memory while building BVH\n");
+    return NULL;
+  }
+
+  const uint32_t max_node_count = primitive_count > 0 ? primitive_count * 2 - 1 : 1;
+  bvh->nodes = malloc(sizeof(struct BvhNode) * max_node_count);
+  bvh->primitives = malloc(sizeof(uint32_t) * (primitive_count > 0 ? primitive_count : 1));
+  vec3* centroids = malloc(sizeof(vec3) * (primitive_count > 0 ? primitive_count : 1));
+  if (!bvh->nodes || !bvh->primitives || !centroids)
+  {
+    printf("Ran out of memory while building BVH for %u primitives\n", primitive_count);
+    free(centroids);
+    destroy_bvh(bvh);
+    return NULL;
+  }
+
+  for (uint32_t primitive = 0; primitive < primitive_count; ++primitive)
+  {
+    bvh->primitives[primitive] = primitive;
+
+    glm_vec3_add((float*)mins[primitive], (float*)maxs[primitive], centroids[primitive]);
+    glm_vec3_scale(centroids[primitive], 0.5f, centroids[primitive]);
+  }
+
+  bvh->node_count = 1;
+  bvh->primitive_count = primitive_count;
+
+  struct BuildContext context = { mins, maxs, centroids, bvh };
+  build_node(&context, 0, 0, primitive_count, 0);
+
+  free(centroids);
+
+  return bvh;
+}
+
+void destroy_bvh(struct Bvh* bvh)
+{
+  free(bvh->nodes);
+  free(bvh->primitives);
+  free(bvh);
+}
+
+static bool overlaps(const vec3 min_a, const vec3 max_a, const vec3 min_b, const vec3 max_b)
+{
+  return min_a[0] <= max_b[0] && max_a[0] >= min_b[0] && min_a[1] <= max_b[1] && max_a[1] >= min_b[1] &&
+         min_a[2] <= max_b[2] && max_a[2] >= min_b[2];
+}
+
+uint32_t query_bvh(const struct Bvh* bvh, const vec3 min, const vec3 max, uint32_t* primitives, uint32_t capacity)
+{
+  uint32_t found = 0;
+
+  if (bvh->primitive_count == 0)
+  {
+    return found;
+  }
+
+  uint32_t stack[BVH_MAX_DEPTH * 2];
+  uint32_t stack_size = 0;
+  stack[stack_size++] = 0;
+
+  while (stack_size > 0)
+  {
+    const struct BvhNode* node = &bvh->nodes[stack[--stack_size]];
+    if (!overlaps(node->min, node->max, min, max))
+    {
+      continue;
+    }
+
+    if (node->count == 0)
+    {
+      stack[stack_size++] = node->first;
+      stack[stack_size++] = node->first + 1;
+      continue;
+    }
+
+    for (uint32_t index = node->first; index < node->first + node->count; ++index)
+    {
+      if (found < capacity)
+      {
+        primitives[found] = bvh->primitives[index];
+      }
+
+      ++found;
+    }
+  }
+
+  return found;
+}
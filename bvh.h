@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cglm/types.h>
+
+#include <stdint.h>
+
+struct BvhNode
+{
+  vec3 min;
+  uint32_t first; // Index of the left child for interior nodes, index of the first primitive for leaves
+  vec3 max;
+  uint32_t count; // Number of primitives for leaves, 0 for interior nodes
+};
+
+struct Bvh
+{
+  struct BvhNode* nodes;
+  uint32_t* primitives; // Primitive indices, ordered so that each leaf references a contiguous range
+  uint32_t node_count;
+  uint32_t primitive_count;
+};
+
+// Builds a bounding volume hierarchy over primitives given by their bounding boxes, using a binned SAH build
+struct Bvh* make_bvh(const vec3* mins, const vec3* maxs, uint32_t primitive_count);
+void destroy_bvh(struct Bvh* bvh);
+
+// Writes the indices of all primitives whose bounding box overlaps the given box into primitives (up to capacity)
+// Returns the total number of overlapping primitives, which can be larger than capacity
+uint32_t query_bvh(const struct Bvh* bvh, const vec3 min, const vec3 max, uint32_t* primitives, uint32_t capacity);
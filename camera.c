@@ -1,11 +1,13 @@
 #include "camera.h"
 
 #include "level.h"
+#include "profiler.h"
+#include "scene_query.h"
 
 #include <cglm/cam.h>
-#include <cglm/ray.h>
 #include <cglm/vec3.h>
 
+#include <stdbool.h>
 #include <stdio.h>
 
 #define NEAR 0.1f
@@ -17,23 +19,26 @@
 #define DIST_MIN 1.0f
 #define DIST_MAX 32.0f
 
-#define WALL_DISTANCE 0.15f
+// Radius of the sphere around the camera that is kept out of the level, covers the corners of the near plane
+#define CAMERA_RADIUS 0.2f
 
 static float cam_pitch = GLM_PI_4f;
 static float cam_dist = 16.0f;
 
 static mat4 proj_matrix;
+static float pixel_scale; // Pixels covered by a unit of length at a distance of one unit
 
-void update_proj_matrix(float aspect)
+static vec3 previous_pos, previous_target;
+static vec3 current_pos, current_target;
+static bool has_updated = false;
+
+void update_proj_matrix(float width, float height)
 {
-  glm_perspective(FOV, aspect, NEAR, FAR, proj_matrix);
+  glm_perspective(FOV, width / height, NEAR, FAR, proj_matrix);
+  pixel_scale = proj_matrix[1][1] * height * 0.5f;
 }
 
-void update_camera(const vec2 cursor_delta,
-                   float scroll_delta,
-                   mat4 player_transform,
-                   float player_height,
-                   mat4 viewproj_matrix)
+void update_camera(const vec2 cursor_delta, float scroll_delta, mat4 player_transform, float player_height)
 {
   // Pitch
   cam_pitch = glm_clamp(cam_pitch + cursor_delta[1], PITCH_MIN, PITCH_MAX);
@@ -61,35 +66,61 @@ void update_camera(const vec2 cursor_delta,
     glm_vec3_sub(head, look, cam_pos);
   }
 
-  // Camera-level collision
+  // Camera-level collision, sweep a sphere around the near plane from the head back to the camera position
   {
-    vec3 dir;
-    glm_vec3_sub(cam_pos, head, dir);
-
-    float min_dist = -1.0f;
-    for (uint32_t triangle = 0; triangle < get_triangle_count(); ++triangle)
+    begin_cpu_zone(PROFILE_ZONE_CAMERA_COLLISION);
+
+    struct SceneCast cast;
+    glm_vec3_copy(head, cast.origin);
+    glm_vec3_sub(cam_pos, head, cast.dir);
+    cast.max_dist = glm_vec3_norm(cast.dir);
+    glm_vec3_divs(cast.dir, cast.max_dist, cast.dir);
+    cast.radius = CAMERA_RADIUS;
+
+    struct SceneHit hit;
+    cast_level(&cast, &hit, 1);
+    if (hit.hit)
     {
-      vec3 v0, v1, v2, n;
-      get_triangle(triangle, v0, v1, v2, n);
-
-      float dist;
-      bool hit = glm_ray_triangle(head, dir, v0, v1, v2, &dist);
-      if (hit && dist < 1.0 + WALL_DISTANCE && (min_dist < 0.0f || dist < min_dist))
-      {
-        min_dist = dist;
-      }
+      glm_vec3_copy(head, cam_pos);
+      glm_vec3_muladds(cast.dir, hit.dist, cam_pos);
     }
 
-    if (min_dist > 0.0f)
-    {
-      glm_vec3_negate(dir);
-      glm_vec3_muladds(dir, 1.0f - min_dist + WALL_DISTANCE, cam_pos);
-    }
+    end_cpu_zone(PROFILE_ZONE_CAMERA_COLLISION);
   }
 
-  // Calculate view projection matrix
+  // Keep the camera of the previous update around to interpolate from
+  if (has_updated)
   {
-    glm_lookat(cam_pos, cam_target, GLM_YUP, viewproj_matrix); // View matrix
-    glm_mat4_mul(proj_matrix, viewproj_matrix, viewproj_matrix);
+    glm_vec3_copy(current_pos, previous_pos);
+    glm_vec3_copy(current_target, previous_target);
   }
+  else
+  {
+    glm_vec3_copy(cam_pos, previous_pos);
+    glm_vec3_copy(cam_target, previous_target);
+    has_updated = true;
+  }
+
+  glm_vec3_copy(cam_pos, current_pos);
+  glm_vec3_copy(cam_target, current_target);
+}
+
+void get_camera_viewproj(float alpha, mat4 viewproj_matrix)
+{
+  vec3 cam_pos, cam_target;
+  glm_vec3_lerp(previous_pos, current_pos, alpha, cam_pos);
+  glm_vec3_lerp(previous_target, current_target, alpha, cam_target);
+
+  glm_lookat(cam_pos, cam_target, GLM_YUP, viewproj_matrix); // View matrix
+  glm_mat4_mul(proj_matrix, viewproj_matrix, viewproj_matrix);
+}
+
+float get_camera_pixels_per_unit(float alpha, const vec3 center, float radius)
+{
+  vec3 cam_pos;
+  glm_vec3_lerp(previous_pos, current_pos, alpha, cam_pos);
+
+  // Anything the camera is inside of or close to is as near as the near plane
+  const float dist = glm_max(glm_vec3_distance(cam_pos, (float*)center) - radius, NEAR);
+  return pixel_scale / dist;
 }
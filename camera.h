@@ -2,9 +2,11 @@
 
 #include <cglm/types.h>
 
-void update_proj_matrix(float aspect);
-void update_camera(const vec2 cursor_delta,
-                   float scroll_delta,
-                   mat4 player_transform,
-                   float player_height,
-                   mat4 viewproj_matrix);
+void update_proj_matrix(float width, float height);
+void update_camera(const vec2 cursor_delta, float scroll_delta, mat4 player_transform, float player_height);
+
+// Interpolates between the camera of the previous and the last update, alpha is the fraction of the way in between
+void get_camera_viewproj(float alpha, mat4 viewproj_matrix);
+
+// Returns how many pixels a unit of length covers at the near side of a sphere, as seen by the interpolated camera
+float get_camera_pixels_per_unit(float alpha, const vec3 center, float radius);
@@ -0,0 +1,679 @@
+#include "character.h"
+
+#include "bvh.h"
+#include "collision.h"
+#include "collision_mesh.h"
+#include "level.h"
+#include "mover.h"
+#include "sdf.h"
+#include "transform.h"
+
+#include <cglm/affine.h>
+#include <cglm/mat4.h>
+#include <cglm/vec3.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// How much larger than needed the region around a character is that the contact cache gathers level triangles in
+#define CONTACT_CACHE_MARGIN 2.0f
+
+// How far the capsule may be pushed out of the level before the collision candidates have to be gathered again
+#define COLLISION_QUERY_MARGIN CHARACTER_RADIUS
+
+// Moves are swept against the level and slide along what they hit, up to this many times per update
+#define SLIDE_ITERATIONS 4
+
+// Distance that swept moves keep from the level, so that sliding along a surface does not start out touching it
+#define COLLISION_SKIN 0.01f
+
+// How often the capsule is pushed out of the level per update with the SDF collision backend
+#define SDF_ITERATIONS 4
+
+// Contacts with a normal at least this close to straight up are ground that the character stands on
+#define GROUND_NORMAL_Y 0.7f
+
+// Extra room around the reach of a sweep for the rounding of the batched tests that find the triangles it can hit
+#define SWEEP_REACH_TOLERANCE 0.001f
+
+static int compare_triangles(const void* a, const void* b)
+{
+  const uint32_t triangle_a = *(const uint32_t*)a;
+  const uint32_t triangle_b = *(const uint32_t*)b;
+  return (triangle_a > triangle_b) - (triangle_a < triangle_b);
+}
+
+// Calculates the bounding box of a character capsule, grown by margin on all sides
+static void get_capsule_bounds(const vec3 base, const vec3 tip, float margin, vec3 min, vec3 max)
+{
+  const float extent = CHARACTER_RADIUS + margin;
+
+  glm_vec3_minv((float*)base, (float*)tip, min);
+  glm_vec3_adds(min, -extent, min);
+
+  glm_vec3_maxv((float*)base, (float*)tip, max);
+  glm_vec3_adds(max, extent, max);
+}
+
+static bool contains_bounds(const vec3 outer_min, const vec3 outer_max, const vec3 inner_min, const vec3 inner_max)
+{
+  return inner_min[0] >= outer_min[0] && inner_min[1] >= outer_min[1] && inner_min[2] >= outer_min[2] &&
+         inner_max[0] <= outer_max[0] && inner_max[1] <= outer_max[1] && inner_max[2] <= outer_max[2];
+}
+
+static bool overlaps_bounds(const vec3 a_min, const vec3 a_max, const vec3 b_min, const vec3 b_max)
+{
+  return a_min[0] <= b_max[0] && a_min[1] <= b_max[1] && a_min[2] <= b_max[2] && a_max[0] >= b_min[0] &&
+         a_max[1] >= b_min[1] && a_max[2] >= b_min[2];
+}
+
+// Whether any mover is close enough to the character to touch it during an update
+static bool is_near_mover(const struct Character* character)
+{
+  vec3 tip;
+  glm_vec3_copy((float*)character->transform[3], tip);
+  tip[1] += CHARACTER_HEIGHT;
+
+  vec3 min, max;
+  get_capsule_bounds(character->transform[3], tip, COLLISION_QUERY_MARGIN + glm_vec3_norm((float*)character->velocity),
+                     min, max);
+
+  for (uint32_t index = 0; index < get_mover_count(); ++index)
+  {
+    const struct Mover* mover = get_mover(index);
+    if (overlaps_bounds(mover->min, mover->max, min, max))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Gathers the triangles of a mover that potentially overlap a box given in the local space of the mover
+static bool gather_mover_candidates(struct Character* character,
+                                    const struct Mover* mover,
+                                    const vec3 min,
+                                    const vec3 max,
+                                    uint32_t* count)
+{
+  *count = query_bvh(mover->bvh, min, max, character->mover_candidates, character->mover_candidate_capacity);
+  if (*count > character->mover_candidate_capacity)
+  {
+    uint32_t* new_candidates = realloc(character->mover_candidates, sizeof(uint32_t) * *count);
+    if (!new_candidates)
+    {
+      printf("Ran out of memory while gathering %u mover collision candidates\n", *count);
+      return false;
+    }
+
+    character->mover_candidates = new_candidates;
+    character->mover_candidate_capacity = *count;
+
+    *count = query_bvh(mover->bvh, min, max, character->mover_candidates, character->mover_candidate_capacity);
+  }
+
+  return true;
+}
+
+// Gathers all level triangles near the given box, sorted by index so that they are resolved in level order
+// The contact cache is reused while it covers the box, otherwise it is gathered again with some margin around it
+static bool gather_candidates(struct Character* character, const vec3 min, const vec3 max, uint32_t* count)
+{
+  if (character->cache_valid && contains_bounds(character->cache_min, character->cache_max, min, max))
+  {
+    *count = character->cached_candidate_count;
+    return true;
+  }
+
+  glm_vec3_adds((float*)min, -CONTACT_CACHE_MARGIN, character->cache_min);
+  glm_vec3_adds((float*)max, CONTACT_CACHE_MARGIN, character->cache_max);
+  character->cache_valid = false;
+
+  *count = query_level_triangles(character->cache_min, character->cache_max, character->candidates,
+                                  character->candidate_capacity);
+  if (*count > character->candidate_capacity)
+  {
+    uint32_t* new_candidates = realloc(character->candidates, sizeof(uint32_t) * *count);
+    if (!new_candidates)
+    {
+      printf("Ran out of memory while gathering %u collision candidates\n", *count);
+      return false;
+    }
+
+    character->candidates = new_candidates;
+    character->candidate_capacity = *count;
+
+    *count = query_level_triangles(character->cache_min, character->cache_max, character->candidates,
+                                  character->candidate_capacity);
+  }
+
+  if (*count > 1)
+  {
+    qsort(character->candidates, *count, sizeof(uint32_t), compare_triangles);
+  }
+
+  character->cached_candidate_count = *count;
+  character->cache_valid = true;
+
+  return true;
+}
+
+// Sweeps the capsule along motion against the level triangles, returns whether and where it hits first
+static bool sweep_level_triangles(struct Character* character, const vec3 motion, float* toi, vec3 hit_normal)
+{
+  vec3 tip;
+  glm_vec3_copy(character->transform[3], tip);
+  tip[1] += CHARACTER_HEIGHT;
+
+  // Gather the triangles around the whole path of the capsule
+  vec3 query_min, query_max;
+  {
+    // Hits are found up to a little beyond the skin distance, so grow the region a bit more than that
+    get_capsule_bounds(character->transform[3], tip, 2.0f * COLLISION_SKIN, query_min, query_max);
+
+    vec3 end_min, end_max;
+    glm_vec3_add(query_min, (float*)motion, end_min);
+    glm_vec3_add(query_max, (float*)motion, end_max);
+
+    glm_vec3_minv(query_min, end_min, query_min);
+    glm_vec3_maxv(query_max, end_max, query_max);
+  }
+
+  uint32_t candidate_count;
+  if (!gather_candidates(character, query_min, query_max, &candidate_count))
+  {
+    return false;
+  }
+
+  bool hit = false;
+  *toi = 1.0f;
+  for (uint32_t candidate = 0; candidate < candidate_count; ++candidate)
+  {
+    vec3 v0, v1, v2, n;
+    get_triangle(character->candidates[candidate], v0, v1, v2, n);
+
+    float triangle_toi;
+    vec3 triangle_normal;
+    if (capsule_triangle_sweep(character->transform[3], tip, CHARACTER_RADIUS, (float*)motion, COLLISION_SKIN, v0, v1,
+                               v2, n, &triangle_toi, triangle_normal) &&
+        triangle_toi < *toi)
+    {
+      hit = true;
+      *toi = triangle_toi;
+      glm_vec3_copy(triangle_normal, hit_normal);
+    }
+  }
+
+  return hit;
+}
+
+// Sweeps the capsule along motion against the level SDF, returns whether and where it hits first
+static bool sweep_level_sdf(struct Character* character,
+                            const struct Sdf* sdf,
+                            const vec3 motion,
+                            float* toi,
+                            vec3 hit_normal)
+{
+  vec3 tip;
+  glm_vec3_copy(character->transform[3], tip);
+  tip[1] += CHARACTER_HEIGHT;
+
+  return capsule_sdf_sweep(sdf, character->transform[3], tip, CHARACTER_RADIUS, (float*)motion, COLLISION_SKIN, toi,
+                           hit_normal);
+}
+
+// Sweeps the capsule along motion against the movers, each in its local space, where the time of impact is the same
+// Only reports hits before *toi, so that the result combines with a sweep against the static level
+static bool sweep_movers(struct Character* character,
+                         const vec3 motion,
+                         float* toi,
+                         vec3 hit_normal,
+                         uint32_t* mover_index)
+{
+  vec3 tip;
+  glm_vec3_copy(character->transform[3], tip);
+  tip[1] += CHARACTER_HEIGHT;
+
+  vec3 sweep_min, sweep_max;
+  {
+    get_capsule_bounds(character->transform[3], tip, 2.0f * COLLISION_SKIN, sweep_min, sweep_max);
+
+    vec3 end_min, end_max;
+    glm_vec3_add(sweep_min, (float*)motion, end_min);
+    glm_vec3_add(sweep_max, (float*)motion, end_max);
+
+    glm_vec3_minv(sweep_min, end_min, sweep_min);
+    glm_vec3_maxv(sweep_max, end_max, sweep_max);
+  }
+
+  bool hit = false;
+  for (uint32_t index = 0; index < get_mover_count(); ++index)
+  {
+    const struct Mover* mover = get_mover(index);
+    if (!overlaps_bounds(mover->min, mover->max, sweep_min, sweep_max))
+    {
+      continue;
+    }
+
+    vec3 local_base, local_tip, local_motion;
+    glm_mat4_mulv3((vec4*)mover->inverse_transform, character->transform[3], 1.0f, local_base);
+    glm_mat4_mulv3((vec4*)mover->inverse_transform, tip, 1.0f, local_tip);
+    glm_mat4_mulv3((vec4*)mover->inverse_transform, (float*)motion, 0.0f, local_motion);
+
+    vec3 query_min, query_max;
+    {
+      get_capsule_bounds(local_base, local_tip, 2.0f * COLLISION_SKIN, query_min, query_max);
+
+      vec3 end_min, end_max;
+      glm_vec3_add(query_min, local_motion, end_min);
+      glm_vec3_add(query_max, local_motion, end_max);
+
+      glm_vec3_minv(query_min, end_min, query_min);
+      glm_vec3_maxv(query_max, end_max, query_max);
+    }
+
+    uint32_t candidate_count;
+    if (!gather_mover_candidates(character, mover, query_min, query_max, &candidate_count))
+    {
+      return hit;
+    }
+
+    // Anything the capsule can hit during the sweep overlaps the capsule grown by the length of the move, which the
+    // batched test finds quickly among the many triangles of a finely tessellated mover
+    struct CapsuleQuery reach_query;
+    {
+      const float grow = COLLISION_SKIN + glm_vec3_norm(local_motion) + SWEEP_REACH_TOLERANCE;
+
+      vec3 axis, reach_base, reach_tip;
+      glm_vec3_sub(local_tip, local_base, axis);
+      glm_vec3_normalize(axis);
+      glm_vec3_copy(local_base, reach_base);
+      glm_vec3_muladds(axis, -grow, reach_base);
+      glm_vec3_copy(local_tip, reach_tip);
+      glm_vec3_muladds(axis, grow, reach_tip);
+
+      make_capsule_query(reach_base, reach_tip, CHARACTER_RADIUS + grow, &reach_query);
+    }
+
+    struct TriangleBatch batch;
+    float pen_normals[3][COLLISION_BATCH_SIZE], pen_depths[COLLISION_BATCH_SIZE];
+
+    for (uint32_t candidate = 0; candidate < candidate_count; candidate += COLLISION_BATCH_SIZE)
+    {
+      const uint32_t remaining = candidate_count - candidate;
+      const uint32_t count = remaining < COLLISION_BATCH_SIZE ? remaining : COLLISION_BATCH_SIZE;
+      get_collision_triangle_batch(mover->collision_mesh, &character->mover_candidates[candidate], count, &batch);
+
+      const uint32_t mask = capsule_triangle_batch_collision(&reach_query, &batch, count, pen_normals, pen_depths);
+      for (uint32_t lane = 0; lane < count; ++lane)
+      {
+        if (!(mask & (1u << lane)))
+        {
+          continue;
+        }
+
+        vec3 v0, v1, v2, n;
+        get_collision_triangle(mover->collision_mesh, character->mover_candidates[candidate + lane], v0, v1, v2, n);
+
+        float triangle_toi;
+        vec3 triangle_normal;
+        if (capsule_triangle_sweep(local_base, local_tip, CHARACTER_RADIUS, local_motion, COLLISION_SKIN, v0, v1, v2,
+                                   n, &triangle_toi, triangle_normal) &&
+            triangle_toi < *toi)
+        {
+          hit = true;
+          *toi = triangle_toi;
+          glm_mat4_mulv3((vec4*)mover->transform, triangle_normal, 0.0f, hit_normal);
+          *mover_index = index;
+        }
+      }
+    }
+  }
+
+  return hit;
+}
+
+// Moves the character by motion, stopping at the level and sliding along it instead of passing through
+// Returns whether the level was hit on the way
+static bool move_and_slide(struct Character* character, const struct Sdf* sdf, const vec3 motion)
+{
+  bool contact = false;
+
+  vec3 remaining;
+  glm_vec3_copy((float*)motion, remaining);
+
+  for (int iteration = 0; iteration < SLIDE_ITERATIONS; ++iteration)
+  {
+    float toi;
+    vec3 hit_normal;
+    bool hit = sdf ? sweep_level_sdf(character, sdf, remaining, &toi, hit_normal)
+                   : sweep_level_triangles(character, remaining, &toi, hit_normal);
+    if (!hit)
+    {
+      toi = 1.0f;
+    }
+
+    uint32_t mover_index = NO_MOVER;
+    hit = sweep_movers(character, remaining, &toi, hit_normal, &mover_index) || hit;
+    if (!hit)
+    {
+      glm_vec3_add(character->transform[3], remaining, character->transform[3]);
+      return contact;
+    }
+
+    contact = true;
+
+    if (mover_index != NO_MOVER && hit_normal[1] >= GROUND_NORMAL_Y)
+    {
+      character->ground_mover = mover_index;
+    }
+
+    // Move up to the hit, then slide along the surface with what is left
+    glm_vec3_muladds(remaining, toi, character->transform[3]);
+    glm_vec3_scale(remaining, 1.0f - toi, remaining);
+
+    const float into_surface = glm_vec3_dot(remaining, hit_normal);
+    if (into_surface < 0.0f)
+    {
+      glm_vec3_muladds(hit_normal, -into_surface, remaining);
+    }
+
+    if (glm_vec3_norm2(remaining) <= 0.0f)
+    {
+      break;
+    }
+  }
+
+  // Whatever is left after the last slide is dropped, as the capsule would hit the level again
+  return contact;
+}
+
+// Resolves penetrations with the level triangles, returns whether there was any contact
+static bool collide_with_level_triangles(struct Character* character)
+{
+  bool contact = false;
+
+  // Capsule
+  vec3 tip;
+  glm_vec3_copy(character->transform[3], tip);
+  tip[1] += CHARACTER_HEIGHT;
+
+  // Only the triangles near the capsule can collide with it, so gather those with some margin for the capsule to be
+  // pushed around while resolving penetrations
+  vec3 query_min, query_max;
+  get_capsule_bounds(character->transform[3], tip, COLLISION_QUERY_MARGIN, query_min, query_max);
+
+  uint32_t candidate_count;
+  if (!gather_candidates(character, query_min, query_max, &candidate_count))
+  {
+    return contact;
+  }
+
+  struct CapsuleQuery query;
+  make_capsule_query(character->transform[3], tip, CHARACTER_RADIUS, &query);
+
+  struct TriangleBatch batch;
+  float pen_normals[3][COLLISION_BATCH_SIZE], pen_depths[COLLISION_BATCH_SIZE];
+
+  uint32_t candidate = 0;
+  while (candidate < candidate_count)
+  {
+    // Test the next batch of candidates
+    const uint32_t remaining = candidate_count - candidate;
+    const uint32_t count = remaining < COLLISION_BATCH_SIZE ? remaining : COLLISION_BATCH_SIZE;
+    get_triangle_batch(&character->candidates[candidate], count, &batch);
+
+    const uint32_t mask = capsule_triangle_batch_collision(&query, &batch, count, pen_normals, pen_depths);
+    if (mask == 0)
+    {
+      candidate += count;
+      continue;
+    }
+
+    // Resolve the first hit only, the candidates after it are tested again from the new position
+    uint32_t lane = 0;
+    while (!(mask & (1u << lane)))
+    {
+      ++lane;
+    }
+
+    const uint32_t triangle = character->candidates[candidate + lane];
+    candidate += lane + 1;
+
+    contact = true;
+
+    vec3 pen_normal = { pen_normals[0][lane], pen_normals[1][lane], pen_normals[2][lane] };
+    glm_vec3_scale(pen_normal, pen_depths[lane], pen_normal);
+    glm_vec3_add(character->transform[3], pen_normal, character->transform[3]);
+
+    make_capsule_query(character->transform[3], tip, CHARACTER_RADIUS, &query);
+
+    // If the capsule was pushed outside of the gathered region, gather again around the new position and continue
+    // with the remaining triangles in level order
+    vec3 min, max;
+    get_capsule_bounds(character->transform[3], tip, 0.0f, min, max);
+    if (!contains_bounds(query_min, query_max, min, max))
+    {
+      get_capsule_bounds(character->transform[3], tip, COLLISION_QUERY_MARGIN, query_min, query_max);
+      if (!gather_candidates(character, query_min, query_max, &candidate_count))
+      {
+        return contact;
+      }
+
+      candidate = 0;
+      while (candidate < candidate_count && character->candidates[candidate] <= triangle)
+      {
+        ++candidate;
+      }
+    }
+  }
+
+  return contact;
+}
+
+// Resolves penetrations with the movers, each in its local space, returns whether there was any contact
+// This is what pushes characters out of the way of movers that move into them
+static bool collide_with_movers(struct Character* character)
+{
+  bool contact = false;
+
+  for (uint32_t index = 0; index < get_mover_count(); ++index)
+  {
+    const struct Mover* mover = get_mover(index);
+
+    vec3 tip;
+    glm_vec3_copy(character->transform[3], tip);
+    tip[1] += CHARACTER_HEIGHT;
+
+    vec3 min, max;
+    get_capsule_bounds(character->transform[3], tip, 0.0f, min, max);
+    if (!overlaps_bounds(mover->min, mover->max, min, max))
+    {
+      continue;
+    }
+
+    vec3 local_base, local_tip;
+    glm_mat4_mulv3((vec4*)mover->inverse_transform, character->transform[3], 1.0f, local_base);
+    glm_mat4_mulv3((vec4*)mover->inverse_transform, tip, 1.0f, local_tip);
+
+    vec3 query_min, query_max;
+    get_capsule_bounds(local_base, local_tip, COLLISION_QUERY_MARGIN, query_min, query_max);
+
+    uint32_t candidate_count;
+    if (!gather_mover_candidates(character, mover, query_min, query_max, &candidate_count))
+    {
+      return contact;
+    }
+
+    struct CapsuleQuery query;
+    make_capsule_query(local_base, local_tip, CHARACTER_RADIUS, &query);
+
+    struct TriangleBatch batch;
+    float pen_normals[3][COLLISION_BATCH_SIZE], pen_depths[COLLISION_BATCH_SIZE];
+
+    bool mover_contact = false;
+    uint32_t candidate = 0;
+    while (candidate < candidate_count)
+    {
+      const uint32_t remaining = candidate_count - candidate;
+      const uint32_t count = remaining < COLLISION_BATCH_SIZE ? remaining : COLLISION_BATCH_SIZE;
+      get_collision_triangle_batch(mover->collision_mesh, &character->mover_candidates[candidate], count, &batch);
+
+      const uint32_t mask = capsule_triangle_batch_collision(&query, &batch, count, pen_normals, pen_depths);
+      if (mask == 0)
+      {
+        candidate += count;
+        continue;
+      }
+
+      // Resolve the first hit only, the candidates after it are tested again from the new position
+      uint32_t lane = 0;
+      while (!(mask & (1u << lane)))
+      {
+        ++lane;
+      }
+
+      candidate += lane + 1;
+
+      mover_contact = true;
+
+      // Pushes further than the query margin are not expected, the mover would have to move faster than that
+      const vec3 pen_normal = { pen_normals[0][lane], pen_normals[1][lane], pen_normals[2][lane] };
+      glm_vec3_muladds((float*)pen_normal, pen_depths[lane], local_base);
+      glm_vec3_muladds((float*)pen_normal, pen_depths[lane], local_tip);
+      make_capsule_query(local_base, local_tip, CHARACTER_RADIUS, &query);
+
+      vec3 world_normal;
+      glm_mat4_mulv3((vec4*)mover->transform, (float*)pen_normal, 0.0f, world_normal);
+      if (world_normal[1] >= GROUND_NORMAL_Y)
+      {
+        character->ground_mover = index;
+      }
+    }
+
+    if (mover_contact)
+    {
+      contact = true;
+      glm_mat4_mulv3((vec4*)mover->transform, local_base, 1.0f, character->transform[3]);
+    }
+  }
+
+  return contact;
+}
+
+// Resolves penetrations with the level SDF, returns whether there was any contact
+static bool collide_with_level_sdf(struct Character* character, const struct Sdf* sdf)
+{
+  bool contact = false;
+
+  for (int iteration = 0; iteration < SDF_ITERATIONS; ++iteration)
+  {
+    vec3 tip;
+    glm_vec3_copy(character->transform[3], tip);
+    tip[1] += CHARACTER_HEIGHT;
+
+    vec3 pen_normal;
+    float pen_depth;
+    if (!capsule_sdf_collision(sdf, character->transform[3], tip, CHARACTER_RADIUS, pen_normal, &pen_depth))
+    {
+      break;
+    }
+
+    contact = true;
+
+    glm_vec3_scale(pen_normal, pen_depth, pen_normal);
+    glm_vec3_add(character->transform[3], pen_normal, character->transform[3]);
+  }
+
+  return contact;
+}
+
+void init_character(struct Character* character, const vec3 position)
+{
+  glm_translate_make(character->transform, (float*)position);
+  glm_mat4_copy(character->transform, character->previous_transform);
+  glm_vec3_zero(character->velocity);
+  character->in_contact = false;
+
+  character->candidates = NULL;
+  character->candidate_capacity = 0;
+  character->cached_candidate_count = 0;
+  character->cache_valid = false;
+
+  character->resting.valid = false;
+
+  character->mover_candidates = NULL;
+  character->mover_candidate_capacity = 0;
+  character->ground_mover = NO_MOVER;
+}
+
+void destroy_character(struct Character* character)
+{
+  free(character->candidates);
+  character->candidates = NULL;
+  character->candidate_capacity = 0;
+  character->cache_valid = false;
+
+  character->resting.valid = false;
+
+  free(character->mover_candidates);
+  character->mover_candidates = NULL;
+  character->mover_candidate_capacity = 0;
+  character->ground_mover = NO_MOVER;
+}
+
+void update_character(struct Character* character)
+{
+  // Ride along with the mover that the character stood on, by how much it moved and turned since the last update
+  if (character->ground_mover != NO_MOVER)
+  {
+    const struct Mover* mover = get_mover(character->ground_mover);
+
+    mat4 delta;
+    glm_mat4_copy((vec4*)mover->previous_transform, delta);
+    glm_inv_tr(delta);
+    glm_mat4_mul((vec4*)mover->transform, delta, delta);
+    glm_mat4_mul(delta, character->transform, character->transform);
+
+    character->ground_mover = NO_MOVER;
+  }
+
+  // Resting fast path: the character did not move during the last update, and it is starting from the same position
+  // with the same motion again now, so the result is exactly the same as well
+  // Movers change the level around them though, so characters near any of them take the full path
+  struct RestingState* resting = &character->resting;
+  const bool near_mover = is_near_mover(character);
+  if (!near_mover && resting->valid && glm_vec3_eqv(character->transform[3], resting->position) &&
+      glm_vec3_eqv(character->velocity, resting->motion))
+  {
+    character->in_contact = resting->contact;
+    return;
+  }
+
+  vec3 start;
+  glm_vec3_copy(character->transform[3], start);
+
+  const struct Sdf* sdf = get_level_sdf();
+
+  // Sweeping the move catches walls no matter how far the character moves in one update
+  character->in_contact = move_and_slide(character, sdf, character->velocity);
+
+  // The sweep never moves the capsule into the level, but it does not resolve penetrations it started with
+  const bool penetrating = sdf ? collide_with_level_sdf(character, sdf) : collide_with_level_triangles(character);
+  const bool penetrating_movers = near_mover && collide_with_movers(character);
+  character->in_contact = character->in_contact || penetrating || penetrating_movers;
+
+  resting->valid = !near_mover && glm_vec3_eqv(character->transform[3], start);
+  if (resting->valid)
+  {
+    glm_vec3_copy(start, resting->position);
+    glm_vec3_copy(character->velocity, resting->motion);
+    resting->contact = character->in_contact;
+  }
+}
+
+void get_character_render_transform(const struct Character* character, float alpha, mat4 dest)
+{
+  interpolate_transform(character->previous_transform, character->transform, alpha, dest);
+}
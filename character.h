@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cglm/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CHARACTER_RADIUS 0.75f
+#define CHARACTER_HEIGHT 3.0f
+
+// The last update that left a character where it was, which repeats exactly as long as its inputs do
+struct RestingState
+{
+  bool valid;
+  vec3 position;
+  vec3 motion;
+  bool contact;
+};
+
+// A capsule that moves through the level, all of its collision state is kept here so that many can update in parallel
+struct Character
+{
+  mat4 transform;
+  mat4 previous_transform; // Before the last update, for interpolation
+  vec3 velocity;           // Offset to move by in the next update
+  bool in_contact;
+
+  // Contact cache: the level triangles in a region around the character, reused until it leaves that region
+  uint32_t* candidates;
+  uint32_t candidate_capacity;
+  uint32_t cached_candidate_count;
+  vec3 cache_min, cache_max;
+  bool cache_valid;
+
+  struct RestingState resting;
+
+  // Triangles of a mover near the character, in the local space of the mover, gathered anew for every query
+  uint32_t* mover_candidates;
+  uint32_t mover_candidate_capacity;
+
+  uint32_t ground_mover; // Index of the mover that the character stood on after the last update, or NO_MOVER
+};
+
+void init_character(struct Character* character, const vec3 position);
+void destroy_character(struct Character* character);
+
+// Moves the character by its velocity through the level, sliding along it and resolving any penetrations
+// A character standing on a mover is carried along with it first
+// Only reads shared level data, so different characters can be updated from different threads at the same time
+void update_character(struct Character* character);
+
+// The transform to draw the character with, see interpolate_transform
+void get_character_render_transform(const struct Character* character, float alpha, mat4 dest);
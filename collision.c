@@ -3,6 +3,37 @@
 #include <cglm/util.h>
 #include <cglm/vec3.h>
 
+#include <float.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+  #define COLLISION_BATCH_X86
+
+  #include <immintrin.h>
+
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+  #endif
+#endif
+
+#define MAX_SWEEP_ITERATIONS 32
+
+typedef uint32_t (*SphereBatchFunction)(vec3 sphere_pos,
+                                        float sphere_radius,
+                                        const struct TriangleBatch* batch,
+                                        float pen_normals[3][COLLISION_BATCH_SIZE],
+                                        float pen_depths[COLLISION_BATCH_SIZE]);
+
+typedef uint32_t (*CapsuleBatchFunction)(const struct CapsuleQuery* query,
+                                         const struct TriangleBatch* batch,
+                                         float pen_normals[3][COLLISION_BATCH_SIZE],
+                                         float pen_depths[COLLISION_BATCH_SIZE]);
+
+// Set once by init_batch_collision, before any other thread can read them
+static SphereBatchFunction sphere_batch_function = NULL;
+static CapsuleBatchFunction capsule_batch_function = NULL;
+static const char* batch_isa = NULL;
+
 static void closest_point_on_line(vec3 a, vec3 b, vec3 p, vec3 cp)
 {
   vec3 v;
@@ -282,4 +313,747 @@ bool capsule_triangle_collision(vec3 capsule_base,
 
   return sphere_triangle_collision(center, capsule_radius, triangle_p0, triangle_p1, triangle_p2, triangle_normal,
                                    pen_normal, pen_depth);
-}
\ No newline at end of file
+}
+
+void closest_point_on_triangle(vec3 p, vec3 triangle_p0, vec3 triangle_p1, vec3 triangle_p2, vec3 closest)
+{
+  // Find the Voronoi region of the triangle that p lies in, from Real-Time Collision Detection (Ericson), 5.1.5
+  vec3 ab, ac, ap;
+  glm_vec3_sub(triangle_p1, triangle_p0, ab);
+  glm_vec3_sub(triangle_p2, triangle_p0, ac);
+  glm_vec3_sub(p, triangle_p0, ap);
+
+  const float d1 = glm_vec3_dot(ab, ap);
+  const float d2 = glm_vec3_dot(ac, ap);
+  if (d1 <= 0.0f && d2 <= 0.0f)
+  {
+    glm_vec3_copy(triangle_p0, closest);
+    return;
+  }
+
+  vec3 bp;
+  glm_vec3_sub(p, triangle_p1, bp);
+
+  const float d3 = glm_vec3_dot(ab, bp);
+  const float d4 = glm_vec3_dot(ac, bp);
+  if (d3 >= 0.0f && d4 <= d3)
+  {
+    glm_vec3_copy(triangle_p1, closest);
+    return;
+  }
+
+  const float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+  {
+    const float v = d1 / (d1 - d3);
+    glm_vec3_copy(triangle_p0, closest);
+    glm_vec3_muladds(ab, v, closest);
+    return;
+  }
+
+  vec3 cp;
+  glm_vec3_sub(p, triangle_p2, cp);
+
+  const float d5 = glm_vec3_dot(ab, cp);
+  const float d6 = glm_vec3_dot(ac, cp);
+  if (d6 >= 0.0f && d5 <= d6)
+  {
+    glm_vec3_copy(triangle_p2, closest);
+    return;
+  }
+
+  const float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+  {
+    const float w = d2 / (d2 - d6);
+    glm_vec3_copy(triangle_p0, closest);
+    glm_vec3_muladds(ac, w, closest);
+    return;
+  }
+
+  const float va = d3 * d6 - d5 * d4;
+  if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+  {
+    const float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+    vec3 bc;
+    glm_vec3_sub(triangle_p2, triangle_p1, bc);
+    glm_vec3_copy(triangle_p1, closest);
+    glm_vec3_muladds(bc, w, closest);
+    return;
+  }
+
+  // Inside the face region
+  const float denom = 1.0f / (va + vb + vc);
+  const float v = vb * denom;
+  const float w = vc * denom;
+  glm_vec3_copy(triangle_p0, closest);
+  glm_vec3_muladds(ab, v, closest);
+  glm_vec3_muladds(ac, w, closest);
+}
+
+// Finds the closest points between the segments p1-q1 and p2-q2, from Real-Time Collision Detection (Ericson), 5.1.9
+static void closest_points_on_segments(vec3 p1, vec3 q1, vec3 p2, vec3 q2, vec3 c1, vec3 c2)
+{
+  vec3 d1, d2, r;
+  glm_vec3_sub(q1, p1, d1);
+  glm_vec3_sub(q2, p2, d2);
+  glm_vec3_sub(p1, p2, r);
+
+  const float a = glm_vec3_dot(d1, d1);
+  const float e = glm_vec3_dot(d2, d2);
+  const float f = glm_vec3_dot(d2, r);
+
+  float s, t;
+  if (a <= FLT_EPSILON && e <= FLT_EPSILON)
+  {
+    s = t = 0.0f;
+  }
+  else if (a <= FLT_EPSILON)
+  {
+    s = 0.0f;
+    t = glm_clamp(f / e, 0.0f, 1.0f);
+  }
+  else
+  {
+    const float c = glm_vec3_dot(d1, r);
+    if (e <= FLT_EPSILON)
+    {
+      t = 0.0f;
+      s = glm_clamp(-c / a, 0.0f, 1.0f);
+    }
+    else
+    {
+      const float b = glm_vec3_dot(d1, d2);
+      const float denom = a * e - b * b;
+
+      // Pick an arbitrary s for parallel segments
+      s = denom != 0.0f ? glm_clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+      t = (b * s + f) / e;
+
+      if (t < 0.0f)
+      {
+        t = 0.0f;
+        s = glm_clamp(-c / a, 0.0f, 1.0f);
+      }
+      else if (t > 1.0f)
+      {
+        t = 1.0f;
+        s = glm_clamp((b - c) / a, 0.0f, 1.0f);
+      }
+    }
+  }
+
+  glm_vec3_copy(p1, c1);
+  glm_vec3_muladds(d1, s, c1);
+  glm_vec3_copy(p2, c2);
+  glm_vec3_muladds(d2, t, c2);
+}
+
+float segment_triangle_distance(vec3 segment_a,
+                                vec3 segment_b,
+                                vec3 triangle_p0,
+                                vec3 triangle_p1,
+                                vec3 triangle_p2,
+                                vec3 triangle_normal,
+                                vec3 closest_segment,
+                                vec3 closest_triangle)
+{
+  // A segment that passes through the triangle touches it where it crosses the plane
+  {
+    vec3 a, b;
+    glm_vec3_sub(segment_a, triangle_p0, a);
+    glm_vec3_sub(segment_b, triangle_p0, b);
+
+    const float da = glm_vec3_dot(a, triangle_normal);
+    const float db = glm_vec3_dot(b, triangle_normal);
+    if ((da <= 0.0f && db >= 0.0f) || (da >= 0.0f && db <= 0.0f))
+    {
+      if (da != db)
+      {
+        vec3 crossing;
+        glm_vec3_lerp(segment_a, segment_b, da / (da - db), crossing);
+
+        vec3 closest;
+        closest_point_on_triangle(crossing, triangle_p0, triangle_p1, triangle_p2, closest);
+        if (glm_vec3_distance2(crossing, closest) <= FLT_EPSILON * glm_vec3_norm2(crossing))
+        {
+          glm_vec3_copy(crossing, closest_segment);
+          glm_vec3_copy(crossing, closest_triangle);
+          return 0.0f;
+        }
+      }
+    }
+  }
+
+  // Otherwise the closest points involve one of the segment end points or one of the triangle edges
+  float best_dist2 = FLT_MAX;
+
+  vec3* const segment_ends[2] = { (vec3*)segment_a, (vec3*)segment_b };
+  for (int end = 0; end < 2; ++end)
+  {
+    vec3 closest;
+    closest_point_on_triangle(*segment_ends[end], triangle_p0, triangle_p1, triangle_p2, closest);
+
+    const float dist2 = glm_vec3_distance2(*segment_ends[end], closest);
+    if (dist2 < best_dist2)
+    {
+      best_dist2 = dist2;
+      glm_vec3_copy(*segment_ends[end], closest_segment);
+      glm_vec3_copy(closest, closest_triangle);
+    }
+  }
+
+  vec3* const corners[3] = { (vec3*)triangle_p0, (vec3*)triangle_p1, (vec3*)triangle_p2 };
+  for (int edge = 0; edge < 3; ++edge)
+  {
+    vec3 on_segment, on_edge;
+    closest_points_on_segments(segment_a, segment_b, *corners[edge], *corners[(edge + 1) % 3], on_segment, on_edge);
+
+    const float dist2 = glm_vec3_distance2(on_segment, on_edge);
+    if (dist2 < best_dist2)
+    {
+      best_dist2 = dist2;
+      glm_vec3_copy(on_segment, closest_segment);
+      glm_vec3_copy(on_edge, closest_triangle);
+    }
+  }
+
+  return sqrtf(best_dist2);
+}
+
+bool capsule_triangle_sweep(vec3 capsule_base,
+                            vec3 capsule_tip,
+                            float capsule_radius,
+                            vec3 motion,
+                            float skin,
+                            vec3 triangle_p0,
+                            vec3 triangle_p1,
+                            vec3 triangle_p2,
+                            vec3 triangle_normal,
+                            float* toi,
+                            vec3 hit_normal)
+{
+  const float motion_length = glm_vec3_norm(motion);
+  if (motion_length <= 0.0f)
+  {
+    return false;
+  }
+
+  // The centers of the end spheres, so that the capsule is the segment between them grown by the radius
+  vec3 a, b;
+  {
+    struct CapsuleQuery query;
+    make_capsule_query(capsule_base, capsule_tip, capsule_radius, &query);
+    glm_vec3_copy(query.a, a);
+    glm_vec3_copy(query.b, b);
+  }
+
+  // The distance to the triangle is at least the distance to its plane, so a capsule that stays far enough on one side
+  // of the plane over the whole move can be rejected without any iterations
+  {
+    vec3 offset;
+    glm_vec3_sub(a, triangle_p0, offset);
+    const float plane_a = glm_vec3_dot(offset, triangle_normal);
+    glm_vec3_sub(b, triangle_p0, offset);
+    const float plane_b = glm_vec3_dot(offset, triangle_normal);
+    const float plane_motion = glm_vec3_dot(motion, triangle_normal);
+
+    const float reach = capsule_radius + skin + SWEEP_TOLERANCE;
+    if (glm_min(plane_a, plane_b) + glm_min(plane_motion, 0.0f) > reach ||
+        glm_max(plane_a, plane_b) + glm_max(plane_motion, 0.0f) < -reach)
+    {
+      return false;
+    }
+  }
+
+  // Conservative advancement: the capsule only translates, so the gap can not shrink by more than motion_length per
+  // unit of t, and stepping by gap / motion_length never overshoots the contact
+  float t = 0.0f;
+  for (uint32_t iteration = 0; iteration < MAX_SWEEP_ITERATIONS; ++iteration)
+  {
+    vec3 segment_a, segment_b;
+    glm_vec3_copy(a, segment_a);
+    glm_vec3_muladds(motion, t, segment_a);
+    glm_vec3_copy(b, segment_b);
+    glm_vec3_muladds(motion, t, segment_b);
+
+    vec3 closest_segment, closest_triangle;
+    const float dist = segment_triangle_distance(segment_a, segment_b, triangle_p0, triangle_p1, triangle_p2,
+                                                 triangle_normal, closest_segment, closest_triangle);
+
+    const float gap = dist - capsule_radius - skin;
+    if (gap <= SWEEP_TOLERANCE)
+    {
+      vec3 normal;
+      glm_vec3_sub(closest_segment, closest_triangle, normal);
+      if (dist > FLT_EPSILON)
+      {
+        glm_vec3_scale(normal, 1.0f / dist, normal);
+      }
+      else
+      {
+        glm_vec3_copy(triangle_normal, normal);
+      }
+
+      // The distance between two convex shapes is convex along a translation, so a capsule that is already touching
+      // the triangle but not moving towards it never gets any closer
+      if (glm_vec3_dot(normal, motion) >= 0.0f)
+      {
+        return false;
+      }
+
+      *toi = t;
+      glm_vec3_copy(normal, hit_normal);
+      return true;
+    }
+
+    t += gap / motion_length;
+    if (t > 1.0f)
+    {
+      return false;
+    }
+  }
+
+  // Did not converge, stopping here is still safe as the capsule has not come within skin of the triangle yet
+  *toi = t;
+  glm_vec3_copy(triangle_normal, hit_normal);
+  return true;
+}
+
+// Returns the smallest t >= 0 at which a sphere moving from origin along the normalized dir touches a sphere at center
+// with the combined radius, or a negative value if it never does
+static float ray_sphere_entry(vec3 origin, vec3 dir, vec3 center, float radius)
+{
+  vec3 m;
+  glm_vec3_sub(origin, center, m);
+
+  const float b = glm_vec3_dot(m, dir);
+  const float c = glm_vec3_dot(m, m) - radius * radius;
+  if (c > 0.0f && b > 0.0f)
+  {
+    return -1.0f;
+  }
+
+  const float discriminant = b * b - c;
+  if (discriminant < 0.0f)
+  {
+    return -1.0f;
+  }
+
+  return glm_max(-b - sqrtf(discriminant), 0.0f);
+}
+
+// Same as ray_sphere_entry, but for the side of a capsule around the segment p0-p1, ignoring its end caps
+static float ray_cylinder_entry(vec3 origin, vec3 dir, vec3 p0, vec3 p1, float radius)
+{
+  vec3 e, m;
+  glm_vec3_sub(p1, p0, e);
+  glm_vec3_sub(origin, p0, m);
+
+  const float ee = glm_vec3_dot(e, e);
+  if (ee <= FLT_EPSILON)
+  {
+    return -1.0f;
+  }
+
+  // Solve in the plane perpendicular to the segment
+  vec3 m_perp, d_perp;
+  glm_vec3_copy(m, m_perp);
+  glm_vec3_muladds(e, -glm_vec3_dot(m, e) / ee, m_perp);
+  glm_vec3_copy(dir, d_perp);
+  glm_vec3_muladds(e, -glm_vec3_dot(dir, e) / ee, d_perp);
+
+  const float a = glm_vec3_dot(d_perp, d_perp);
+  const float b = glm_vec3_dot(m_perp, d_perp);
+  const float c = glm_vec3_dot(m_perp, m_perp) - radius * radius;
+  if (a <= FLT_EPSILON || c < 0.0f)
+  {
+    // Moving along the segment or starting inside of the infinite cylinder, which the end caps and the initial overlap
+    // test take care of
+    return -1.0f;
+  }
+
+  const float discriminant = b * b - a * c;
+  if (discriminant < 0.0f)
+  {
+    return -1.0f;
+  }
+
+  const float t = (-b - sqrtf(discriminant)) / a;
+  if (t < 0.0f)
+  {
+    return -1.0f;
+  }
+
+  // Only the part of the cylinder along the segment counts
+  vec3 hit;
+  glm_vec3_copy(m, hit);
+  glm_vec3_muladds(dir, t, hit);
+  const float s = glm_vec3_dot(hit, e);
+  return s >= 0.0f && s <= ee ? t : -1.0f;
+}
+
+bool sphere_triangle_cast(vec3 origin,
+                          vec3 dir,
+                          float radius,
+                          float max_dist,
+                          vec3 triangle_p0,
+                          vec3 triangle_p1,
+                          vec3 triangle_p2,
+                          vec3 triangle_normal,
+                          float* hit_dist,
+                          vec3 hit_normal)
+{
+  float best = -1.0f;
+
+  // Starting out overlapping the triangle
+  {
+    vec3 closest;
+    closest_point_on_triangle(origin, triangle_p0, triangle_p1, triangle_p2, closest);
+    if (glm_vec3_distance2(origin, closest) <= radius * radius)
+    {
+      best = 0.0f;
+    }
+  }
+
+  // Face, the sphere touches the plane at the point of contact first
+  if (best < 0.0f)
+  {
+    vec3 m;
+    glm_vec3_sub(origin, triangle_p0, m);
+
+    vec3 normal;
+    float side = glm_vec3_dot(m, triangle_normal);
+    if (side >= 0.0f)
+    {
+      glm_vec3_copy(triangle_normal, normal);
+    }
+    else
+    {
+      glm_vec3_negate_to(triangle_normal, normal);
+      side = -side;
+    }
+
+    const float approach = -glm_vec3_dot(dir, normal);
+    if (approach > 0.0f && side >= radius)
+    {
+      const float t = (side - radius) / approach;
+
+      vec3 contact, closest;
+      glm_vec3_copy(origin, contact);
+      glm_vec3_muladds(dir, t, contact);
+      glm_vec3_muladds(normal, -radius, contact);
+      closest_point_on_triangle(contact, triangle_p0, triangle_p1, triangle_p2, closest);
+
+      const float scale = glm_max(glm_vec3_norm2(contact), 1.0f);
+      if (glm_vec3_distance2(contact, closest) <= 1e-10f * scale)
+      {
+        best = t;
+      }
+    }
+  }
+
+  // Edges and corners, which can only be hit first if the face is not
+  if (best < 0.0f && radius > 0.0f)
+  {
+    vec3* const corners[3] = { (vec3*)triangle_p0, (vec3*)triangle_p1, (vec3*)triangle_p2 };
+    for (int corner = 0; corner < 3; ++corner)
+    {
+      float t = ray_cylinder_entry(origin, dir, *corners[corner], *corners[(corner + 1) % 3], radius);
+      if (t >= 0.0f && (best < 0.0f || t < best))
+      {
+        best = t;
+      }
+
+      t = ray_sphere_entry(origin, dir, *corners[corner], radius);
+      if (t >= 0.0f && (best < 0.0f || t < best))
+      {
+        best = t;
+      }
+    }
+  }
+
+  if (best < 0.0f || best > max_dist)
+  {
+    return false;
+  }
+
+  *hit_dist = best;
+
+  // The normal points from the closest point on the triangle towards the center of the sphere when it hits
+  vec3 center, closest;
+  glm_vec3_copy(origin, center);
+  glm_vec3_muladds(dir, best, center);
+  closest_point_on_triangle(center, triangle_p0, triangle_p1, triangle_p2, closest);
+  glm_vec3_sub(center, closest, hit_normal);
+
+  const float length = glm_vec3_norm(hit_normal);
+  if (length > FLT_EPSILON)
+  {
+    glm_vec3_scale(hit_normal, 1.0f / length, hit_normal);
+  }
+  else
+  {
+    // A ray that hits the face, facing back towards where it came from
+    glm_vec3_copy(triangle_normal, hit_normal);
+    if (glm_vec3_dot(hit_normal, dir) > 0.0f)
+    {
+      glm_vec3_negate(hit_normal);
+    }
+  }
+
+  return true;
+}
+
+void make_capsule_query(vec3 capsule_base, vec3 capsule_tip, float capsule_radius, struct CapsuleQuery* query)
+{
+  glm_vec3_copy(capsule_base, query->base);
+  glm_vec3_copy(capsule_tip, query->tip);
+
+  glm_vec3_sub(capsule_tip, capsule_base, query->axis);
+  glm_vec3_normalize(query->axis);
+
+  vec3 line_end_offset;
+  glm_vec3_scale(query->axis, capsule_radius, line_end_offset);
+
+  glm_vec3_add(capsule_base, line_end_offset, query->a);
+  glm_vec3_sub(capsule_tip, line_end_offset, query->b);
+
+  query->radius = capsule_radius;
+}
+
+#ifndef COLLISION_BATCH_X86
+static void get_batch_triangle(const struct TriangleBatch* batch, uint32_t lane, vec3 p0, vec3 p1, vec3 p2, vec3 n)
+{
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    p0[axis] = batch->p0[axis][lane];
+    p1[axis] = batch->p1[axis][lane];
+    p2[axis] = batch->p2[axis][lane];
+    n[axis] = batch->normal[axis][lane];
+  }
+}
+
+static uint32_t sphere_triangle_batch_collision_scalar(vec3 sphere_pos,
+                                                       float sphere_radius,
+                                                       const struct TriangleBatch* batch,
+                                                       float pen_normals[3][COLLISION_BATCH_SIZE],
+                                                       float pen_depths[COLLISION_BATCH_SIZE])
+{
+  uint32_t mask = 0;
+  for (uint32_t lane = 0; lane < COLLISION_BATCH_SIZE; ++lane)
+  {
+    vec3 p0, p1, p2, n, pen_normal;
+    get_batch_triangle(batch, lane, p0, p1, p2, n);
+
+    if (sphere_triangle_collision(sphere_pos, sphere_radius, p0, p1, p2, n, pen_normal, &pen_depths[lane]))
+    {
+      pen_normals[0][lane] = pen_normal[0];
+      pen_normals[1][lane] = pen_normal[1];
+      pen_normals[2][lane] = pen_normal[2];
+      mask |= 1 << lane;
+    }
+  }
+
+  return mask;
+}
+
+static uint32_t capsule_triangle_batch_collision_scalar(const struct CapsuleQuery* query,
+                                                        const struct TriangleBatch* batch,
+                                                        float pen_normals[3][COLLISION_BATCH_SIZE],
+                                                        float pen_depths[COLLISION_BATCH_SIZE])
+{
+  vec3 base, tip;
+  glm_vec3_copy((float*)query->base, base);
+  glm_vec3_copy((float*)query->tip, tip);
+
+  uint32_t mask = 0;
+  for (uint32_t lane = 0; lane < COLLISION_BATCH_SIZE; ++lane)
+  {
+    vec3 p0, p1, p2, n, pen_normal;
+    get_batch_triangle(batch, lane, p0, p1, p2, n);
+
+    if (capsule_triangle_collision(base, tip, query->radius, p0, p1, p2, n, pen_normal, &pen_depths[lane]))
+    {
+      pen_normals[0][lane] = pen_normal[0];
+      pen_normals[1][lane] = pen_normal[1];
+      pen_normals[2][lane] = pen_normal[2];
+      mask |= 1 << lane;
+    }
+  }
+
+  return mask;
+}
+#else
+  // SSE, 4 lanes
+  #define BATCH_WIDTH 4
+  #define BATCH_FN(name) name##_sse
+  #define BATCH_TARGET
+  #define vfloat __m128
+  #define V_LOAD _mm_loadu_ps
+  #define V_STORE _mm_storeu_ps
+  #define V_SET1 _mm_set1_ps
+  #define V_ADD _mm_add_ps
+  #define V_SUB _mm_sub_ps
+  #define V_MUL _mm_mul_ps
+  #define V_DIV _mm_div_ps
+  #define V_MIN _mm_min_ps
+  #define V_MAX _mm_max_ps
+  #define V_SQRT _mm_sqrt_ps
+  #define V_AND _mm_and_ps
+  #define V_OR _mm_or_ps
+  #define V_ANDNOT _mm_andnot_ps
+  #define V_CMPLE _mm_cmple_ps
+  #define V_CMPLT _mm_cmplt_ps
+  #define V_CMPGT _mm_cmpgt_ps
+  #define V_SELECT(mask, if_true, if_false) _mm_or_ps(_mm_and_ps(mask, if_true), _mm_andnot_ps(mask, if_false))
+  #define V_MOVEMASK _mm_movemask_ps
+  #include "collision_batch.h"
+  #undef BATCH_WIDTH
+  #undef BATCH_FN
+  #undef BATCH_TARGET
+  #undef vfloat
+  #undef V_LOAD
+  #undef V_STORE
+  #undef V_SET1
+  #undef V_ADD
+  #undef V_SUB
+  #undef V_MUL
+  #undef V_DIV
+  #undef V_MIN
+  #undef V_MAX
+  #undef V_SQRT
+  #undef V_AND
+  #undef V_OR
+  #undef V_ANDNOT
+  #undef V_CMPLE
+  #undef V_CMPLT
+  #undef V_CMPGT
+  #undef V_SELECT
+  #undef V_MOVEMASK
+
+  // AVX2, 8 lanes
+  #define BATCH_WIDTH 8
+  #define BATCH_FN(name) name##_avx2
+  #if defined(__GNUC__) || defined(__clang__)
+    #define BATCH_TARGET __attribute__((target("avx2")))
+  #else
+    #define BATCH_TARGET
+  #endif
+  #define vfloat __m256
+  #define V_LOAD _mm256_loadu_ps
+  #define V_STORE _mm256_storeu_ps
+  #define V_SET1 _mm256_set1_ps
+  #define V_ADD _mm256_add_ps
+  #define V_SUB _mm256_sub_ps
+  #define V_MUL _mm256_mul_ps
+  #define V_DIV _mm256_div_ps
+  #define V_MIN _mm256_min_ps
+  #define V_MAX _mm256_max_ps
+  #define V_SQRT _mm256_sqrt_ps
+  #define V_AND _mm256_and_ps
+  #define V_OR _mm256_or_ps
+  #define V_ANDNOT _mm256_andnot_ps
+  #define V_CMPLE(a, b) _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+  #define V_CMPLT(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+  #define V_CMPGT(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+  #define V_SELECT(mask, if_true, if_false) _mm256_blendv_ps(if_false, if_true, mask)
+  #define V_MOVEMASK _mm256_movemask_ps
+  #include "collision_batch.h"
+  #undef BATCH_WIDTH
+  #undef BATCH_FN
+  #undef BATCH_TARGET
+  #undef vfloat
+  #undef V_LOAD
+  #undef V_STORE
+  #undef V_SET1
+  #undef V_ADD
+  #undef V_SUB
+  #undef V_MUL
+  #undef V_DIV
+  #undef V_MIN
+  #undef V_MAX
+  #undef V_SQRT
+  #undef V_AND
+  #undef V_OR
+  #undef V_ANDNOT
+  #undef V_CMPLE
+  #undef V_CMPLT
+  #undef V_CMPGT
+  #undef V_SELECT
+  #undef V_MOVEMASK
+
+static bool cpu_supports_avx2()
+{
+  #if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+  {
+    return false;
+  }
+
+  // The OS also has to preserve the AVX registers across context switches
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+  {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+  #else
+  return __builtin_cpu_supports("avx2");
+  #endif
+}
+#endif
+
+void init_batch_collision()
+{
+#ifdef COLLISION_BATCH_X86
+  if (cpu_supports_avx2())
+  {
+    sphere_batch_function = sphere_triangle_batch_collision_avx2;
+    capsule_batch_function = capsule_triangle_batch_collision_avx2;
+    batch_isa = "AVX2";
+  }
+  else
+  {
+    sphere_batch_function = sphere_triangle_batch_collision_sse;
+    capsule_batch_function = capsule_triangle_batch_collision_sse;
+    batch_isa = "SSE";
+  }
+#else
+  sphere_batch_function = sphere_triangle_batch_collision_scalar;
+  capsule_batch_function = capsule_triangle_batch_collision_scalar;
+  batch_isa = "scalar";
+#endif
+}
+
+uint32_t sphere_triangle_batch_collision(vec3 sphere_pos,
+                                         float sphere_radius,
+                                         const struct TriangleBatch* batch,
+                                         uint32_t count,
+                                         float pen_normals[3][COLLISION_BATCH_SIZE],
+                                         float pen_depths[COLLISION_BATCH_SIZE])
+{
+  const uint32_t lanes = (1u << count) - 1;
+  return sphere_batch_function(sphere_pos, sphere_radius, batch, pen_normals, pen_depths) & lanes;
+}
+
+uint32_t capsule_triangle_batch_collision(const struct CapsuleQuery* query,
+                                          const struct TriangleBatch* batch,
+                                          uint32_t count,
+                                          float pen_normals[3][COLLISION_BATCH_SIZE],
+                                          float pen_depths[COLLISION_BATCH_SIZE])
+{
+  const uint32_t lanes = (1u << count) - 1;
+  return capsule_batch_function(query, batch, pen_normals, pen_depths) & lanes;
+}
+
+const char* get_batch_collision_isa()
+{
+  return batch_isa;
+}
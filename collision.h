@@ -3,6 +3,32 @@
 #include <cglm/types.h>
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#define COLLISION_BATCH_SIZE 8
+
+#define SWEEP_TOLERANCE 0.001f // How close to the skin distance a sweep has to get to count as a hit
+
+// Triangles in structure-of-arrays layout for the batched collision functions, one triangle per lane
+struct TriangleBatch
+{
+  float p0[3][COLLISION_BATCH_SIZE];
+  float p1[3][COLLISION_BATCH_SIZE];
+  float p2[3][COLLISION_BATCH_SIZE];
+  float normal[3][COLLISION_BATCH_SIZE];
+  float e0[3][COLLISION_BATCH_SIZE]; // Edge vectors p1 - p0, p2 - p1 and p0 - p2
+  float e1[3][COLLISION_BATCH_SIZE];
+  float e2[3][COLLISION_BATCH_SIZE];
+};
+
+// Everything about a capsule that does not depend on the triangle it is tested against
+struct CapsuleQuery
+{
+  vec3 base, tip;
+  vec3 axis; // Normalized
+  vec3 a, b; // Centers of the end spheres
+  float radius;
+};
 
 bool sphere_triangle_collision(vec3 sphere_pos,
                                float sphere_radius,
@@ -22,3 +48,68 @@ bool capsule_triangle_collision(vec3 capsule_base,
                                 vec3 triangle_normal,
                                 vec3 pen_normal,
                                 float* pen_depth);
+
+void closest_point_on_triangle(vec3 p, vec3 triangle_p0, vec3 triangle_p1, vec3 triangle_p2, vec3 closest);
+
+// Returns the distance between a segment and a triangle, along with the closest points on both
+float segment_triangle_distance(vec3 segment_a,
+                                vec3 segment_b,
+                                vec3 triangle_p0,
+                                vec3 triangle_p1,
+                                vec3 triangle_p2,
+                                vec3 triangle_normal,
+                                vec3 closest_segment,
+                                vec3 closest_triangle);
+
+// Moves a capsule by up to motion until it comes within skin of the triangle while moving towards it
+// Returns whether it does, and if so the fraction of motion until then (time of impact) and the contact normal
+bool capsule_triangle_sweep(vec3 capsule_base,
+                            vec3 capsule_tip,
+                            float capsule_radius,
+                            vec3 motion,
+                            float skin,
+                            vec3 triangle_p0,
+                            vec3 triangle_p1,
+                            vec3 triangle_p2,
+                            vec3 triangle_normal,
+                            float* toi,
+                            vec3 hit_normal);
+
+// Moves a sphere from origin along the normalized direction dir until it touches the triangle
+// A radius of 0 casts a ray instead
+// Returns whether it does within max_dist, and if so the distance until then and the contact normal
+bool sphere_triangle_cast(vec3 origin,
+                          vec3 dir,
+                          float radius,
+                          float max_dist,
+                          vec3 triangle_p0,
+                          vec3 triangle_p1,
+                          vec3 triangle_p2,
+                          vec3 triangle_normal,
+                          float* hit_dist,
+                          vec3 hit_normal);
+
+void make_capsule_query(vec3 capsule_base, vec3 capsule_tip, float capsule_radius, struct CapsuleQuery* query);
+
+// Picks the fastest implementation of the batched functions for this CPU, call once before any of them and before
+// starting any other thread that could call them
+void init_batch_collision();
+
+// The batched functions test against the first count (at most COLLISION_BATCH_SIZE) triangles of a batch and return a
+// bit mask of the colliding lanes, penetration normals and depths are only valid for those lanes
+// Results match the single triangle functions up to floating point rounding (within 1e-5 for level-sized coordinates)
+uint32_t sphere_triangle_batch_collision(vec3 sphere_pos,
+                                         float sphere_radius,
+                                         const struct TriangleBatch* batch,
+                                         uint32_t count,
+                                         float pen_normals[3][COLLISION_BATCH_SIZE],
+                                         float pen_depths[COLLISION_BATCH_SIZE]);
+
+uint32_t capsule_triangle_batch_collision(const struct CapsuleQuery* query,
+                                          const struct TriangleBatch* batch,
+                                          uint32_t count,
+                                          float pen_normals[3][COLLISION_BATCH_SIZE],
+                                          float pen_depths[COLLISION_BATCH_SIZE]);
+
+// Name of the instruction set used by the batched functions on this CPU
+const char* get_batch_collision_isa();
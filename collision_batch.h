@@ -0,0 +1,254 @@
+// Batched sphere/capsule-triangle kernels, written once against a small set of vector macros
+// This file is included by collision.c once per instruction set and must not be included anywhere else
+//
+// Expected macros:
+//   BATCH_WIDTH     Number of lanes per vector
+//   BATCH_FN(name)  Decorates a function name with the instruction set suffix
+//   BATCH_TARGET    Function attributes needed to compile for the instruction set
+//   vfloat          Vector type
+//   V_LOAD, V_STORE, V_SET1, V_ADD, V_SUB, V_MUL, V_DIV, V_MIN, V_MAX, V_SQRT, V_AND, V_OR, V_ANDNOT (~a & b),
+//   V_CMPLE, V_CMPLT, V_CMPGT, V_SELECT(mask, if_true, if_false), V_MOVEMASK
+//
+// The operations are ordered exactly like in the scalar functions so that results match them
+
+struct BATCH_FN(Vec3)
+{
+  vfloat x, y, z;
+};
+
+BATCH_TARGET static inline struct BATCH_FN(Vec3) BATCH_FN(load3)(const float v[3][COLLISION_BATCH_SIZE], uint32_t offset)
+{
+  struct BATCH_FN(Vec3) result = { V_LOAD(&v[0][offset]), V_LOAD(&v[1][offset]), V_LOAD(&v[2][offset]) };
+  return result;
+}
+
+BATCH_TARGET static inline struct BATCH_FN(Vec3) BATCH_FN(splat3)(const vec3 v)
+{
+  struct BATCH_FN(Vec3) result = { V_SET1(v[0]), V_SET1(v[1]), V_SET1(v[2]) };
+  return result;
+}
+
+BATCH_TARGET static inline struct BATCH_FN(Vec3) BATCH_FN(add3)(struct BATCH_FN(Vec3) a, struct BATCH_FN(Vec3) b)
+{
+  struct BATCH_FN(Vec3) result = { V_ADD(a.x, b.x), V_ADD(a.y, b.y), V_ADD(a.z, b.z) };
+  return result;
+}
+
+BATCH_TARGET static inline struct BATCH_FN(Vec3) BATCH_FN(sub3)(struct BATCH_FN(Vec3) a, struct BATCH_FN(Vec3) b)
+{
+  struct BATCH_FN(Vec3) result = { V_SUB(a.x, b.x), V_SUB(a.y, b.y), V_SUB(a.z, b.z) };
+  return result;
+}
+
+BATCH_TARGET static inline struct BATCH_FN(Vec3) BATCH_FN(scale3)(struct BATCH_FN(Vec3) v, vfloat s)
+{
+  struct BATCH_FN(Vec3) result = { V_MUL(v.x, s), V_MUL(v.y, s), V_MUL(v.z, s) };
+  return result;
+}
+
+BATCH_TARGET static inline vfloat BATCH_FN(dot3)(struct BATCH_FN(Vec3) a, struct BATCH_FN(Vec3) b)
+{
+  return V_ADD(V_ADD(V_MUL(a.x, b.x), V_MUL(a.y, b.y)), V_MUL(a.z, b.z));
+}
+
+BATCH_TARGET static inline struct BATCH_FN(Vec3) BATCH_FN(cross3)(struct BATCH_FN(Vec3) a, struct BATCH_FN(Vec3) b)
+{
+  struct BATCH_FN(Vec3) result = { V_SUB(V_MUL(a.y, b.z), V_MUL(a.z, b.y)), V_SUB(V_MUL(a.z, b.x), V_MUL(a.x, b.z)),
+                                   V_SUB(V_MUL(a.x, b.y), V_MUL(a.y, b.x)) };
+  return result;
+}
+
+BATCH_TARGET static inline struct BATCH_FN(Vec3)
+  BATCH_FN(select3)(vfloat mask, struct BATCH_FN(Vec3) if_true, struct BATCH_FN(Vec3) if_false)
+{
+  struct BATCH_FN(Vec3) result = { V_SELECT(mask, if_true.x, if_false.x), V_SELECT(mask, if_true.y, if_false.y),
+                                   V_SELECT(mask, if_true.z, if_false.z) };
+  return result;
+}
+
+// Same as closest_point_on_line in collision.c, but with the precomputed edge vector b - a
+BATCH_TARGET static inline struct BATCH_FN(Vec3)
+  BATCH_FN(closest_point_on_edge)(struct BATCH_FN(Vec3) a, struct BATCH_FN(Vec3) edge, struct BATCH_FN(Vec3) p)
+{
+  const struct BATCH_FN(Vec3) w = BATCH_FN(sub3)(p, a);
+
+  const vfloat d0 = BATCH_FN(dot3)(w, edge);
+  const vfloat d1 = BATCH_FN(dot3)(edge, edge);
+  const vfloat t = V_MIN(V_MAX(V_DIV(d0, d1), V_SET1(0.0f)), V_SET1(1.0f));
+
+  return BATCH_FN(add3)(a, BATCH_FN(scale3)(edge, t));
+}
+
+BATCH_TARGET static inline struct BATCH_FN(Vec3)
+  BATCH_FN(closest_point_on_line)(struct BATCH_FN(Vec3) a, struct BATCH_FN(Vec3) b, struct BATCH_FN(Vec3) p)
+{
+  return BATCH_FN(closest_point_on_edge)(a, BATCH_FN(sub3)(b, a), p);
+}
+
+// Tests BATCH_WIDTH spheres against the triangles in the lanes starting at offset
+BATCH_TARGET static uint32_t BATCH_FN(sphere_lanes)(struct BATCH_FN(Vec3) sphere_pos,
+                                                     float sphere_radius,
+                                                     const struct TriangleBatch* batch,
+                                                     uint32_t offset,
+                                                     float pen_normals[3][COLLISION_BATCH_SIZE],
+                                                     float pen_depths[COLLISION_BATCH_SIZE])
+{
+  const struct BATCH_FN(Vec3) p0 = BATCH_FN(load3)(batch->p0, offset);
+  const struct BATCH_FN(Vec3) p1 = BATCH_FN(load3)(batch->p1, offset);
+  const struct BATCH_FN(Vec3) p2 = BATCH_FN(load3)(batch->p2, offset);
+  const struct BATCH_FN(Vec3) normal = BATCH_FN(load3)(batch->normal, offset);
+  const struct BATCH_FN(Vec3) e0 = BATCH_FN(load3)(batch->e0, offset);
+  const struct BATCH_FN(Vec3) e1 = BATCH_FN(load3)(batch->e1, offset);
+  const struct BATCH_FN(Vec3) e2 = BATCH_FN(load3)(batch->e2, offset);
+
+  const vfloat radius = V_SET1(sphere_radius);
+  const vfloat zero = V_SET1(0.0f);
+
+  // Step 1: Plane-sphere check
+  const vfloat dist = BATCH_FN(dot3)(BATCH_FN(sub3)(sphere_pos, p0), normal);
+  const vfloat out_of_range = V_OR(V_CMPLT(dist, V_SUB(zero, radius)), V_CMPGT(dist, radius));
+  if (V_MOVEMASK(out_of_range) == (1 << BATCH_WIDTH) - 1)
+  {
+    return 0;
+  }
+
+  // Step 2: Triangle-sphere check
+  const struct BATCH_FN(Vec3) point0 = BATCH_FN(sub3)(sphere_pos, BATCH_FN(scale3)(normal, dist));
+
+  vfloat inside;
+  {
+    const struct BATCH_FN(Vec3) c0 = BATCH_FN(cross3)(BATCH_FN(sub3)(point0, p0), e0);
+    const struct BATCH_FN(Vec3) c1 = BATCH_FN(cross3)(BATCH_FN(sub3)(point0, p1), e1);
+    const struct BATCH_FN(Vec3) c2 = BATCH_FN(cross3)(BATCH_FN(sub3)(point0, p2), e2);
+
+    inside = V_AND(V_AND(V_CMPLE(BATCH_FN(dot3)(c0, normal), zero), V_CMPLE(BATCH_FN(dot3)(c1, normal), zero)),
+                   V_CMPLE(BATCH_FN(dot3)(c2, normal), zero));
+  }
+
+  const vfloat radius_sq = V_SET1(sphere_radius * sphere_radius);
+
+  const struct BATCH_FN(Vec3) d1 = BATCH_FN(sub3)(sphere_pos, BATCH_FN(closest_point_on_edge)(p1, e1, sphere_pos));
+  const struct BATCH_FN(Vec3) d2 = BATCH_FN(sub3)(sphere_pos, BATCH_FN(closest_point_on_edge)(p0, e0, sphere_pos));
+  const struct BATCH_FN(Vec3) d3 = BATCH_FN(sub3)(sphere_pos, BATCH_FN(closest_point_on_edge)(p2, e2, sphere_pos));
+
+  const vfloat dist_sq1 = BATCH_FN(dot3)(d1, d1);
+  const vfloat dist_sq2 = BATCH_FN(dot3)(d2, d2);
+  const vfloat dist_sq3 = BATCH_FN(dot3)(d3, d3);
+
+  const vfloat intersects =
+    V_OR(V_OR(V_CMPLT(dist_sq1, radius_sq), V_CMPLT(dist_sq2, radius_sq)), V_CMPLT(dist_sq3, radius_sq));
+
+  const uint32_t mask = (uint32_t)V_MOVEMASK(V_ANDNOT(out_of_range, V_OR(inside, intersects)));
+  if (mask == 0)
+  {
+    return 0;
+  }
+
+  // Pick the closest edge point, or the projected point if it is inside the triangle
+  struct BATCH_FN(Vec3) intersection_vec;
+  {
+    const vfloat closer2 = V_CMPLT(dist_sq2, dist_sq1);
+    const vfloat best_dist_sq = V_SELECT(closer2, dist_sq2, dist_sq1);
+    intersection_vec = BATCH_FN(select3)(closer2, d2, d1);
+
+    const vfloat closer3 = V_CMPLT(dist_sq3, best_dist_sq);
+    intersection_vec = BATCH_FN(select3)(closer3, d3, intersection_vec);
+
+    intersection_vec = BATCH_FN(select3)(inside, BATCH_FN(sub3)(sphere_pos, point0), intersection_vec);
+  }
+
+  const vfloat len = V_SQRT(BATCH_FN(dot3)(intersection_vec, intersection_vec));
+  V_STORE(&pen_normals[0][offset], V_DIV(intersection_vec.x, len));
+  V_STORE(&pen_normals[1][offset], V_DIV(intersection_vec.y, len));
+  V_STORE(&pen_normals[2][offset], V_DIV(intersection_vec.z, len));
+  V_STORE(&pen_depths[offset], V_SUB(radius, len));
+
+  return mask;
+}
+
+BATCH_TARGET static uint32_t BATCH_FN(sphere_triangle_batch_collision)(vec3 sphere_pos,
+                                                                        float sphere_radius,
+                                                                        const struct TriangleBatch* batch,
+                                                                        float pen_normals[3][COLLISION_BATCH_SIZE],
+                                                                        float pen_depths[COLLISION_BATCH_SIZE])
+{
+  const struct BATCH_FN(Vec3) center = BATCH_FN(splat3)(sphere_pos);
+
+  uint32_t mask = 0;
+  for (uint32_t offset = 0; offset < COLLISION_BATCH_SIZE; offset += BATCH_WIDTH)
+  {
+    mask |= BATCH_FN(sphere_lanes)(center, sphere_radius, batch, offset, pen_normals, pen_depths) << offset;
+  }
+
+  return mask;
+}
+
+BATCH_TARGET static uint32_t BATCH_FN(capsule_triangle_batch_collision)(const struct CapsuleQuery* query,
+                                                                         const struct TriangleBatch* batch,
+                                                                         float pen_normals[3][COLLISION_BATCH_SIZE],
+                                                                         float pen_depths[COLLISION_BATCH_SIZE])
+{
+  const struct BATCH_FN(Vec3) base = BATCH_FN(splat3)(query->base);
+  const struct BATCH_FN(Vec3) axis = BATCH_FN(splat3)(query->axis);
+  const struct BATCH_FN(Vec3) a = BATCH_FN(splat3)(query->a);
+  const struct BATCH_FN(Vec3) b = BATCH_FN(splat3)(query->b);
+
+  uint32_t mask = 0;
+  for (uint32_t offset = 0; offset < COLLISION_BATCH_SIZE; offset += BATCH_WIDTH)
+  {
+    const struct BATCH_FN(Vec3) p0 = BATCH_FN(load3)(batch->p0, offset);
+    const struct BATCH_FN(Vec3) p1 = BATCH_FN(load3)(batch->p1, offset);
+    const struct BATCH_FN(Vec3) p2 = BATCH_FN(load3)(batch->p2, offset);
+    const struct BATCH_FN(Vec3) normal = BATCH_FN(load3)(batch->normal, offset);
+    const struct BATCH_FN(Vec3) e0 = BATCH_FN(load3)(batch->e0, offset);
+    const struct BATCH_FN(Vec3) e1 = BATCH_FN(load3)(batch->e1, offset);
+    const struct BATCH_FN(Vec3) e2 = BATCH_FN(load3)(batch->e2, offset);
+
+    // Intersect the capsule axis with the triangle plane
+    struct BATCH_FN(Vec3) line_plane_intersection;
+    {
+      const vfloat d = BATCH_FN(dot3)(normal, axis);
+      const vfloat abs_d = V_MAX(d, V_SUB(V_SET1(0.0f), d));
+      const vfloat t = V_DIV(BATCH_FN(dot3)(normal, BATCH_FN(sub3)(p0, base)), abs_d);
+      line_plane_intersection = BATCH_FN(add3)(base, BATCH_FN(scale3)(axis, t));
+    }
+
+    // Use the intersection as reference point if it is inside the triangle, otherwise the closest edge point
+    struct BATCH_FN(Vec3) reference_point;
+    {
+      const vfloat zero = V_SET1(0.0f);
+      const struct BATCH_FN(Vec3) c0 = BATCH_FN(cross3)(BATCH_FN(sub3)(line_plane_intersection, p0), e0);
+      const struct BATCH_FN(Vec3) c1 = BATCH_FN(cross3)(BATCH_FN(sub3)(line_plane_intersection, p1), e1);
+      const struct BATCH_FN(Vec3) c2 = BATCH_FN(cross3)(BATCH_FN(sub3)(line_plane_intersection, p2), e2);
+
+      const vfloat inside =
+        V_AND(V_AND(V_CMPLE(BATCH_FN(dot3)(c0, normal), zero), V_CMPLE(BATCH_FN(dot3)(c1, normal), zero)),
+              V_CMPLE(BATCH_FN(dot3)(c2, normal), zero));
+
+      const struct BATCH_FN(Vec3) point1 = BATCH_FN(closest_point_on_edge)(p0, e0, line_plane_intersection);
+      const struct BATCH_FN(Vec3) point2 = BATCH_FN(closest_point_on_edge)(p1, e1, line_plane_intersection);
+      const struct BATCH_FN(Vec3) point3 = BATCH_FN(closest_point_on_edge)(p2, e2, line_plane_intersection);
+
+      const struct BATCH_FN(Vec3) v1 = BATCH_FN(sub3)(line_plane_intersection, point1);
+      const struct BATCH_FN(Vec3) v2 = BATCH_FN(sub3)(line_plane_intersection, point2);
+      const struct BATCH_FN(Vec3) v3 = BATCH_FN(sub3)(line_plane_intersection, point3);
+
+      const vfloat dist_sq1 = BATCH_FN(dot3)(v1, v1);
+      const vfloat dist_sq2 = BATCH_FN(dot3)(v2, v2);
+      const vfloat dist_sq3 = BATCH_FN(dot3)(v3, v3);
+
+      const vfloat closer2 = V_CMPLT(dist_sq2, dist_sq1);
+      const vfloat best_dist_sq = V_SELECT(closer2, dist_sq2, dist_sq1);
+      reference_point = BATCH_FN(select3)(closer2, point2, point1);
+      reference_point = BATCH_FN(select3)(V_CMPLT(dist_sq3, best_dist_sq), point3, reference_point);
+      reference_point = BATCH_FN(select3)(inside, line_plane_intersection, reference_point);
+    }
+
+    // The center of the best sphere candidate
+    const struct BATCH_FN(Vec3) center = BATCH_FN(closest_point_on_line)(a, b, reference_point);
+
+    mask |= BATCH_FN(sphere_lanes)(center, query->radius, batch, offset, pen_normals, pen_depths) << offset;
+  }
+
+  return mask;
+}
@@ -0,0 +1,232 @@
+#include "collision_mesh.h"
+
+#include <cglm/vec3.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Triangles with a smaller (doubled) area than this are degenerate and can not be collided with
+#define MIN_TRIANGLE_AREA 1e-10f
+
+#define FLOAT_ARRAY_COUNT 22 // p0, p1, p2, normal and edges with 3 arrays each, plus the plane distance
+
+size_t get_collision_mesh_data_size(uint32_t triangle_count)
+{
+  return sizeof(float) * FLOAT_ARRAY_COUNT * triangle_count + sizeof(vec3) * 2 * triangle_count;
+}
+
+// Points all arrays of the mesh into a single block of data
+static void assign_arrays(struct CollisionMesh* mesh, void* data)
+{
+  float* next = data;
+  const uint32_t count = mesh->triangle_count;
+
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    mesh->p0[axis] = next;
+    next += count;
+    mesh->p1[axis] = next;
+    next += count;
+    mesh->p2[axis] = next;
+    next += count;
+    mesh->normal[axis] = next;
+    next += count;
+    mesh->e0[axis] = next;
+    next += count;
+    mesh->e1[axis] = next;
+    next += count;
+    mesh->e2[axis] = next;
+    next += count;
+  }
+
+  mesh->distance = next;
+  next += count;
+
+  mesh->mins = (vec3*)next;
+  mesh->maxs = mesh->mins + count;
+
+  mesh->data = data;
+}
+
+static bool get_face_normal(const vec3 v0, const vec3 v1, const vec3 v2, vec3 n)
+{
+  vec3 a, b;
+  glm_vec3_sub((float*)v1, (float*)v0, a);
+  glm_vec3_sub((float*)v2, (float*)v0, b);
+  glm_vec3_cross(a, b, n);
+
+  const float length = glm_vec3_norm(n);
+  if (length < MIN_TRIANGLE_AREA)
+  {
+    return false;
+  }
+
+  glm_vec3_divs(n, length, n);
+  return true;
+}
+
+static void get_vertex(const float* vertices, uint32_t floats_per_vertex, uint32_t index, vec3 v)
+{
+  v[0] = vertices[index * floats_per_vertex + 0];
+  v[1] = vertices[index * floats_per_vertex + 1];
+  v[2] = vertices[index * floats_per_vertex + 2];
+}
+
+struct CollisionMesh* make_collision_mesh(const float* vertices,
+                                          uint32_t floats_per_vertex,
+                                          const uint32_t* indices,
+                                          uint32_t index_count)
+{
+  struct CollisionMesh* mesh = malloc(sizeof(struct CollisionMesh));
+  if (!mesh)
+  {
+    printf("Ran out of memory while generating collision mesh\n");
+    return NULL;
+  }
+
+  // Count the triangles that are not degenerate
+  mesh->triangle_count = 0;
+  for (uint32_t index = 0; index + 2 < index_count; index += 3)
+  {
+    vec3 v0, v1, v2, n;
+    get_vertex(vertices, floats_per_vertex, indices[index + 0], v0);
+    get_vertex(vertices, floats_per_vertex, indices[index + 1], v1);
+    get_vertex(vertices, floats_per_vertex, indices[index + 2], v2);
+
+    if (get_face_normal(v0, v1, v2, n))
+    {
+      ++mesh->triangle_count;
+    }
+  }
+
+  const size_t data_size = get_collision_mesh_data_size(mesh->triangle_count);
+  void* data = malloc(data_size > 0 ? data_size : 1);
+  if (!data)
+  {
+    printf("Ran out of memory while generating collision mesh, requested %zu bytes for %u triangles\n", data_size,
+           mesh->triangle_count);
+    free(mesh);
+    return NULL;
+  }
+
+  assign_arrays(mesh, data);
+
+  uint32_t triangle = 0;
+  for (uint32_t index = 0; index + 2 < index_count; index += 3)
+  {
+    vec3 v0, v1, v2, n;
+    get_vertex(vertices, floats_per_vertex, indices[index + 0], v0);
+    get_vertex(vertices, floats_per_vertex, indices[index + 1], v1);
+    get_vertex(vertices, floats_per_vertex, indices[index + 2], v2);
+
+    if (!get_face_normal(v0, v1, v2, n))
+    {
+      continue;
+    }
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      mesh->p0[axis][triangle] = v0[axis];
+      mesh->p1[axis][triangle] = v1[axis];
+      mesh->p2[axis][triangle] = v2[axis];
+      mesh->normal[axis][triangle] = n[axis];
+      mesh->e0[axis][triangle] = v1[axis] - v0[axis];
+      mesh->e1[axis][triangle] = v2[axis] - v1[axis];
+      mesh->e2[axis][triangle] = v0[axis] - v2[axis];
+    }
+
+    mesh->distance[triangle] = glm_vec3_dot(n, v0);
+
+    glm_vec3_minv(v0, v1, mesh->mins[triangle]);
+    glm_vec3_minv(mesh->mins[triangle], v2, mesh->mins[triangle]);
+
+    glm_vec3_maxv(v0, v1, mesh->maxs[triangle]);
+    glm_vec3_maxv(mesh->maxs[triangle], v2, mesh->maxs[triangle]);
+
+    ++triangle;
+  }
+
+  return mesh;
+}
+
+void destroy_collision_mesh(struct CollisionMesh* mesh)
+{
+  free(mesh->data);
+  free(mesh);
+}
+
+void view_collision_mesh(struct CollisionMesh* mesh, uint32_t triangle_count, void* data)
+{
+  mesh->triangle_count = triangle_count;
+  assign_arrays(mesh, data);
+}
+
+bool reorder_collision_mesh(struct CollisionMesh* mesh, const uint32_t* order)
+{
+  const size_t data_size = get_collision_mesh_data_size(mesh->triangle_count);
+  void* data = malloc(data_size > 0 ? data_size : 1);
+  if (!data)
+  {
+    printf("Ran out of memory while reordering collision mesh, requested %zu bytes\n", data_size);
+    return false;
+  }
+
+  struct CollisionMesh old = *mesh;
+  assign_arrays(mesh, data);
+
+  for (uint32_t triangle = 0; triangle < mesh->triangle_count; ++triangle)
+  {
+    const uint32_t source = order[triangle];
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      mesh->p0[axis][triangle] = old.p0[axis][source];
+      mesh->p1[axis][triangle] = old.p1[axis][source];
+      mesh->p2[axis][triangle] = old.p2[axis][source];
+      mesh->normal[axis][triangle] = old.normal[axis][source];
+      mesh->e0[axis][triangle] = old.e0[axis][source];
+      mesh->e1[axis][triangle] = old.e1[axis][source];
+      mesh->e2[axis][triangle] = old.e2[axis][source];
+    }
+
+    mesh->distance[triangle] = old.distance[source];
+    glm_vec3_copy(old.mins[source], mesh->mins[triangle]);
+    glm_vec3_copy(old.maxs[source], mesh->maxs[triangle]);
+  }
+
+  free(old.data);
+
+  return true;
+}
+
+void get_collision_triangle(const struct CollisionMesh* mesh, uint32_t index, vec3 v0, vec3 v1, vec3 v2, vec3 n)
+{
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    v0[axis] = mesh->p0[axis][index];
+    v1[axis] = mesh->p1[axis][index];
+    v2[axis] = mesh->p2[axis][index];
+    n[axis] = mesh->normal[axis][index];
+  }
+}
+
+void get_collision_triangle_batch(const struct CollisionMesh* mesh,
+                                  const uint32_t* triangles,
+                                  uint32_t count,
+                                  struct TriangleBatch* batch)
+{
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    for (uint32_t lane = 0; lane < count; ++lane)
+    {
+      const uint32_t triangle = triangles[lane];
+      batch->p0[axis][lane] = mesh->p0[axis][triangle];
+      batch->p1[axis][lane] = mesh->p1[axis][triangle];
+      batch->p2[axis][lane] = mesh->p2[axis][triangle];
+      batch->normal[axis][lane] = mesh->normal[axis][triangle];
+      batch->e0[axis][lane] = mesh->e0[axis][triangle];
+      batch->e1[axis][lane] = mesh->e1[axis][triangle];
+      batch->e2[axis][lane] = mesh->e2[axis][triangle];
+    }
+  }
+}
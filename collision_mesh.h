@@ -0,0 +1,56 @@
+#pragma once
+
+#include "collision.h"
+
+#include <cglm/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Triangle data laid out for collision queries, kept separately from the render geometry
+// All per-triangle arrays are in structure-of-arrays layout and indexed by [axis][triangle]
+struct CollisionMesh
+{
+  uint32_t triangle_count;
+
+  float* p0[3];
+  float* p1[3];
+  float* p2[3];
+
+  float* normal[3]; // Face plane normal, following the winding of the triangle
+  float* distance;  // Face plane distance from the origin along the normal
+
+  float* e0[3]; // Edge vectors p1 - p0, p2 - p1 and p0 - p2
+  float* e1[3];
+  float* e2[3];
+
+  vec3* mins; // Per-triangle bounding boxes
+  vec3* maxs;
+
+  void* data; // Single block backing all of the arrays above
+};
+
+// Builds a collision mesh from an indexed triangle list, skipping degenerate triangles
+struct CollisionMesh* make_collision_mesh(const float* vertices,
+                                          uint32_t floats_per_vertex,
+                                          const uint32_t* indices,
+                                          uint32_t index_count);
+void destroy_collision_mesh(struct CollisionMesh* mesh);
+
+// Size of the single block backing all arrays of a mesh with the given number of triangles
+size_t get_collision_mesh_data_size(uint32_t triangle_count);
+
+// Points the arrays of a mesh into a block laid out like the data of another mesh with as many triangles, like a
+// cooked mesh mapped from disk, without copying it or taking ownership of it
+void view_collision_mesh(struct CollisionMesh* mesh, uint32_t triangle_count, void* data);
+
+// Reorders the triangles so that the new triangle i is the old triangle order[i]
+bool reorder_collision_mesh(struct CollisionMesh* mesh, const uint32_t* order);
+
+void get_collision_triangle(const struct CollisionMesh* mesh, uint32_t index, vec3 v0, vec3 v1, vec3 v2, vec3 n);
+
+// Fills the first count (at most COLLISION_BATCH_SIZE) lanes of a batch with the given triangles
+void get_collision_triangle_batch(const struct CollisionMesh* mesh,
+                                  const uint32_t* triangles,
+                                  uint32_t count,
+                                  struct TriangleBatch* batch);
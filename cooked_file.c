@@ -0,0 +1,53 @@
+#include "cooked_file.h"
+
+#include <stdio.h>
+
+bool get_cooked_filename(const char* filename, const char* extension, char* cooked_filename)
+{
+  const int length = snprintf(cooked_filename, MAX_COOKED_FILENAME_LENGTH, "%s%s", filename, extension);
+  if (length < 0 || length >= MAX_COOKED_FILENAME_LENGTH)
+  {
+    printf("Filename \"%s\" is too long to cook\n", filename);
+    return false;
+  }
+
+  return true;
+}
+
+uint64_t align_cooked_offset(uint64_t offset)
+{
+  return (offset + COOKED_ALIGNMENT - 1) / COOKED_ALIGNMENT * COOKED_ALIGNMENT;
+}
+
+bool map_cooked_file(const char* cooked_filename,
+                     size_t header_size,
+                     uint32_t magic,
+                     uint32_t version,
+                     struct MappedFile* file)
+{
+  if (!map_file(cooked_filename, file))
+  {
+    return false;
+  }
+
+  const struct CookedFileHeader* header = file->data;
+  if (file->size < header_size || header->magic != magic || header->version != version ||
+      header->file_size != file->size)
+  {
+    unmap_file(file);
+    return false;
+  }
+
+  return true;
+}
+
+uint64_t hash_data(uint64_t hash, const void* data, size_t size)
+{
+  const uint8_t* bytes = data;
+  for (size_t index = 0; index < size; ++index)
+  {
+    hash = (hash ^ bytes[index]) * 0x100000001B3ull;
+  }
+
+  return hash;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_COOKED_FILENAME_LENGTH 256
+#define COOKED_ALIGNMENT 64 // Sections of cooked files start on their own cache line, enough for any SIMD load
+
+#define HASH_SEED 0xCBF29CE484222325ull // To start hash_data from
+
+// At the start of every cooked file, as the first member of the header of its kind
+struct CookedFileHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t file_size; // Catches files that were cut short while being written
+};
+
+// Appends extension to filename, returns false if the result is MAX_COOKED_FILENAME_LENGTH or longer
+bool get_cooked_filename(const char* filename, const char* extension, char* cooked_filename);
+
+uint64_t align_cooked_offset(uint64_t offset);
+
+// Maps a cooked file whose header of header_size bytes is in full and has the given magic, version and file size
+// Returns false if the file is missing or was written for another kind or version
+bool map_cooked_file(const char* cooked_filename,
+                     size_t header_size,
+                     uint32_t magic,
+                     uint32_t version,
+                     struct MappedFile* file);
+
+// 64-bit FNV-1a, continuing from hash, which is HASH_SEED for the first block
+uint64_t hash_data(uint64_t hash, const void* data, size_t size);
@@ -0,0 +1,466 @@
+#include "cooked_mesh.h"
+
+#include "cooked_file.h"
+#include "geometry_data.h"
+#include "mesh_optimizer.h"
+#include "partition.h"
+#include "simplify.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COOKED_MAGIC 0x4B4F4F43 // "COOK" when read as little-endian
+#define COOKED_VERSION 7
+#define COOKED_EXTENSION ".cooked"
+
+enum Section
+{
+  SECTION_VERTICES, // In the vertex format of the header
+  SECTION_INDICES, // Relative to the base vertex of their submesh, 16 or 32 bits each
+  SECTION_SUBMESHES, // The submeshes of each level of detail in turn
+  SECTION_SUBMESH_BOUNDS, // Of each submesh of the full mesh
+  SECTION_COLLISION_MESH, // The single data block of the collision mesh
+  SECTION_BVH_NODES,
+  SECTION_BVH_PRIMITIVES,
+  SECTION_COUNT
+};
+
+// At the start of every cooked file, followed by the sections at the given offsets from the start of the file
+struct CookedHeader
+{
+  struct CookedFileHeader common;
+
+  // Of the source file when it was cooked, the cooked file is stale once either of them changes
+  uint64_t source_size;
+  int64_t source_modified_time; // Far finer than a second, so that an edit right after cooking still counts
+
+  uint32_t vertex_format;
+  uint32_t optimized;
+  uint32_t generated_lods;
+  float chunk_size;
+  uint32_t index_size;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint32_t floats_per_vertex; // Of the source, even if the vertices are packed
+  uint32_t submesh_count;
+  uint32_t triangle_count;
+  uint32_t node_count;
+  uint32_t primitive_count;
+
+  struct VertexQuantization quantization;
+  struct LodChain lods;
+
+  uint64_t section_offsets[SECTION_COUNT];
+  uint64_t section_sizes[SECTION_COUNT];
+};
+
+static bool build_collision(const struct Geometry* source, struct CollisionMesh** mesh, struct Bvh** tree)
+{
+  // The collision mesh spans all submeshes, so it needs indices into the whole vertex buffer
+  uint32_t* indices =
+    make_absolute_indices(source->indices, source->index_count, source->submeshes, source->submesh_count);
+  if (!indices)
+  {
+    return false;
+  }
+
+  *mesh = make_collision_mesh(source->vertices, source->floats_per_vertex, indices, source->index_count);
+  free(indices);
+  if (!*mesh)
+  {
+    return false;
+  }
+
+  *tree = make_bvh((const vec3*)(*mesh)->mins, (const vec3*)(*mesh)->maxs, (*mesh)->triangle_count);
+  if (!*tree)
+  {
+    destroy_collision_mesh(*mesh);
+    return false;
+  }
+
+  // Store the triangles in the order of the BVH leaves so that the triangles of a leaf are next to each other
+  if (!reorder_collision_mesh(*mesh, (*tree)->primitives))
+  {
+    destroy_bvh(*tree);
+    destroy_collision_mesh(*mesh);
+    return false;
+  }
+
+  for (uint32_t primitive = 0; primitive < (*tree)->primitive_count; ++primitive)
+  {
+    (*tree)->primitives[primitive] = primitive;
+  }
+
+  return true;
+}
+
+static uint64_t get_vertex_size(enum VertexFormat vertex_format, uint32_t floats_per_vertex)
+{
+  return vertex_format == VERTEX_FORMAT_PACKED ? sizeof(struct PackedVertex) : sizeof(float) * floats_per_vertex;
+}
+
+// Returns the indices narrowed to 16 bits, or NULL if any of them does not fit or there is no memory for them
+static uint16_t* narrow_indices(const uint32_t* indices, uint32_t index_count)
+{
+  for (uint32_t index = 0; index < index_count; ++index)
+  {
+    if (indices[index] > UINT16_MAX)
+    {
+      return NULL;
+    }
+  }
+
+  uint16_t* narrow = malloc(sizeof(uint16_t) * (index_count > 0 ? index_count : 1));
+  if (!narrow)
+  {
+    return NULL; // The wide indices work just as well
+  }
+
+  for (uint32_t index = 0; index < index_count; ++index)
+  {
+    narrow[index] = (uint16_t)indices[index];
+  }
+
+  return narrow;
+}
+
+// Loads the source file and lays out everything derived from it in a single block, exactly as in the file
+static void* cook_image(const char* filename,
+                        const struct CookOptions* options,
+                        uint64_t source_size,
+                        int64_t source_modified_time,
+                        size_t* image_size)
+{
+  struct Geometry* source = load_geometry(filename, GEOMETRY_TYPE_TRIS);
+  if (!source)
+  {
+    return NULL;
+  }
+
+  // Before anything else, so that the chunks are optimized and simplified on their own
+  if (!partition_geometry(source, options->chunk_size))
+  {
+    free_geometry(source);
+    return NULL;
+  }
+
+  if (options->optimize)
+  {
+    struct VertexCacheStats before, after;
+    if (!optimize_geometry(source, &before, &after))
+    {
+      free_geometry(source);
+      return NULL;
+    }
+
+    printf("Optimized \"%s\", ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", filename, before.acmr, after.acmr,
+           before.atvr, after.atvr);
+  }
+
+  struct CollisionMesh* mesh;
+  struct Bvh* bvh;
+  if (!build_collision(source, &mesh, &bvh))
+  {
+    free_geometry(source);
+    return NULL;
+  }
+
+  // Collision only uses the full mesh, the levels of detail are for rendering
+  if (options->lods && !generate_lods(source))
+  {
+    destroy_bvh(bvh);
+    destroy_collision_mesh(mesh);
+    free_geometry(source);
+    return NULL;
+  }
+
+  // From the full mesh, which the levels of detail never reach beyond
+  struct SubmeshBounds* bounds =
+    malloc(sizeof(struct SubmeshBounds) * (source->submesh_count > 0 ? source->submesh_count : 1));
+  if (!bounds)
+  {
+    printf("Ran out of memory while cooking \"%s\", requested bounds for %u submeshes\n", filename,
+           source->submesh_count);
+    destroy_bvh(bvh);
+    destroy_collision_mesh(mesh);
+    free_geometry(source);
+    return NULL;
+  }
+
+  get_submesh_bounds(source, bounds);
+
+  // Collision is built from the float vertices above, only the vertices for rendering are packed
+  struct CookedHeader header = { 0 };
+  const void* vertices = source->vertices;
+  struct PackedVertex* packed_vertices = NULL;
+  if (options->vertex_format == VERTEX_FORMAT_PACKED)
+  {
+    packed_vertices =
+      pack_vertices(source->vertices, source->floats_per_vertex, source->vertex_count, &header.quantization);
+    if (!packed_vertices)
+    {
+      free(bounds);
+      destroy_bvh(bvh);
+      destroy_collision_mesh(mesh);
+      free_geometry(source);
+      return NULL;
+    }
+
+    vertices = packed_vertices;
+  }
+
+  // Indices are relative to their submesh, so they usually fit into 16 bits even for large meshes
+  const void* indices = source->indices;
+  uint16_t* narrow = options->optimize ? narrow_indices(source->indices, source->index_count) : NULL;
+  if (narrow)
+  {
+    indices = narrow;
+  }
+
+  header.index_size = narrow ? sizeof(uint16_t) : sizeof(uint32_t);
+
+  header.common.magic = COOKED_MAGIC;
+  header.common.version = COOKED_VERSION;
+  header.source_size = source_size;
+  header.source_modified_time = source_modified_time;
+  header.vertex_format = options->vertex_format;
+  header.optimized = options->optimize;
+  header.generated_lods = options->lods;
+  header.chunk_size = options->chunk_size;
+  header.lods = source->lods;
+  header.vertex_count = source->vertex_count;
+  header.index_count = source->index_count;
+  header.floats_per_vertex = source->floats_per_vertex;
+  header.submesh_count = source->submesh_count;
+  header.triangle_count = mesh->triangle_count;
+  header.node_count = bvh->node_count;
+  header.primitive_count = bvh->primitive_count;
+
+  const void* sections[SECTION_COUNT] = {
+    vertices, indices, source->submeshes, bounds, mesh->data, bvh->nodes, bvh->primitives
+  };
+  header.section_sizes[SECTION_VERTICES] =
+    get_vertex_size(options->vertex_format, source->floats_per_vertex) * source->vertex_count;
+  header.section_sizes[SECTION_INDICES] = (uint64_t)header.index_size * source->index_count;
+  header.section_sizes[SECTION_SUBMESHES] = sizeof(struct Submesh) * source->submesh_count * source->lods.lod_count;
+  header.section_sizes[SECTION_SUBMESH_BOUNDS] = sizeof(struct SubmeshBounds) * source->submesh_count;
+  header.section_sizes[SECTION_COLLISION_MESH] = get_collision_mesh_data_size(mesh->triangle_count);
+  header.section_sizes[SECTION_BVH_NODES] = sizeof(struct BvhNode) * bvh->node_count;
+  header.section_sizes[SECTION_BVH_PRIMITIVES] = sizeof(uint32_t) * bvh->primitive_count;
+
+  uint64_t offset = align_cooked_offset(sizeof(struct CookedHeader));
+  for (int section = 0; section < SECTION_COUNT; ++section)
+  {
+    header.section_offsets[section] = offset;
+    offset = align_cooked_offset(offset + header.section_sizes[section]);
+  }
+  header.common.file_size = offset;
+
+  // Zeroed, so that the padding between the sections is the same every time
+  void* image = calloc(1, (size_t)header.common.file_size);
+  if (!image)
+  {
+    printf("Ran out of memory while cooking \"%s\", requested %llu bytes\n", filename,
+           (unsigned long long)header.common.file_size);
+    free(narrow);
+    free(packed_vertices);
+    free(bounds);
+    destroy_bvh(bvh);
+    destroy_collision_mesh(mesh);
+    free_geometry(source);
+    return NULL;
+  }
+
+  memcpy(image, &header, sizeof(struct CookedHeader));
+  for (int section = 0; section < SECTION_COUNT; ++section)
+  {
+    memcpy((char*)image + header.section_offsets[section], sections[section], header.section_sizes[section]);
+  }
+
+  free(narrow);
+  free(packed_vertices);
+  free(bounds);
+  destroy_bvh(bvh);
+  destroy_collision_mesh(mesh);
+  free_geometry(source);
+
+  *image_size = (size_t)header.common.file_size;
+  return image;
+}
+
+// Checks that the sections of a mapped image are consistent, so that nothing has to be checked again when it is used
+static bool is_image_valid(const void* image, size_t image_size)
+{
+  const struct CookedHeader* header = image;
+  if ((header->vertex_format != VERTEX_FORMAT_FLOAT && header->vertex_format != VERTEX_FORMAT_PACKED) ||
+      (header->index_size != sizeof(uint16_t) && header->index_size != sizeof(uint32_t)) ||
+      header->lods.lod_count < 1 || header->lods.lod_count > MAX_LOD_COUNT)
+  {
+    return false;
+  }
+
+  const uint64_t expected_sizes[SECTION_COUNT] = {
+    get_vertex_size((enum VertexFormat)header->vertex_format, header->floats_per_vertex) * header->vertex_count,
+    (uint64_t)header->index_size * header->index_count,
+    sizeof(struct Submesh) * header->submesh_count * header->lods.lod_count,
+    sizeof(struct SubmeshBounds) * header->submesh_count,
+    get_collision_mesh_data_size(header->triangle_count),
+    sizeof(struct BvhNode) * header->node_count,
+    sizeof(uint32_t) * header->primitive_count,
+  };
+
+  for (int section = 0; section < SECTION_COUNT; ++section)
+  {
+    const uint64_t offset = header->section_offsets[section];
+    const uint64_t size = header->section_sizes[section];
+    if (size != expected_sizes[section] || offset % COOKED_ALIGNMENT != 0 || offset > image_size ||
+        size > image_size - offset)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Points the mesh into the sections of a valid image
+static void view_image(struct CookedMesh* mesh, const void* image)
+{
+  const struct CookedHeader* header = image;
+  char* base = (char*)image;
+
+  struct GeometryView* geometry = &mesh->geometry;
+  geometry->vertices = base + header->section_offsets[SECTION_VERTICES];
+  geometry->indices = base + header->section_offsets[SECTION_INDICES];
+  geometry->submeshes = (const struct Submesh*)(base + header->section_offsets[SECTION_SUBMESHES]);
+  geometry->submesh_bounds = (const struct SubmeshBounds*)(base + header->section_offsets[SECTION_SUBMESH_BOUNDS]);
+  geometry->vertex_count = header->vertex_count;
+  geometry->index_count = header->index_count;
+  geometry->index_size = header->index_size;
+  geometry->floats_per_vertex = header->floats_per_vertex;
+  geometry->submesh_count = header->submesh_count;
+  geometry->vertex_format = (enum VertexFormat)header->vertex_format;
+  geometry->quantization = header->quantization;
+  geometry->lods = header->lods;
+
+  view_collision_mesh(&mesh->collision_mesh, header->triangle_count,
+                      base + header->section_offsets[SECTION_COLLISION_MESH]);
+
+  mesh->bvh.nodes = (struct BvhNode*)(base + header->section_offsets[SECTION_BVH_NODES]);
+  mesh->bvh.primitives = (uint32_t*)(base + header->section_offsets[SECTION_BVH_PRIMITIVES]);
+  mesh->bvh.node_count = header->node_count;
+  mesh->bvh.primitive_count = header->primitive_count;
+}
+
+struct CookedMesh* load_cooked_mesh(const char* filename, const struct CookOptions* options)
+{
+  char cooked_filename[MAX_COOKED_FILENAME_LENGTH];
+  if (!get_cooked_filename(filename, COOKED_EXTENSION, cooked_filename))
+  {
+    return NULL;
+  }
+
+  struct CookedMesh* mesh = malloc(sizeof(struct CookedMesh));
+  if (!mesh)
+  {
+    printf("Ran out of memory while loading cooked mesh \"%s\"\n", filename);
+    return NULL;
+  }
+
+  mesh->image = NULL;
+
+  // Without the source file, whatever was cooked from it is as up to date as it gets
+  uint64_t source_size = 0;
+  int64_t source_modified_time = 0;
+  const bool has_source = get_file_stamp(filename, &source_size, &source_modified_time);
+
+  if (map_cooked_file(cooked_filename, sizeof(struct CookedHeader), COOKED_MAGIC, COOKED_VERSION, &mesh->file))
+  {
+    const struct CookedHeader* header = mesh->file.data;
+    if (is_image_valid(mesh->file.data, mesh->file.size) && header->vertex_format == (uint32_t)options->vertex_format &&
+        header->optimized == (uint32_t)options->optimize && header->generated_lods == (uint32_t)options->lods &&
+        header->chunk_size == options->chunk_size &&
+        (!has_source ||
+         (header->source_size == source_size && header->source_modified_time == source_modified_time)))
+    {
+      view_image(mesh, mesh->file.data);
+      return mesh;
+    }
+
+    unmap_file(&mesh->file);
+  }
+
+  // Missing or stale, so cook it now and keep the result for next time
+  printf("Cooking \"%s\"\n", filename);
+
+  size_t image_size;
+  mesh->image = cook_image(filename, options, source_size, source_modified_time, &image_size);
+  if (!mesh->image)
+  {
+    free(mesh);
+    return NULL;
+  }
+
+  // Used from the file just like a cooked file that was already there, so that the image does not stay on the heap
+  // If it can not be written, it only costs the time to cook again on the next start
+  if (write_file(cooked_filename, mesh->image, image_size) &&
+      map_cooked_file(cooked_filename, sizeof(struct CookedHeader), COOKED_MAGIC, COOKED_VERSION, &mesh->file))
+  {
+    free(mesh->image);
+    mesh->image = NULL;
+    view_image(mesh, mesh->file.data);
+    return mesh;
+  }
+
+  view_image(mesh, mesh->image);
+  return mesh;
+}
+
+void destroy_cooked_mesh(struct CookedMesh* mesh)
+{
+  if (mesh->image)
+  {
+    free(mesh->image);
+  }
+  else
+  {
+    unmap_file(&mesh->file);
+  }
+
+  free(mesh);
+}
+
+bool cook_mesh(const char* filename, const struct CookOptions* options)
+{
+  char cooked_filename[MAX_COOKED_FILENAME_LENGTH];
+  if (!get_cooked_filename(filename, COOKED_EXTENSION, cooked_filename))
+  {
+    return false;
+  }
+
+  uint64_t source_size;
+  int64_t source_modified_time;
+  if (!get_file_stamp(filename, &source_size, &source_modified_time))
+  {
+    printf("Failed to find \"%s\" to cook\n", filename);
+    return false;
+  }
+
+  size_t image_size;
+  void* image = cook_image(filename, options, source_size, source_modified_time, &image_size);
+  if (!image)
+  {
+    return false;
+  }
+
+  const bool success = write_file(cooked_filename, image, image_size);
+  free(image);
+
+  if (success)
+  {
+    printf("Cooked \"%s\" into \"%s\", %zu bytes\n", filename, cooked_filename, image_size);
+  }
+
+  return success;
+}
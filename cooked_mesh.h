@@ -0,0 +1,42 @@
+#pragma once
+
+#include "bvh.h"
+#include "collision_mesh.h"
+#include "geometry_data.h"
+#include "mapped_file.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The triangles of a mesh file in a form that needs no parsing: interleaved vertices and indices that are ready to be
+// uploaded, plus the collision mesh and its BVH, stored in a cooked file next to the source that is mapped in place
+// Everything points into the cooked data, which is read-only
+struct CookedMesh
+{
+  struct GeometryView geometry; // Vertices are floats or struct PackedVertex, depending on the vertex format, indices
+                                // are relative to the base vertex of their submesh
+
+  struct CollisionMesh collision_mesh; // Triangles in the order of the BVH leaves
+  struct Bvh bvh;
+
+  struct MappedFile file;
+  void* image; // Cooked data on the heap when the cooked file could not be written or mapped, NULL otherwise
+};
+
+// How meshes are cooked, a cooked file that was cooked with other options is stale
+struct CookOptions
+{
+  enum VertexFormat vertex_format;
+  bool optimize; // Reorders for the vertex cache, overdraw and vertex fetch, and uses 16-bit indices where they fit
+  bool lods;     // Adds simplified levels of detail to draw in place of the full mesh from afar
+  float chunk_size; // Splits the mesh into submeshes of about this size on each side to cull them, 0 keeps it whole
+};
+
+// Maps the cooked version of filename, cooking it first if it is missing or stale
+// Cooked files are stale when the source file changed since, or they were cooked by another version or with other
+// options
+struct CookedMesh* load_cooked_mesh(const char* filename, const struct CookOptions* options);
+void destroy_cooked_mesh(struct CookedMesh* mesh);
+
+// Writes the cooked version of filename, whether or not the existing one is up to date
+bool cook_mesh(const char* filename, const struct CookOptions* options);
@@ -0,0 +1,411 @@
+#include "cooked_texture.h"
+
+#include "cooked_file.h"
+
+#include <string.h> // The implementation of stb_dxt.h uses memcpy without including it
+
+#define STB_DXT_IMPLEMENTATION
+#include <stb/stb_dxt.h>
+#include <stb/stb_image.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define COOKED_MAGIC 0x58455443 // "CTEX" when read as little-endian
+#define COOKED_VERSION 2
+#define COOKED_EXTENSION ".cooked"
+
+#define BLOCK_SIZE 4 // Pixels on a side
+
+// At the start of every cooked file, followed by the mips at the given offsets from the start of the file
+struct CookedHeader
+{
+  struct CookedFileHeader common;
+
+  // Of the contents of the source file when it was cooked, the cooked file is stale once it changes
+  uint64_t source_hash;
+
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mip_count;
+
+  uint64_t mip_offsets[MAX_MIP_COUNT];
+  uint64_t mip_sizes[MAX_MIP_COUNT];
+};
+
+static uint32_t get_block_bytes(enum TextureFormat format)
+{
+  return format == TEXTURE_FORMAT_BC3 ? 16 : 8;
+}
+
+static uint64_t get_mip_size(enum TextureFormat format, uint32_t width, uint32_t height)
+{
+  return (uint64_t)((width + BLOCK_SIZE - 1) / BLOCK_SIZE) * ((height + BLOCK_SIZE - 1) / BLOCK_SIZE) *
+         get_block_bytes(format);
+}
+
+static uint32_t get_mip_extent(uint32_t extent, uint32_t mip)
+{
+  return (extent >> mip) > 0 ? extent >> mip : 1;
+}
+
+static float srgb_to_linear(uint8_t value)
+{
+  const float srgb = value / 255.0f;
+  return srgb <= 0.04045f ? srgb / 12.92f : powf((srgb + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linear_to_srgb(float linear)
+{
+  const float srgb = linear <= 0.0031308f ? linear * 12.92f : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+  return (uint8_t)(fminf(fmaxf(srgb, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// The first of the rows or columns that a row or column of the next mip covers, and how many there are
+// The last one of an odd extent also takes the one that is left over, so that no row or column is ever dropped
+static uint32_t get_footprint(uint32_t index, uint32_t extent, uint32_t dest_extent, uint32_t* first)
+{
+  *first = index * 2;
+  if (extent == 1)
+  {
+    return 1;
+  }
+
+  return index + 1 == dest_extent && extent % 2 == 1 ? 3 : 2;
+}
+
+// Averages each 2x2 square of RGBA pixels into one, colors in linear light, the last row and column of an odd extent
+// are averaged into the ones before them
+static void downsample_mip(const uint8_t* pixels,
+                           uint32_t width,
+                           uint32_t height,
+                           const float* linear,
+                           uint8_t* dest,
+                           uint32_t dest_width,
+                           uint32_t dest_height)
+{
+  for (uint32_t y = 0; y < dest_height; ++y)
+  {
+    uint32_t first_row;
+    const uint32_t row_count = get_footprint(y, height, dest_height, &first_row);
+    for (uint32_t x = 0; x < dest_width; ++x)
+    {
+      uint32_t first_column;
+      const uint32_t column_count = get_footprint(x, width, dest_width, &first_column);
+
+      float sums[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for (uint32_t row = first_row; row < first_row + row_count; ++row)
+      {
+        for (uint32_t column = first_column; column < first_column + column_count; ++column)
+        {
+          const uint8_t* pixel = &pixels[((size_t)row * width + column) * 4];
+          for (int channel = 0; channel < 3; ++channel)
+          {
+            sums[channel] += linear[pixel[channel]];
+          }
+          sums[3] += pixel[3];
+        }
+      }
+
+      const float weight = 1.0f / (float)(row_count * column_count);
+      uint8_t* dest_pixel = &dest[((size_t)y * dest_width + x) * 4];
+      for (int channel = 0; channel < 3; ++channel)
+      {
+        dest_pixel[channel] = linear_to_srgb(sums[channel] * weight);
+      }
+      dest_pixel[3] = (uint8_t)(sums[3] * weight + 0.5f);
+    }
+  }
+}
+
+// Compresses RGBA pixels block by block, blocks that stick out over the edges repeat the last row and column
+static void compress_mip(const uint8_t* pixels,
+                         uint32_t width,
+                         uint32_t height,
+                         enum TextureFormat format,
+                         uint8_t* dest)
+{
+  for (uint32_t block_y = 0; block_y < height; block_y += BLOCK_SIZE)
+  {
+    for (uint32_t block_x = 0; block_x < width; block_x += BLOCK_SIZE)
+    {
+      uint8_t block[BLOCK_SIZE * BLOCK_SIZE * 4];
+      for (uint32_t y = 0; y < BLOCK_SIZE; ++y)
+      {
+        for (uint32_t x = 0; x < BLOCK_SIZE; ++x)
+        {
+          const uint32_t source_x = block_x + x < width ? block_x + x : width - 1;
+          const uint32_t source_y = block_y + y < height ? block_y + y : height - 1;
+          memcpy(&block[(y * BLOCK_SIZE + x) * 4], &pixels[((size_t)source_y * width + source_x) * 4], 4);
+        }
+      }
+
+      stb_compress_dxt_block(dest, block, format == TEXTURE_FORMAT_BC3, STB_DXT_HIGHQUAL);
+      dest += get_block_bytes(format);
+    }
+  }
+}
+
+// Decodes the source file and lays out its compressed mip chain in a single block, exactly as in the file
+static void* cook_image(const char* filename, const void* source, size_t source_size, size_t* image_size)
+{
+  if (source_size > INT32_MAX)
+  {
+    printf("Texture \"%s\" is too large to load\n", filename);
+    return NULL;
+  }
+
+  // Always as RGBA, which is what the compressor takes
+  int width, height, channels;
+  stbi_uc* pixels = stbi_load_from_memory(source, (int)source_size, &width, &height, &channels, 4);
+  if (!pixels)
+  {
+    printf("Failed to load texture \"%s\"\n", filename);
+    return NULL;
+  }
+
+  // Only pay for the alpha block if any pixel is not fully opaque
+  struct CookedHeader header = { 0 };
+  header.format = TEXTURE_FORMAT_BC1;
+  for (size_t pixel = 0; pixel < (size_t)width * height && (channels == 2 || channels == 4); ++pixel)
+  {
+    if (pixels[pixel * 4 + 3] < UINT8_MAX)
+    {
+      header.format = TEXTURE_FORMAT_BC3;
+      break;
+    }
+  }
+
+  header.common.magic = COOKED_MAGIC;
+  header.common.version = COOKED_VERSION;
+  header.source_hash = hash_data(HASH_SEED, source, source_size);
+  header.width = (uint32_t)width;
+  header.height = (uint32_t)height;
+
+  // Down to 1x1, as a mip chain has to be complete to be sampled
+  header.mip_count = 1;
+  for (uint32_t extent = header.width > header.height ? header.width : header.height;
+       extent > 1 && header.mip_count < MAX_MIP_COUNT; extent /= 2)
+  {
+    ++header.mip_count;
+  }
+
+  uint64_t offset = align_cooked_offset(sizeof(struct CookedHeader));
+  for (uint32_t mip = 0; mip < header.mip_count; ++mip)
+  {
+    header.mip_offsets[mip] = offset;
+    header.mip_sizes[mip] =
+      get_mip_size(header.format, get_mip_extent(header.width, mip), get_mip_extent(header.height, mip));
+    offset = align_cooked_offset(offset + header.mip_sizes[mip]);
+  }
+  header.common.file_size = offset;
+
+  // Zeroed, so that the padding between the mips is the same every time
+  // Every further mip is filtered into one of two scratch buffers from the previous one, alternating between them
+  uint8_t* image = calloc(1, (size_t)header.common.file_size);
+  const size_t scratch_size = (size_t)get_mip_extent(header.width, 1) * get_mip_extent(header.height, 1) * 4;
+  uint8_t* scratch[2] = { malloc(scratch_size), malloc(scratch_size) };
+  if (!image || !scratch[0] || !scratch[1])
+  {
+    printf("Ran out of memory while cooking \"%s\", requested %llu bytes\n", filename,
+           (unsigned long long)header.common.file_size);
+    free(image);
+    free(scratch[0]);
+    free(scratch[1]);
+    stbi_image_free(pixels);
+    return NULL;
+  }
+
+  memcpy(image, &header, sizeof(struct CookedHeader));
+
+  float linear[UINT8_MAX + 1];
+  for (int value = 0; value <= UINT8_MAX; ++value)
+  {
+    linear[value] = srgb_to_linear((uint8_t)value);
+  }
+
+  const uint8_t* mip_pixels = pixels;
+  for (uint32_t mip = 0; mip < header.mip_count; ++mip)
+  {
+    const uint32_t mip_width = get_mip_extent(header.width, mip);
+    const uint32_t mip_height = get_mip_extent(header.height, mip);
+    compress_mip(mip_pixels, mip_width, mip_height, (enum TextureFormat)header.format, image + header.mip_offsets[mip]);
+
+    if (mip + 1 < header.mip_count)
+    {
+      const uint32_t next_width = get_mip_extent(header.width, mip + 1);
+      const uint32_t next_height = get_mip_extent(header.height, mip + 1);
+      uint8_t* next_pixels = scratch[mip % 2];
+      downsample_mip(mip_pixels, mip_width, mip_height, linear, next_pixels, next_width, next_height);
+      mip_pixels = next_pixels;
+    }
+  }
+
+  free(scratch[0]);
+  free(scratch[1]);
+  stbi_image_free(pixels);
+
+  *image_size = (size_t)header.common.file_size;
+  return image;
+}
+
+// Checks that the mips of a mapped image are consistent, so that nothing has to be checked again when it is used
+static bool is_image_valid(const void* image, size_t image_size)
+{
+  const struct CookedHeader* header = image;
+  if ((header->format != TEXTURE_FORMAT_BC1 && header->format != TEXTURE_FORMAT_BC3) || header->mip_count == 0 ||
+      header->mip_count > MAX_MIP_COUNT)
+  {
+    return false;
+  }
+
+  for (uint32_t mip = 0; mip < header->mip_count; ++mip)
+  {
+    if (header->mip_sizes[mip] != get_mip_size((enum TextureFormat)header->format, get_mip_extent(header->width, mip),
+                                               get_mip_extent(header->height, mip)) ||
+        header->mip_offsets[mip] > image_size || header->mip_sizes[mip] > image_size - header->mip_offsets[mip])
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Points the texture into the mips of a valid image
+static void view_image(struct CookedTexture* texture, const void* image)
+{
+  const struct CookedHeader* header = image;
+  texture->format = (enum TextureFormat)header->format;
+  texture->width = header->width;
+  texture->height = header->height;
+  texture->mip_count = header->mip_count;
+  for (uint32_t mip = 0; mip < header->mip_count; ++mip)
+  {
+    texture->mips[mip] = (const char*)image + header->mip_offsets[mip];
+    texture->mip_sizes[mip] = (uint32_t)header->mip_sizes[mip];
+  }
+}
+
+struct CookedTexture* load_cooked_texture(const char* filename)
+{
+  char cooked_filename[MAX_COOKED_FILENAME_LENGTH];
+  if (!get_cooked_filename(filename, COOKED_EXTENSION, cooked_filename))
+  {
+    return NULL;
+  }
+
+  struct CookedTexture* texture = malloc(sizeof(struct CookedTexture));
+  if (!texture)
+  {
+    printf("Ran out of memory while loading cooked texture \"%s\"\n", filename);
+    return NULL;
+  }
+
+  texture->image = NULL;
+
+  // Without the source file, whatever was cooked from it is as up to date as it gets
+  struct MappedFile source;
+  const bool has_source = map_file(filename, &source);
+
+  if (map_cooked_file(cooked_filename, sizeof(struct CookedHeader), COOKED_MAGIC, COOKED_VERSION, &texture->file))
+  {
+    const struct CookedHeader* header = texture->file.data;
+    if (is_image_valid(texture->file.data, texture->file.size) &&
+        (!has_source || header->source_hash == hash_data(HASH_SEED, source.data, source.size)))
+    {
+      if (has_source)
+      {
+        unmap_file(&source);
+      }
+
+      view_image(texture, texture->file.data);
+      return texture;
+    }
+
+    unmap_file(&texture->file);
+  }
+
+  if (!has_source)
+  {
+    printf("Failed to load texture \"%s\"\n", filename);
+    free(texture);
+    return NULL;
+  }
+
+  // Missing or stale, so cook it now and keep the result for next time
+  printf("Cooking \"%s\"\n", filename);
+
+  size_t image_size;
+  texture->image = cook_image(filename, source.data, source.size, &image_size);
+  unmap_file(&source);
+  if (!texture->image)
+  {
+    free(texture);
+    return NULL;
+  }
+
+  // Used from the file just like a cooked file that was already there, so that the image does not stay on the heap
+  // If it can not be written, it only costs the time to cook again on the next start
+  if (write_file(cooked_filename, texture->image, image_size) &&
+      map_cooked_file(cooked_filename, sizeof(struct CookedHeader), COOKED_MAGIC, COOKED_VERSION, &texture->file))
+  {
+    free(texture->image);
+    texture->image = NULL;
+    view_image(texture, texture->file.data);
+    return texture;
+  }
+
+  view_image(texture, texture->image);
+  return texture;
+}
+
+void destroy_cooked_texture(struct CookedTexture* texture)
+{
+  if (texture->image)
+  {
+    free(texture->image);
+  }
+  else
+  {
+    unmap_file(&texture->file);
+  }
+
+  free(texture);
+}
+
+bool cook_texture(const char* filename)
+{
+  char cooked_filename[MAX_COOKED_FILENAME_LENGTH];
+  if (!get_cooked_filename(filename, COOKED_EXTENSION, cooked_filename))
+  {
+    return false;
+  }
+
+  struct MappedFile source;
+  if (!map_file(filename, &source))
+  {
+    printf("Failed to find \"%s\" to cook\n", filename);
+    return false;
+  }
+
+  size_t image_size;
+  void* image = cook_image(filename, source.data, source.size, &image_size);
+  unmap_file(&source);
+  if (!image)
+  {
+    return false;
+  }
+
+  const bool success = write_file(cooked_filename, image, image_size);
+  free(image);
+
+  if (success)
+  {
+    printf("Cooked \"%s\" into \"%s\", %zu bytes\n", filename, cooked_filename, image_size);
+  }
+
+  return success;
+}
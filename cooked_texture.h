@@ -0,0 +1,37 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAX_MIP_COUNT 16 // Enough for 32768 pixels on a side
+
+enum TextureFormat
+{
+  TEXTURE_FORMAT_BC1, // DXT1, RGB in 8 bytes per block of 4x4 pixels, for opaque images
+  TEXTURE_FORMAT_BC3  // DXT5, RGBA in 16 bytes per block of 4x4 pixels, for images with any transparency
+};
+
+// The full mip chain of an image file, block-compressed so that the GPU samples it as it is, stored in a cooked file
+// next to the source that is mapped in place
+// Everything points into the cooked data, which is read-only
+struct CookedTexture
+{
+  enum TextureFormat format;
+  uint32_t width, height; // Of the first mip, each further one is half as large, rounded down, down to 1x1
+  uint32_t mip_count;
+  const void* mips[MAX_MIP_COUNT]; // Rows of blocks, the blocks on the right and bottom edges repeat the last pixels
+  uint32_t mip_sizes[MAX_MIP_COUNT];
+
+  struct MappedFile file;
+  void* image; // NULL unless the cooked file could not be written or mapped, then the mips point in here instead
+};
+
+// Maps the cooked version of filename, cooking it first if it is missing or stale
+// Cooked files are stale when they were cooked from other contents of the source file, or by another version
+struct CookedTexture* load_cooked_texture(const char* filename);
+void destroy_cooked_texture(struct CookedTexture* texture);
+
+// Writes the cooked version of filename, whether or not the existing one is up to date
+bool cook_texture(const char* filename);
@@ -0,0 +1,242 @@
+#include "crowd.h"
+
+#include "character.h"
+#include "jobs.h"
+#include "thread.h"
+
+#include <cglm/vec3.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Characters overlap when their axes are closer than twice the radius, which is horizontally at most one cell apart
+#define CELL_SIZE_XZ (2.0f * CHARACTER_RADIUS)
+
+// The axes of two characters are the same length, so they overlap only when their bases are less than a height apart
+#define CELL_SIZE_Y CHARACTER_HEIGHT
+
+#define CHARACTERS_PER_JOB 64
+
+// Limits how far a character is pushed per tick when it is squeezed by many others at once
+#define MAX_PUSH CHARACTER_RADIUS
+
+struct SeparateContext
+{
+  struct Crowd* crowd;
+  struct Character* characters;
+};
+
+static void get_cell(const vec3 position, int32_t cell[3])
+{
+  cell[0] = (int32_t)floorf(position[0] / CELL_SIZE_XZ);
+  cell[1] = (int32_t)floorf(position[1] / CELL_SIZE_Y);
+  cell[2] = (int32_t)floorf(position[2] / CELL_SIZE_XZ);
+}
+
+static uint32_t get_bucket(const struct Crowd* crowd, int32_t x, int32_t y, int32_t z)
+{
+  const uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+  return hash & (crowd->bucket_count - 1);
+}
+
+static void separate_character(struct Crowd* crowd, struct Character* characters, uint32_t index, uint32_t* pair_count)
+{
+  struct Character* character = &characters[index];
+  const float* position = character->transform[3];
+
+  int32_t cell[3];
+  get_cell(position, cell);
+
+  // Neighboring cells can share a bucket, which must only be visited once, most buckets are empty though
+  uint32_t visited[27];
+  uint32_t visited_count = 0;
+
+  vec3 push = GLM_VEC3_ZERO_INIT;
+  for (int32_t z = cell[2] - 1; z <= cell[2] + 1; ++z)
+  {
+    for (int32_t y = cell[1] - 1; y <= cell[1] + 1; ++y)
+    {
+      for (int32_t x = cell[0] - 1; x <= cell[0] + 1; ++x)
+      {
+        const uint32_t bucket = get_bucket(crowd, x, y, z);
+        if (crowd->bucket_starts[bucket] == crowd->bucket_starts[bucket + 1])
+        {
+          continue;
+        }
+
+        bool is_visited = false;
+        for (uint32_t visit = 0; visit < visited_count; ++visit)
+        {
+          is_visited |= visited[visit] == bucket;
+        }
+
+        if (is_visited)
+        {
+          continue;
+        }
+
+        visited[visited_count++] = bucket;
+
+        for (uint32_t entry = crowd->bucket_starts[bucket]; entry < crowd->bucket_starts[bucket + 1]; ++entry)
+        {
+          const uint32_t other = crowd->entries[entry];
+          if (other == index)
+          {
+            continue;
+          }
+
+          // Both axes are vertical, so the closest points are apart horizontally by the offset between the bases and
+          // vertically by the gap between the axes, if there is one
+          vec3 separation;
+          glm_vec3_sub((float*)position, crowd->positions[entry], separation);
+
+          const float axis_length = CHARACTER_HEIGHT - 2.0f * CHARACTER_RADIUS;
+          const float gap = fmaxf(fabsf(separation[1]) - axis_length, 0.0f);
+          separation[1] = separation[1] < 0.0f ? -gap : gap;
+
+          const float distance_squared = glm_vec3_norm2(separation);
+          if (distance_squared >= 4.0f * CHARACTER_RADIUS * CHARACTER_RADIUS)
+          {
+            continue;
+          }
+
+          const float distance = sqrtf(distance_squared);
+
+          if (other > index)
+          {
+            ++*pair_count;
+          }
+
+          // Characters exactly on top of each other are split along x, in opposite directions by their order
+          if (distance < GLM_FLT_EPSILON)
+          {
+            glm_vec3_copy((vec3){ index < other ? -1.0f : 1.0f, 0.0f, 0.0f }, separation);
+          }
+          else
+          {
+            glm_vec3_divs(separation, distance, separation);
+          }
+
+          // Both characters of a pair move apart by half of the overlap
+          glm_vec3_muladds(separation, (2.0f * CHARACTER_RADIUS - distance) * 0.5f, push);
+        }
+      }
+    }
+  }
+
+  const float push_length = glm_vec3_norm(push);
+  if (push_length > MAX_PUSH)
+  {
+    glm_vec3_scale(push, MAX_PUSH / push_length, push);
+  }
+
+  // Only the velocity of this character is written, while only the positions of the others are read
+  glm_vec3_add(character->velocity, push, character->velocity);
+}
+
+static void separate_characters_job(void* data, uint32_t begin, uint32_t end)
+{
+  const struct SeparateContext* context = data;
+
+  uint32_t pair_count = 0;
+  for (uint32_t index = begin; index < end; ++index)
+  {
+    separate_character(context->crowd, context->characters, index, &pair_count);
+  }
+
+  atomic_add_u32(&context->crowd->pair_count, pair_count);
+}
+
+struct Crowd* make_crowd(uint32_t capacity)
+{
+  struct Crowd* crowd = malloc(sizeof(struct Crowd));
+  if (!crowd)
+  {
+    printf("Ran out of memory while making a crowd of %u characters\n", capacity);
+    return NULL;
+  }
+
+  crowd->capacity = capacity;
+
+  crowd->bucket_count = 1;
+  while (crowd->bucket_count < capacity * 2)
+  {
+    crowd->bucket_count *= 2;
+  }
+
+  crowd->bucket_starts = malloc(sizeof(uint32_t) * (crowd->bucket_count + 1));
+  crowd->entries = malloc(sizeof(uint32_t) * (capacity > 0 ? capacity : 1));
+  crowd->positions = malloc(sizeof(vec3) * (capacity > 0 ? capacity : 1));
+  crowd->buckets = malloc(sizeof(uint32_t) * (capacity > 0 ? capacity : 1));
+  if (!crowd->bucket_starts || !crowd->entries || !crowd->positions || !crowd->buckets)
+  {
+    printf("Ran out of memory while making a crowd of %u characters\n", capacity);
+    destroy_crowd(crowd);
+    return NULL;
+  }
+
+  crowd->pair_count = 0;
+
+  return crowd;
+}
+
+void destroy_crowd(struct Crowd* crowd)
+{
+  free(crowd->buckets);
+  free(crowd->positions);
+  free(crowd->entries);
+  free(crowd->bucket_starts);
+  free(crowd);
+}
+
+uint32_t separate_characters(struct Crowd* crowd, struct Character* characters, uint32_t count)
+{
+  if (count > crowd->capacity)
+  {
+    printf("Can not separate %u characters in a crowd of %u\n", count, crowd->capacity);
+    return 0;
+  }
+
+  // Rebuild the spatial hash with a counting sort of the characters by bucket
+  {
+    for (uint32_t bucket = 0; bucket <= crowd->bucket_count; ++bucket)
+    {
+      crowd->bucket_starts[bucket] = 0;
+    }
+
+    for (uint32_t index = 0; index < count; ++index)
+    {
+      int32_t cell[3];
+      get_cell(characters[index].transform[3], cell);
+
+      const uint32_t bucket = get_bucket(crowd, cell[0], cell[1], cell[2]);
+      crowd->buckets[index] = bucket;
+      ++crowd->bucket_starts[bucket];
+    }
+
+    // Turn the counts into the offsets where each bucket ends, then count back down to where they start while filling
+    uint32_t offset = 0;
+    for (uint32_t bucket = 0; bucket <= crowd->bucket_count; ++bucket)
+    {
+      offset += crowd->bucket_starts[bucket];
+      crowd->bucket_starts[bucket] = offset;
+    }
+
+    for (uint32_t index = count; index-- > 0;)
+    {
+      const uint32_t entry = --crowd->bucket_starts[crowd->buckets[index]];
+      crowd->entries[entry] = index;
+      glm_vec3_copy(characters[index].transform[3], crowd->positions[entry]);
+    }
+  }
+
+  struct SeparateContext context;
+  context.crowd = crowd;
+  context.characters = characters;
+
+  atomic_store_u32(&crowd->pair_count, 0);
+  parallel_for(count, CHARACTERS_PER_JOB, separate_characters_job, &context);
+
+  return atomic_load_u32(&crowd->pair_count);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cglm/types.h>
+
+#include <stdint.h>
+
+struct Character;
+
+// Uniform spatial hash over the positions of a crowd of characters, rebuilt every tick to find the ones that overlap
+// Cells are as large as a character, so only the 27 cells around a character can hold characters that overlap it
+struct Crowd
+{
+  uint32_t capacity;     // Maximum number of characters
+  uint32_t bucket_count; // Power of two, at least twice the capacity to keep hash collisions between cells rare
+
+  uint32_t* bucket_starts; // Offset of the first entry of each bucket, followed by the total entry count
+  uint32_t* entries;       // Indices of the characters, sorted by bucket
+  vec3* positions;         // Positions of the characters in the same order, so that a bucket is tested without misses
+  uint32_t* buckets;       // Bucket of each character
+
+  volatile uint32_t pair_count;
+};
+
+struct Crowd* make_crowd(uint32_t capacity);
+void destroy_crowd(struct Crowd* crowd);
+
+// Adds an offset to the velocity of each of the count (at most capacity) characters that pushes it out of the others
+// The offsets are swept against the level by the following update_character like any other motion
+// Returns the number of overlapping pairs of characters
+uint32_t separate_characters(struct Crowd* crowd, struct Character* characters, uint32_t count);
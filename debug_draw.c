@@ -0,0 +1,368 @@
+#include "debug_draw.h"
+
+#include "shader.h"
+#include "thread.h"
+
+#include <cglm/vec3.h>
+
+#include <glad/gl.h>
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SPHERE_SEGMENTS 32 // Per circle, a sphere is drawn as one circle around each axis
+#define MIN_QUEUE_CAPACITY 256
+
+enum DebugShape
+{
+  DEBUG_SHAPE_SPHERE, // Of radius 1
+  DEBUG_SHAPE_BOX,    // From -1 to 1
+  DEBUG_SHAPE_COUNT
+};
+
+// Of a streamed line
+struct DebugVertex
+{
+  float position[3];
+  uint8_t color[4];
+};
+
+// Of a unit shape, which is placed as center + scale * position
+struct DebugInstance
+{
+  float center[3];
+  float scale[3];
+  uint8_t color[4];
+};
+
+// Grows as needed and is emptied by every flush, so that it settles at the size of the busiest frame
+struct DebugQueue
+{
+  void* data;
+  uint32_t count, capacity;
+  uint32_t element_size;
+};
+
+static bool generated = false;
+static Mutex mutex; // Guards the queues
+
+static struct ShaderProgram* shader_program;
+
+static GLuint line_vertex_array, line_buffer;
+static struct DebugQueue lines = { NULL, 0, 0, sizeof(struct DebugVertex) };
+
+// All unit shapes share a vertex buffer, their instances have a buffer each
+static GLuint shape_buffer;
+static GLuint shape_vertex_arrays[DEBUG_SHAPE_COUNT], instance_buffers[DEBUG_SHAPE_COUNT];
+static GLint shape_firsts[DEBUG_SHAPE_COUNT];
+static GLsizei shape_counts[DEBUG_SHAPE_COUNT];
+static struct DebugQueue instances[DEBUG_SHAPE_COUNT] = { { NULL, 0, 0, sizeof(struct DebugInstance) },
+                                                          { NULL, 0, 0, sizeof(struct DebugInstance) } };
+
+// Returns room for count more elements at the end of the queue, or NULL if there is no memory for them
+static void* push(struct DebugQueue* queue, uint32_t count)
+{
+  if (queue->count + count > queue->capacity)
+  {
+    uint32_t capacity = queue->capacity > 0 ? queue->capacity : MIN_QUEUE_CAPACITY;
+    while (capacity < queue->count + count)
+    {
+      capacity *= 2;
+    }
+
+    void* data = realloc(queue->data, (size_t)capacity * queue->element_size);
+    if (!data)
+    {
+      printf("Ran out of memory while queuing debug draws, requested %u of them\n", capacity);
+      return NULL;
+    }
+
+    queue->data = data;
+    queue->capacity = capacity;
+  }
+
+  void* elements = (char*)queue->data + (size_t)queue->count * queue->element_size;
+  queue->count += count;
+  return elements;
+}
+
+static void pack_color(const vec4 color, uint8_t* packed)
+{
+  for (int channel = 0; channel < 4; ++channel)
+  {
+    packed[channel] = (uint8_t)(glm_clamp(color[channel], 0.0f, 1.0f) * 255.0f + 0.5f);
+  }
+}
+
+static void push_instance(enum DebugShape shape, const vec3 center, const vec3 scale, const vec4 color)
+{
+  if (!generated)
+  {
+    return;
+  }
+
+  lock_mutex(&mutex);
+  struct DebugInstance* instance = push(&instances[shape], 1);
+  if (instance)
+  {
+    glm_vec3_copy((float*)center, instance->center);
+    glm_vec3_copy((float*)scale, instance->scale);
+    pack_color(color, instance->color);
+  }
+  unlock_mutex(&mutex);
+}
+
+// Writes the unit shapes as line lists into a single buffer, and notes where each of them starts
+static bool generate_shapes()
+{
+  const GLsizei sphere_count = 3 * SPHERE_SEGMENTS * 2;
+  const GLsizei box_count = 12 * 2;
+
+  vec3* vertices = malloc(sizeof(vec3) * (sphere_count + box_count));
+  if (!vertices)
+  {
+    printf("Ran out of memory while generating debug shapes\n");
+    return false;
+  }
+
+  // One circle around each axis
+  vec3* vertex = vertices;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    for (int segment = 0; segment < SPHERE_SEGMENTS; ++segment)
+    {
+      for (int end = 0; end < 2; ++end)
+      {
+        const float angle = (float)(segment + end) / SPHERE_SEGMENTS * 2.0f * GLM_PIf;
+        (*vertex)[axis] = 0.0f;
+        (*vertex)[(axis + 1) % 3] = cosf(angle);
+        (*vertex)[(axis + 2) % 3] = sinf(angle);
+        ++vertex;
+      }
+    }
+  }
+
+  // The edges along each axis, between the corners that differ only in that axis
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    for (int corner = 0; corner < 4; ++corner)
+    {
+      for (int end = 0; end < 2; ++end)
+      {
+        (*vertex)[axis] = end ? 1.0f : -1.0f;
+        (*vertex)[(axis + 1) % 3] = (corner & 1) ? 1.0f : -1.0f;
+        (*vertex)[(axis + 2) % 3] = (corner & 2) ? 1.0f : -1.0f;
+        ++vertex;
+      }
+    }
+  }
+
+  shape_firsts[DEBUG_SHAPE_SPHERE] = 0;
+  shape_counts[DEBUG_SHAPE_SPHERE] = sphere_count;
+  shape_firsts[DEBUG_SHAPE_BOX] = sphere_count;
+  shape_counts[DEBUG_SHAPE_BOX] = box_count;
+
+  glGenBuffers(1, &shape_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, shape_buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vec3) * (sphere_count + box_count), vertices, GL_STATIC_DRAW);
+  free(vertices);
+
+  return true;
+}
+
+bool generate_debug_draw()
+{
+  shader_program = make_shader_program("shaders/debug.vert.glsl", "shaders/debug.frag.glsl", NULL, 0);
+  if (!shader_program)
+  {
+    return false;
+  }
+
+  if (!generate_shapes())
+  {
+    destroy_shader_program(shader_program);
+    return false;
+  }
+
+  // Lines have their own positions and colors, which leaves the instance attributes at their constant defaults
+  glGenVertexArrays(1, &line_vertex_array);
+  glBindVertexArray(line_vertex_array);
+  {
+    glGenBuffers(1, &line_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, line_buffer);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct DebugVertex),
+                          (void*)offsetof(struct DebugVertex, position));
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(struct DebugVertex),
+                          (void*)offsetof(struct DebugVertex, color));
+  }
+
+  // Shapes take their positions from the unit shape and everything else from their instances
+  glGenVertexArrays(DEBUG_SHAPE_COUNT, shape_vertex_arrays);
+  glGenBuffers(DEBUG_SHAPE_COUNT, instance_buffers);
+  for (int shape = 0; shape < DEBUG_SHAPE_COUNT; ++shape)
+  {
+    glBindVertexArray(shape_vertex_arrays[shape]);
+
+    glBindBuffer(GL_ARRAY_BUFFER, shape_buffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffers[shape]);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(struct DebugInstance),
+                          (void*)offsetof(struct DebugInstance, color));
+    glVertexAttribDivisor(1, 1);
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(struct DebugInstance),
+                          (void*)offsetof(struct DebugInstance, center));
+    glVertexAttribDivisor(2, 1);
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(struct DebugInstance),
+                          (void*)offsetof(struct DebugInstance, scale));
+    glVertexAttribDivisor(3, 1);
+  }
+
+  init_mutex(&mutex);
+  generated = true;
+  return true;
+}
+
+void destroy_debug_draw()
+{
+  if (!generated)
+  {
+    return;
+  }
+
+  generated = false;
+  destroy_mutex(&mutex);
+
+  glDeleteVertexArrays(1, &line_vertex_array);
+  glDeleteBuffers(1, &line_buffer);
+  glDeleteVertexArrays(DEBUG_SHAPE_COUNT, shape_vertex_arrays);
+  glDeleteBuffers(DEBUG_SHAPE_COUNT, instance_buffers);
+  glDeleteBuffers(1, &shape_buffer);
+  destroy_shader_program(shader_program);
+
+  free(lines.data);
+  lines = (struct DebugQueue){ NULL, 0, 0, sizeof(struct DebugVertex) };
+  for (int shape = 0; shape < DEBUG_SHAPE_COUNT; ++shape)
+  {
+    free(instances[shape].data);
+    instances[shape] = (struct DebugQueue){ NULL, 0, 0, sizeof(struct DebugInstance) };
+  }
+}
+
+void debug_draw_line(const vec3 from, const vec3 to, const vec4 color)
+{
+  if (!generated)
+  {
+    return;
+  }
+
+  lock_mutex(&mutex);
+  struct DebugVertex* vertices = push(&lines, 2);
+  if (vertices)
+  {
+    glm_vec3_copy((float*)from, vertices[0].position);
+    glm_vec3_copy((float*)to, vertices[1].position);
+    pack_color(color, vertices[0].color);
+    pack_color(color, vertices[1].color);
+  }
+  unlock_mutex(&mutex);
+}
+
+void debug_draw_sphere(const vec3 center, float radius, const vec4 color)
+{
+  push_instance(DEBUG_SHAPE_SPHERE, center, (vec3){ radius, radius, radius }, color);
+}
+
+void debug_draw_capsule(const vec3 from, const vec3 to, float radius, const vec4 color)
+{
+  debug_draw_sphere(from, radius, color);
+  debug_draw_sphere(to, radius, color);
+
+  vec3 axis;
+  glm_vec3_sub((float*)to, (float*)from, axis);
+  const float length = glm_vec3_norm(axis);
+  if (length <= 0.0f)
+  {
+    return;
+  }
+
+  // Four lines along the sides, in two directions across the axis
+  vec3 sides[2];
+  glm_vec3_divs(axis, length, axis);
+  glm_vec3_cross(axis, fabsf(axis[1]) < 0.9f ? GLM_YUP : GLM_XUP, sides[0]);
+  glm_vec3_normalize(sides[0]);
+  glm_vec3_cross(axis, sides[0], sides[1]);
+
+  for (int side = 0; side < 4; ++side)
+  {
+    vec3 offset, side_from, side_to;
+    glm_vec3_scale(sides[side / 2], side % 2 ? radius : -radius, offset);
+    glm_vec3_add((float*)from, offset, side_from);
+    glm_vec3_add((float*)to, offset, side_to);
+    debug_draw_line(side_from, side_to, color);
+  }
+}
+
+void debug_draw_aabb(const vec3 min, const vec3 max, const vec4 color)
+{
+  vec3 center, half_extents;
+  glm_vec3_center((float*)min, (float*)max, center);
+  glm_vec3_sub((float*)max, center, half_extents);
+  push_instance(DEBUG_SHAPE_BOX, center, half_extents, color);
+}
+
+void flush_debug_draw()
+{
+  if (!generated)
+  {
+    return;
+  }
+
+  glUseProgram(shader_program->program);
+
+  lock_mutex(&mutex);
+
+  // Everything is respecified every frame, which lets the driver hand out fresh storage instead of waiting on the GPU
+  if (lines.count > 0)
+  {
+    glBindVertexArray(line_vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, line_buffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)lines.count * lines.element_size, lines.data, GL_STREAM_DRAW);
+
+    glVertexAttrib3f(2, 0.0f, 0.0f, 0.0f); // Center
+    glVertexAttrib3f(3, 1.0f, 1.0f, 1.0f); // Scale
+    glDrawArrays(GL_LINES, 0, (GLsizei)lines.count);
+    lines.count = 0;
+  }
+
+  for (int shape = 0; shape < DEBUG_SHAPE_COUNT; ++shape)
+  {
+    struct DebugQueue* queue = &instances[shape];
+    if (queue->count == 0)
+    {
+      continue;
+    }
+
+    glBindVertexArray(shape_vertex_arrays[shape]);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffers[shape]);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)queue->count * queue->element_size, queue->data, GL_STREAM_DRAW);
+
+    glDrawArraysInstanced(GL_LINES, shape_firsts[shape], shape_counts[shape], (GLsizei)queue->count);
+    queue->count = 0;
+  }
+
+  unlock_mutex(&mutex);
+}
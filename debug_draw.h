@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cglm/types.h>
+
+#include <stdbool.h>
+
+// Wireframe shapes that any code can queue during a frame, from any thread, and that are drawn all at once at its end
+// Lines are streamed, spheres and boxes are instances of a single unit shape each, three draw calls in total
+// Queuing does nothing until generate_debug_draw, so that code without an OpenGL context can call it just the same
+bool generate_debug_draw();
+void destroy_debug_draw();
+
+void debug_draw_line(const vec3 from, const vec3 to, const vec4 color);
+void debug_draw_sphere(const vec3 center, float radius, const vec4 color);
+
+// A sphere swept from one center to the other, like the shape of a character
+void debug_draw_capsule(const vec3 from, const vec3 to, float radius, const vec4 color);
+
+void debug_draw_aabb(const vec3 min, const vec3 max, const vec4 color);
+
+// Draws everything that was queued since the last flush, and empties the queue
+// With the view-projection of the frame that the render queue has begun, see render_queue.h
+void flush_debug_draw();
@@ -0,0 +1,130 @@
+#include "frustum.h"
+
+#include <math.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+  #define FRUSTUM_SSE // Part of every x86-64 CPU, so it needs neither a check nor a fallback there
+
+  #include <immintrin.h>
+#endif
+
+#define PLANE_COUNT 6
+
+void make_frustum(const mat4 viewproj_matrix, struct Frustum* frustum)
+{
+  // cglm matrices are column-major, so each row is spread over the columns
+  float rows[4][4];
+  for (int row = 0; row < 4; ++row)
+  {
+    for (int column = 0; column < 4; ++column)
+    {
+      rows[row][column] = viewproj_matrix[column][row];
+    }
+  }
+
+  // Left, right, bottom, top, near and far, where -w <= x, y, z <= w in clip space
+  for (int plane = 0; plane < PLANE_COUNT; ++plane)
+  {
+    const int axis = plane / 2;
+    const float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+    for (int component = 0; component < 4; ++component)
+    {
+      frustum->planes[plane][component] = rows[3][component] + sign * rows[axis][component];
+    }
+  }
+}
+
+// The box is outside once the corner that is furthest along the normal of any plane is behind it
+static bool is_box_visible(const struct Frustum* frustum, const struct SubmeshBounds* box)
+{
+  float center[3], extent[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    center[axis] = (box->min[axis] + box->max[axis]) * 0.5f;
+    extent[axis] = (box->max[axis] - box->min[axis]) * 0.5f;
+  }
+
+  for (int plane = 0; plane < PLANE_COUNT; ++plane)
+  {
+    // Summed in the same order as four at a time, so that boxes touching a plane come out the same either way
+    const float* p = frustum->planes[plane];
+    float distance = p[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      distance += p[axis] * center[axis];
+      distance += fabsf(p[axis]) * extent[axis];
+    }
+
+    if (distance < 0.0f)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+uint32_t cull_boxes(const struct Frustum* frustum, const struct SubmeshBounds* boxes, uint32_t count, uint8_t* visible)
+{
+  uint32_t visible_count = 0;
+  uint32_t first = 0;
+
+#ifdef FRUSTUM_SSE
+  // Each component of each plane in all lanes, with the absolute normals for the extents
+  __m128 normals[PLANE_COUNT][3], absolute_normals[PLANE_COUNT][3], distances[PLANE_COUNT];
+  for (int plane = 0; plane < PLANE_COUNT; ++plane)
+  {
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      normals[plane][axis] = _mm_set1_ps(frustum->planes[plane][axis]);
+      absolute_normals[plane][axis] = _mm_set1_ps(fabsf(frustum->planes[plane][axis]));
+    }
+
+    distances[plane] = _mm_set1_ps(frustum->planes[plane][3]);
+  }
+
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 zero = _mm_setzero_ps();
+  for (; first + 4 <= count; first += 4)
+  {
+    const struct SubmeshBounds* box = &boxes[first];
+
+    __m128 center[3], extent[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      const __m128 min = _mm_setr_ps(box[0].min[axis], box[1].min[axis], box[2].min[axis], box[3].min[axis]);
+      const __m128 max = _mm_setr_ps(box[0].max[axis], box[1].max[axis], box[2].max[axis], box[3].max[axis]);
+      center[axis] = _mm_mul_ps(_mm_add_ps(min, max), half);
+      extent[axis] = _mm_mul_ps(_mm_sub_ps(max, min), half);
+    }
+
+    int inside = 0xF;
+    for (int plane = 0; plane < PLANE_COUNT && inside; ++plane)
+    {
+      __m128 distance = distances[plane];
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        distance = _mm_add_ps(distance, _mm_mul_ps(normals[plane][axis], center[axis]));
+        distance = _mm_add_ps(distance, _mm_mul_ps(absolute_normals[plane][axis], extent[axis]));
+      }
+
+      inside &= _mm_movemask_ps(_mm_cmpge_ps(distance, zero));
+    }
+
+    for (int lane = 0; lane < 4; ++lane)
+    {
+      visible[first + lane] = (uint8_t)((inside >> lane) & 1);
+      visible_count += visible[first + lane];
+    }
+  }
+#endif
+
+  for (; first < count; ++first)
+  {
+    visible[first] = is_box_visible(frustum, &boxes[first]);
+    visible_count += visible[first];
+  }
+
+  return visible_count;
+}
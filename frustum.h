@@ -0,0 +1,22 @@
+#pragma once
+
+#include "geometry_data.h"
+
+#include <cglm/types.h>
+
+#include <stdint.h>
+
+// The six planes of a view frustum, each as the x, y and z of its normal pointing inside and its distance w
+// Not normalized, which leaves the side of a point on them as it is
+struct Frustum
+{
+  float planes[6][4];
+};
+
+// Takes the planes from the rows of a view-projection matrix, in world space
+void make_frustum(const mat4 viewproj_matrix, struct Frustum* frustum);
+
+// Sets visible for each box that might be inside the frustum, and clears it for those that are completely outside one
+// of its planes, four boxes at a time where SSE is available
+// Returns the number of visible boxes
+uint32_t cull_boxes(const struct Frustum* frustum, const struct SubmeshBounds* boxes, uint32_t count, uint8_t* visible);
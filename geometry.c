@@ -1,123 +1,53 @@
 #include "geometry.h"
 
-#include <assimp/cimport.h>
-#include <assimp/mesh.h>
-#include <assimp/postprocess.h>
-#include <assimp/scene.h>
-#include <assimp/vector3.h>
+#include "simplify.h"
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define INDEX_SIZE sizeof(uint32_t)
-
-struct Geometry* make_geometry(const char* filename, enum GeometryType type)
+// Prepares the arguments for drawing all submeshes of a level of detail at once, for all levels of detail, in a single
+// block that starts with the offsets
+// Each of the arrays has room for the submeshes of one more level of detail after them, to gather the visible ones in
+static bool prepare_draws(struct Geometry* geometry)
 {
-  struct Geometry* geometry = malloc(sizeof(struct Geometry));
-
-  enum aiPostProcessSteps flags = aiProcess_JoinIdenticalVertices;
-  if (type == GEOMETRY_TYPE_TRIS)
-  {
-    flags |= aiProcess_Triangulate;
-  }
-
-  const struct aiScene* scene = aiImportFile(filename, flags);
-  if (!scene)
-  {
-    printf("Failed to load geometry \"%s\"\n", filename);
-    free(geometry);
-    return NULL;
-  }
-
-  // TODO: Properly support multiple meshes
-  struct aiMesh* mesh = scene->mMeshes[0];
-
-  uint32_t vertex_count = mesh->mNumVertices;
-  geometry->index_count = mesh->mNumFaces * type;
-
-  // Determine the vertex definition (ie. how many floats are required per vertex)
+  const uint32_t count = geometry->submesh_count * geometry->lods.lod_count;
+  const uint32_t capacity = count + geometry->submesh_count;
+  void* data = malloc((sizeof(const void*) + sizeof(GLsizei) + sizeof(GLint)) * (capacity > 0 ? capacity : 1));
+  if (!data)
   {
-    geometry->floats_per_vertex = 3; // Position
-
-    if (mesh->mNormals)
-    {
-      geometry->floats_per_vertex += 3; // Normal
-    }
-
-    if (mesh->mTextureCoords[0])
-    {
-      geometry->floats_per_vertex += 2; // UV
-    }
+    printf("Ran out of memory while preparing to draw geometry with %u submeshes\n", count);
+    return false;
   }
 
-  const uint32_t vertex_size = geometry->floats_per_vertex * sizeof(float);
+  geometry->draw_offsets = data;
+  geometry->draw_counts = (GLsizei*)(geometry->draw_offsets + capacity);
+  geometry->draw_base_vertices = (GLint*)(geometry->draw_counts + capacity);
 
-  geometry->vertices = malloc(vertex_size * vertex_count);
-  if (!geometry->vertices)
+  for (uint32_t index = 0; index < count; ++index)
   {
-    printf("Ran out of memory while loading geometry \"%s\", requested %u bytes for vertices\n", filename,
-           vertex_size * vertex_count);
-    aiReleaseImport(scene);
-    free(geometry);
-    return NULL;
-  }
-
-  geometry->indices = malloc(INDEX_SIZE * geometry->index_count);
-  if (!geometry->indices)
-  {
-    printf("Ran out of memory while loading geometry \"%s\", requested %zu bytes for indices\n", filename,
-           INDEX_SIZE * geometry->index_count);
-    aiReleaseImport(scene);
-    free(geometry);
-    return NULL;
+    const struct Submesh* submesh = &geometry->submeshes[index];
+    geometry->draw_offsets[index] = (const void*)((size_t)geometry->index_size * submesh->first_index);
+    geometry->draw_counts[index] = (GLsizei)submesh->index_count;
+    geometry->draw_base_vertices[index] = (GLint)submesh->base_vertex;
   }
 
-  for (unsigned int vertex_index = 0; vertex_index < mesh->mNumVertices; ++vertex_index)
-  {
-    uint32_t index = 0;
-
-    const struct aiVector3D* vertex = &mesh->mVertices[vertex_index];
-    geometry->vertices[vertex_index * geometry->floats_per_vertex + index + 0] = vertex->x;
-    geometry->vertices[vertex_index * geometry->floats_per_vertex + index + 1] = vertex->y;
-    geometry->vertices[vertex_index * geometry->floats_per_vertex + index + 2] = vertex->z;
-    index += 3;
-
-    if (mesh->mNormals)
-    {
-      const struct aiVector3D* normal = &mesh->mNormals[vertex_index];
-      geometry->vertices[vertex_index * geometry->floats_per_vertex + index + 0] = normal->x;
-      geometry->vertices[vertex_index * geometry->floats_per_vertex + index + 1] = normal->y;
-      geometry->vertices[vertex_index * geometry->floats_per_vertex + index + 2] = normal->z;
-      index += 3;
-    }
-
-    if (mesh->mTextureCoords[0])
-    {
-      const struct aiVector3D* uvs = &mesh->mTextureCoords[0][vertex_index];
-      geometry->vertices[vertex_index * geometry->floats_per_vertex + index + 0] = uvs->x;
-      geometry->vertices[vertex_index * geometry->floats_per_vertex + index + 1] = uvs->y;
-    }
-  }
+  return true;
+}
 
-  for (unsigned int face_index = 0; face_index < mesh->mNumFaces; ++face_index)
+// Creates the vertex array and fills its buffers, the counts and submeshes of the geometry have to be set already
+static bool upload(struct Geometry* geometry, const void* vertices, const void* indices)
+{
+  if (!prepare_draws(geometry))
   {
-    const struct aiFace* face = &mesh->mFaces[face_index];
-
-    if (face->mNumIndices != type)
-    {
-      printf("Geometry \"%s\" has invalid face with %d indices, expected %d\n", filename, face->mNumIndices, type);
-      aiReleaseImport(scene);
-      free(geometry);
-      return NULL;
-    }
-
-    for (unsigned int index = 0; index < type; ++index)
-    {
-      geometry->indices[face_index * type + index] = face->mIndices[index];
-    }
+    return false;
   }
 
-  aiReleaseImport(scene);
+  const bool packed = geometry->vertex_format == VERTEX_FORMAT_PACKED;
+  const uint32_t vertex_size =
+    packed ? (uint32_t)sizeof(struct PackedVertex) : geometry->floats_per_vertex * (uint32_t)sizeof(float);
+  const uint32_t vertex_count = geometry->vertex_count;
 
   // Generate vertex array
   {
@@ -128,50 +58,181 @@ struct Geometry* make_geometry(const char* filename, enum GeometryType type)
     {
       glGenBuffers(1, &geometry->vertex_buffer);
       glBindBuffer(GL_ARRAY_BUFFER, geometry->vertex_buffer);
-      glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertex_size * vertex_count), geometry->vertices, GL_STATIC_DRAW);
+      glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertex_size * vertex_count), vertices, GL_STATIC_DRAW);
     }
 
     // Generate and fill an index buffer
     {
       glGenBuffers(1, &geometry->index_buffer);
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->index_buffer);
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(INDEX_SIZE * geometry->index_count), geometry->indices,
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(geometry->index_size * geometry->index_count), indices,
                    GL_STATIC_DRAW);
     }
 
-    // Apply the vertex definition
+    // Apply the vertex definition, packed attributes are widened to floats by the vertex fetch
+    if (packed)
+    {
+      glEnableVertexAttribArray(0);
+      glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, vertex_size,
+                            (void*)offsetof(struct PackedVertex, position));
+
+      glEnableVertexAttribArray(1);
+      glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, vertex_size, (void*)offsetof(struct PackedVertex, normal));
+
+      glEnableVertexAttribArray(2);
+      glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, vertex_size, (void*)offsetof(struct PackedVertex, uv));
+    }
+    else
     {
       // Position
       glEnableVertexAttribArray(0);
       glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertex_size, (void*)0);
 
       // Normal
-      if (mesh->mNormals)
+      const bool has_normals = geometry->floats_per_vertex >= 6;
+      if (has_normals)
       {
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertex_size, (void*)(sizeof(float) * 3));
       }
 
       // UV
-      if (mesh->mTextureCoords[0])
+      if (geometry->floats_per_vertex == 5 || geometry->floats_per_vertex == 8)
       {
         glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, vertex_size, (void*)(sizeof(float) * 6));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, vertex_size, (void*)(sizeof(float) * (has_normals ? 6 : 3)));
       }
     }
   }
 
+  return true;
+}
+
+struct Geometry* make_geometry(const char* filename, enum GeometryType type, bool lods)
+{
+  struct Geometry* geometry = load_geometry(filename, type);
+  if (!geometry)
+  {
+    return NULL;
+  }
+
+  if (lods && type == GEOMETRY_TYPE_TRIS && !generate_lods(geometry))
+  {
+    destroy_geometry(geometry);
+    return NULL;
+  }
+
+  // Loaded geometry is always floats with 32-bit indices
+  geometry->vertex_format = VERTEX_FORMAT_FLOAT;
+  geometry->quantization = identity_quantization;
+  geometry->index_size = sizeof(uint32_t);
+  if (!upload(geometry, geometry->vertices, geometry->indices))
+  {
+    destroy_geometry(geometry);
+    return NULL;
+  }
+
+  return geometry;
+}
+
+struct Geometry* upload_geometry(const struct GeometryView* view)
+{
+  struct Geometry* geometry = malloc(sizeof(struct Geometry));
+  if (!geometry)
+  {
+    printf("Ran out of memory while uploading geometry\n");
+    return NULL;
+  }
+
+  geometry->vertices = NULL;
+  geometry->indices = NULL;
+  geometry->vertex_count = view->vertex_count;
+  geometry->index_count = view->index_count;
+  geometry->index_size = view->index_size;
+  geometry->floats_per_vertex = view->floats_per_vertex;
+  geometry->vertex_array = 0;
+  geometry->vertex_format = view->vertex_format;
+  geometry->quantization = view->vertex_format == VERTEX_FORMAT_PACKED ? view->quantization : identity_quantization;
+  geometry->lods = view->lods;
+  geometry->draw_offsets = NULL;
+
+  // The submesh table is tiny, so unlike the vertices and indices it is kept
+  const uint32_t submesh_count = view->submesh_count * view->lods.lod_count;
+  geometry->submesh_count = view->submesh_count;
+  geometry->submeshes = malloc(sizeof(struct Submesh) * (submesh_count > 0 ? submesh_count : 1));
+  if (!geometry->submeshes)
+  {
+    printf("Ran out of memory while uploading geometry with %u submeshes\n", submesh_count);
+    free(geometry);
+    return NULL;
+  }
+
+  memcpy(geometry->submeshes, view->submeshes, sizeof(struct Submesh) * submesh_count);
+
+  if (!upload(geometry, view->vertices, view->indices))
+  {
+    destroy_geometry(geometry);
+    return NULL;
+  }
+
   return geometry;
 }
 
 void destroy_geometry(struct Geometry* geometry)
 {
-  free(geometry->vertices);
-  free(geometry->indices);
+  // Geometry from load_geometry was never uploaded, and might not even have an OpenGL context to delete from
+  if (geometry->vertex_array)
+  {
+    glDeleteBuffers(1, &geometry->index_buffer);
+    glDeleteBuffers(1, &geometry->vertex_buffer);
+    glDeleteVertexArrays(1, &geometry->vertex_array);
+  }
 
-  glDeleteBuffers(1, &geometry->index_buffer);
-  glDeleteBuffers(1, &geometry->vertex_buffer);
-  glDeleteVertexArrays(1, &geometry->vertex_array);
+  free_geometry(geometry);
+}
+
+uint32_t select_lod(const struct Geometry* geometry, float pixels_per_unit)
+{
+  uint32_t lod = 0;
+  while (lod + 1 < geometry->lods.lod_count && geometry->lods.errors[lod + 1] * pixels_per_unit <= LOD_MAX_PIXEL_ERROR)
+  {
+    ++lod;
+  }
+
+  return lod;
+}
 
-  free(geometry);
+void draw_geometry(const struct Geometry* geometry, uint32_t lod, const uint8_t* visible)
+{
+  const uint32_t first = lod * geometry->submesh_count;
+  const GLenum index_type = geometry->index_size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+  // Everything at once straight from the prepared arguments
+  if (!visible)
+  {
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, &geometry->draw_counts[first], index_type,
+                                  &geometry->draw_offsets[first], (GLsizei)geometry->submesh_count,
+                                  &geometry->draw_base_vertices[first]);
+    return;
+  }
+
+  // Gathered into the room after the prepared arguments of the last level of detail
+  const uint32_t gathered = geometry->submesh_count * geometry->lods.lod_count;
+  GLsizei count = 0;
+  for (uint32_t index = 0; index < geometry->submesh_count; ++index)
+  {
+    if (visible[index])
+    {
+      geometry->draw_offsets[gathered + count] = geometry->draw_offsets[first + index];
+      geometry->draw_counts[gathered + count] = geometry->draw_counts[first + index];
+      geometry->draw_base_vertices[gathered + count] = geometry->draw_base_vertices[first + index];
+      ++count;
+    }
+  }
+
+  if (count > 0)
+  {
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, &geometry->draw_counts[gathered], index_type,
+                                  &geometry->draw_offsets[gathered], count, &geometry->draw_base_vertices[gathered]);
+  }
 }
@@ -1,23 +1,26 @@
 #pragma once
 
+#include "geometry_data.h"
+
 #include <glad/gl.h>
 
+#include <stdbool.h>
 #include <stdint.h>
 
-struct Geometry
-{
-  float* vertices;
-  uint32_t* indices;
-  uint32_t index_count;
-  uint32_t floats_per_vertex;
-  GLuint vertex_array, vertex_buffer, index_buffer;
-};
-
-enum GeometryType
-{
-  GEOMETRY_TYPE_TRIS = 3,
-  GEOMETRY_TYPE_QUADS = 4
-};
-
-struct Geometry* make_geometry(const char* filename, enum GeometryType type);
+// Loads geometry, generates its levels of detail if requested, which only works for triangles, and uploads it
+struct Geometry* make_geometry(const char* filename, enum GeometryType type, bool lods);
+
+// Uploads geometry that is already in memory without keeping a CPU copy
+struct Geometry* upload_geometry(const struct GeometryView* view);
+
+// Deletes the buffers of uploaded geometry and frees whatever it still has in CPU memory
 void destroy_geometry(struct Geometry* geometry);
+
+// Returns the coarsest level of detail whose error covers at most LOD_MAX_PIXEL_ERROR pixels on screen
+// pixels_per_unit is how many pixels a length of one in object space covers where the geometry is closest to the camera
+uint32_t select_lod(const struct Geometry* geometry, float pixels_per_unit);
+
+// Draws the submeshes of a level of detail of uploaded triangle geometry in one call, however many there are
+// visible has a flag for each submesh of the full mesh, which stands for its levels of detail as well, NULL draws all
+// The vertex array of the geometry has to be bound, see render_queue.h, which binds it only when it changes
+void draw_geometry(const struct Geometry* geometry, uint32_t lod, const uint8_t* visible);
@@ -0,0 +1,367 @@
+#include "geometry_data.h"
+
+#include "obj.h"
+
+#include <assimp/cimport.h>
+#include <assimp/mesh.h>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <assimp/vector3.h>
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_SIZE sizeof(uint32_t)
+
+#define POSITION_STEPS 65535.0f // Of a 16-bit normalized position
+#define NORMAL_STEPS 32767.0f   // Of a 16-bit signed normalized octahedral coordinate
+
+const struct VertexQuantization identity_quantization = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+static const struct LodChain single_lod = { 1, { 0.0f }, { 0.0f, 0.0f, 0.0f }, 0.0f };
+
+struct Geometry* import_geometry(const char* filename, enum GeometryType type)
+{
+  struct Geometry* geometry = malloc(sizeof(struct Geometry));
+  if (!geometry)
+  {
+    printf("Ran out of memory while loading geometry \"%s\"\n", filename);
+    return NULL;
+  }
+
+  geometry->vertices = NULL;
+  geometry->indices = NULL;
+  geometry->submeshes = NULL;
+  geometry->vertex_array = 0;
+  geometry->vertex_buffer = 0;
+  geometry->index_buffer = 0;
+  geometry->vertex_format = VERTEX_FORMAT_FLOAT;
+  geometry->quantization = identity_quantization;
+  geometry->lods = single_lod;
+  geometry->draw_offsets = NULL;
+
+  enum aiPostProcessSteps flags = aiProcess_JoinIdenticalVertices;
+  if (type == GEOMETRY_TYPE_TRIS)
+  {
+    flags |= aiProcess_Triangulate;
+  }
+
+  const struct aiScene* scene = aiImportFile(filename, flags);
+  if (!scene)
+  {
+    printf("Failed to load geometry \"%s\"\n", filename);
+    free(geometry);
+    return NULL;
+  }
+
+  // Determine the total size and the vertex definition (ie. how many floats are required per vertex)
+  // Meshes share a single vertex definition, attributes that only some of them have are zero for the others
+  bool has_normals = false, has_uvs = false;
+  geometry->vertex_count = 0;
+  geometry->index_count = 0;
+  geometry->submesh_count = scene->mNumMeshes;
+  for (unsigned int mesh_index = 0; mesh_index < scene->mNumMeshes; ++mesh_index)
+  {
+    const struct aiMesh* mesh = scene->mMeshes[mesh_index];
+    geometry->vertex_count += mesh->mNumVertices;
+    geometry->index_count += mesh->mNumFaces * type;
+    has_normals |= mesh->mNormals != NULL;
+    has_uvs |= mesh->mTextureCoords[0] != NULL;
+  }
+
+  geometry->floats_per_vertex = 3 + (has_normals ? 3 : 0) + (has_uvs ? 2 : 0); // Position, normal, UV
+
+  const uint32_t vertex_size = geometry->floats_per_vertex * sizeof(float);
+
+  geometry->vertices = calloc(geometry->vertex_count > 0 ? geometry->vertex_count : 1, vertex_size);
+  if (!geometry->vertices)
+  {
+    printf("Ran out of memory while loading geometry \"%s\", requested %u bytes for vertices\n", filename,
+           vertex_size * geometry->vertex_count);
+    aiReleaseImport(scene);
+    free_geometry(geometry);
+    return NULL;
+  }
+
+  geometry->indices = malloc(INDEX_SIZE * (geometry->index_count > 0 ? geometry->index_count : 1));
+  geometry->submeshes = malloc(sizeof(struct Submesh) * (geometry->submesh_count > 0 ? geometry->submesh_count : 1));
+  if (!geometry->indices || !geometry->submeshes)
+  {
+    printf("Ran out of memory while loading geometry \"%s\", requested %zu bytes for indices\n", filename,
+           INDEX_SIZE * geometry->index_count);
+    aiReleaseImport(scene);
+    free_geometry(geometry);
+    return NULL;
+  }
+
+  uint32_t base_vertex = 0, first_index = 0;
+  for (unsigned int mesh_index = 0; mesh_index < scene->mNumMeshes; ++mesh_index)
+  {
+    const struct aiMesh* mesh = scene->mMeshes[mesh_index];
+
+    struct Submesh* submesh = &geometry->submeshes[mesh_index];
+    submesh->first_index = first_index;
+    submesh->index_count = mesh->mNumFaces * type;
+    submesh->base_vertex = base_vertex;
+    submesh->material = mesh->mMaterialIndex;
+
+    for (unsigned int vertex_index = 0; vertex_index < mesh->mNumVertices; ++vertex_index)
+    {
+      float* vertex = &geometry->vertices[(base_vertex + vertex_index) * geometry->floats_per_vertex];
+
+      const struct aiVector3D* position = &mesh->mVertices[vertex_index];
+      vertex[0] = position->x;
+      vertex[1] = position->y;
+      vertex[2] = position->z;
+      vertex += 3;
+
+      if (has_normals)
+      {
+        if (mesh->mNormals)
+        {
+          const struct aiVector3D* normal = &mesh->mNormals[vertex_index];
+          vertex[0] = normal->x;
+          vertex[1] = normal->y;
+          vertex[2] = normal->z;
+        }
+        vertex += 3;
+      }
+
+      if (has_uvs && mesh->mTextureCoords[0])
+      {
+        const struct aiVector3D* uvs = &mesh->mTextureCoords[0][vertex_index];
+        vertex[0] = uvs->x;
+        vertex[1] = uvs->y;
+      }
+    }
+
+    for (unsigned int face_index = 0; face_index < mesh->mNumFaces; ++face_index)
+    {
+      const struct aiFace* face = &mesh->mFaces[face_index];
+
+      if (face->mNumIndices != type)
+      {
+        printf("Geometry \"%s\" has invalid face with %d indices, expected %d\n", filename, face->mNumIndices, type);
+        aiReleaseImport(scene);
+        free_geometry(geometry);
+        return NULL;
+      }
+
+      for (unsigned int index = 0; index < type; ++index)
+      {
+        geometry->indices[first_index + face_index * type + index] = face->mIndices[index];
+      }
+    }
+
+    base_vertex += mesh->mNumVertices;
+    first_index += submesh->index_count;
+  }
+
+  aiReleaseImport(scene);
+
+  return geometry;
+}
+
+static bool is_obj(const char* filename)
+{
+  const size_t length = strlen(filename);
+  if (length < 4)
+  {
+    return false;
+  }
+
+  const char* extension = filename + length - 4;
+  return extension[0] == '.' && tolower(extension[1]) == 'o' && tolower(extension[2]) == 'b' &&
+         tolower(extension[3]) == 'j';
+}
+
+struct Geometry* load_geometry(const char* filename, enum GeometryType type)
+{
+  return is_obj(filename) ? load_obj(filename, type) : import_geometry(filename, type);
+}
+
+void free_geometry(struct Geometry* geometry)
+{
+  free(geometry->vertices);
+  free(geometry->indices);
+  free(geometry->submeshes);
+  free(geometry->draw_offsets);
+  free(geometry);
+}
+
+void release_geometry_data(struct Geometry* geometry)
+{
+  free(geometry->vertices);
+  geometry->vertices = NULL;
+
+  free(geometry->indices);
+  geometry->indices = NULL;
+}
+
+void get_submesh_bounds(const struct Geometry* geometry, struct SubmeshBounds* bounds)
+{
+  for (uint32_t index = 0; index < geometry->submesh_count; ++index)
+  {
+    const struct Submesh* submesh = &geometry->submeshes[index];
+    struct SubmeshBounds* submesh_bounds = &bounds[index];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      submesh_bounds->min[axis] = submesh->index_count > 0 ? INFINITY : 0.0f;
+      submesh_bounds->max[axis] = submesh->index_count > 0 ? -INFINITY : 0.0f;
+    }
+
+    for (uint32_t offset = 0; offset < submesh->index_count; ++offset)
+    {
+      const uint32_t vertex = submesh->base_vertex + geometry->indices[submesh->first_index + offset];
+      const float* position = &geometry->vertices[(size_t)vertex * geometry->floats_per_vertex];
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        submesh_bounds->min[axis] = fminf(submesh_bounds->min[axis], position[axis]);
+        submesh_bounds->max[axis] = fmaxf(submesh_bounds->max[axis], position[axis]);
+      }
+    }
+  }
+}
+
+uint32_t* make_absolute_indices(const uint32_t* indices,
+                                uint32_t index_count,
+                                const struct Submesh* submeshes,
+                                uint32_t submesh_count)
+{
+  uint32_t* absolute_indices = malloc(INDEX_SIZE * (index_count > 0 ? index_count : 1));
+  if (!absolute_indices)
+  {
+    printf("Ran out of memory while merging the indices of %u submeshes\n", submesh_count);
+    return NULL;
+  }
+
+  for (uint32_t index = 0; index < submesh_count; ++index)
+  {
+    const struct Submesh* submesh = &submeshes[index];
+    for (uint32_t offset = 0; offset < submesh->index_count; ++offset)
+    {
+      absolute_indices[submesh->first_index + offset] = indices[submesh->first_index + offset] + submesh->base_vertex;
+    }
+  }
+
+  return absolute_indices;
+}
+
+// Rounds to the nearest half float, overflowing to infinity and flushing values too small for a subnormal to zero
+static uint16_t float_to_half(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(float));
+
+  const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+  const int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+  uint32_t mantissa = bits & 0x7FFFFF;
+
+  if (exponent >= 31)
+  {
+    return sign | 0x7C00; // Infinity, NaNs are not expected in vertex data
+  }
+
+  if (exponent <= 0)
+  {
+    if (exponent < -10)
+    {
+      return sign;
+    }
+
+    // Subnormal, with the implicit leading one shifted in
+    mantissa |= 0x800000;
+    const uint32_t shift = (uint32_t)(14 - exponent);
+    return sign | (uint16_t)((mantissa + (1u << (shift - 1))) >> shift);
+  }
+
+  // Rounding may carry into the exponent, which is still the correctly rounded result
+  return sign | (uint16_t)((((uint32_t)exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+}
+
+static int16_t quantize_snorm(float value)
+{
+  return (int16_t)lroundf(fminf(fmaxf(value, -1.0f), 1.0f) * NORMAL_STEPS);
+}
+
+// Projects the unit normal onto an octahedron and unfolds the lower half over the corners of the upper one
+static void encode_octahedral(const float normal[3], int16_t encoded[2])
+{
+  const float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+  if (length <= 0.0f)
+  {
+    encoded[0] = encoded[1] = 0; // Positive Z
+    return;
+  }
+
+  float x = normal[0] / length;
+  float y = normal[1] / length;
+  if (normal[2] < 0.0f)
+  {
+    const float folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    const float folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = folded_x;
+    y = folded_y;
+  }
+
+  encoded[0] = quantize_snorm(x);
+  encoded[1] = quantize_snorm(y);
+}
+
+struct PackedVertex* pack_vertices(const float* vertices,
+                                   uint32_t floats_per_vertex,
+                                   uint32_t vertex_count,
+                                   struct VertexQuantization* quantization)
+{
+  struct PackedVertex* packed_vertices = malloc(sizeof(struct PackedVertex) * (vertex_count > 0 ? vertex_count : 1));
+  if (!packed_vertices)
+  {
+    printf("Ran out of memory while packing %u vertices\n", vertex_count);
+    return NULL;
+  }
+
+  // The bounds of the positions, each axis gets the full 16 bits
+  float min[3] = { 0.0f, 0.0f, 0.0f }, max[3] = { 0.0f, 0.0f, 0.0f };
+  for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+  {
+    const float* position = &vertices[vertex * floats_per_vertex];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      min[axis] = vertex > 0 ? fminf(min[axis], position[axis]) : position[axis];
+      max[axis] = vertex > 0 ? fmaxf(max[axis], position[axis]) : position[axis];
+    }
+  }
+
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    quantization->position_offset[axis] = min[axis];
+    quantization->position_scale[axis] = max[axis] - min[axis];
+  }
+
+  const bool has_normals = floats_per_vertex >= 6;
+  const bool has_uvs = floats_per_vertex == 5 || floats_per_vertex == 8;
+  for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+  {
+    const float* source = &vertices[vertex * floats_per_vertex];
+    struct PackedVertex* packed = &packed_vertices[vertex];
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      const float scale = quantization->position_scale[axis];
+      const float normalized = scale > 0.0f ? (source[axis] - min[axis]) / scale : 0.0f;
+      packed->position[axis] = (uint16_t)lroundf(fminf(fmaxf(normalized, 0.0f), 1.0f) * POSITION_STEPS);
+    }
+    packed->position[3] = 0;
+
+    const float up[3] = { 0.0f, 0.0f, 1.0f };
+    encode_octahedral(has_normals ? &source[3] : up, packed->normal);
+
+    const float* uv = &source[has_normals ? 6 : 3];
+    packed->uv[0] = has_uvs ? float_to_half(uv[0]) : 0;
+    packed->uv[1] = has_uvs ? float_to_half(uv[1]) : 0;
+  }
+
+  return packed_vertices;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <glad/gl.h> // Only for the types of the handles in struct Geometry, nothing here calls OpenGL
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAX_LOD_COUNT 4         // Including the full mesh
+#define LOD_MAX_PIXEL_ERROR 1.0f // Coarser levels of detail are only drawn while their error stays below a pixel
+
+// A mesh of the source file, drawn from its own range of the shared vertex and index buffers
+struct Submesh
+{
+  uint32_t first_index;
+  uint32_t index_count;
+  uint32_t base_vertex; // Added to every index of the submesh
+  uint32_t material;
+};
+
+// Axis-aligned bounds of the triangles of a submesh, which hold those of its levels of detail as well
+struct SubmeshBounds
+{
+  float min[3];
+  float max[3];
+};
+
+// How vertices are stored in a vertex buffer
+enum VertexFormat
+{
+  VERTEX_FORMAT_FLOAT,  // Interleaved floats, position, then normal and UV if there are any
+  VERTEX_FORMAT_PACKED  // struct PackedVertex, always with all three attributes
+};
+
+// Half the size of a vertex with all attributes as floats, decoded by the vertex attributes and the vertex shader
+struct PackedVertex
+{
+  uint16_t position[4]; // Normalized to the bounds of the geometry, the fourth is padding
+  int16_t normal[2];    // Octahedral encoding of the unit normal
+  uint16_t uv[2];       // Half floats
+};
+
+// Decodes packed positions: position = offset + normalized position * scale
+struct VertexQuantization
+{
+  float position_offset[3];
+  float position_scale[3];
+};
+
+// Levels of detail of a geometry, which share its vertices but each have their own indices
+// The submeshes of each level follow those of the previous one, one for each submesh of the full mesh
+struct LodChain
+{
+  uint32_t lod_count;          // At least 1, the full mesh
+  float errors[MAX_LOD_COUNT]; // Largest distance of each level from the full mesh, in object space, 0 for the first
+  float bounds_center[3];      // Bounding sphere of the vertices, in object space
+  float bounds_radius;
+};
+
+// All meshes of a file merged into one vertex and one index buffer, see struct Submesh for the parts
+struct Geometry
+{
+  float* vertices; // Always floats on the CPU, only uploaded geometry can be packed
+  uint32_t* indices; // Relative to the base vertex of their submesh
+  uint32_t vertex_count;
+  uint32_t index_count; // Of all levels of detail
+  uint32_t floats_per_vertex;
+
+  struct Submesh* submeshes;
+  uint32_t submesh_count; // Of each level of detail
+  struct LodChain lods;
+
+  GLuint vertex_array, vertex_buffer, index_buffer;
+  uint32_t index_size; // In bytes, 2 or 4 in the index buffer, the CPU copy always has 32-bit indices
+  enum VertexFormat vertex_format;
+  struct VertexQuantization quantization; // Identity for VERTEX_FORMAT_FLOAT
+
+  // Arguments to draw all submeshes of a level of detail in a single glMultiDrawElementsBaseVertex, prepared on upload
+  // followed by room to gather those of the visible submeshes while drawing
+  GLsizei* draw_counts;
+  const void** draw_offsets;
+  GLint* draw_base_vertices;
+};
+
+// Geometry that is already in memory in its final form, like that of a cooked mesh, to be uploaded as it is
+struct GeometryView
+{
+  const void* vertices; // floats_per_vertex floats or a struct PackedVertex each, depending on the vertex format
+  const void* indices;  // Relative to the base vertex of their submesh, index_size bytes each, 2 or 4
+  const struct Submesh* submeshes;
+  const struct SubmeshBounds* submesh_bounds; // One for each submesh of the full mesh
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint32_t index_size;
+  uint32_t floats_per_vertex; // Of the source, even if the vertices are packed
+  uint32_t submesh_count;
+  enum VertexFormat vertex_format;
+  struct VertexQuantization quantization; // Only used for packed vertices
+  struct LodChain lods;
+};
+
+enum GeometryType
+{
+  GEOMETRY_TYPE_TRIS = 3,
+  GEOMETRY_TYPE_QUADS = 4
+};
+
+// Leaves packed positions as they are, for geometry with float vertices
+extern const struct VertexQuantization identity_quantization;
+
+// Loads geometry into CPU memory only, which does not need an OpenGL context, see geometry.h to upload it
+// OBJ files are read by the native parser in obj.h, anything else is imported through assimp
+struct Geometry* load_geometry(const char* filename, enum GeometryType type);
+
+// Always imports through assimp, like load_geometry does for anything that is not an OBJ file
+struct Geometry* import_geometry(const char* filename, enum GeometryType type);
+
+// Frees geometry that was never uploaded, uploaded geometry is destroyed with destroy_geometry instead
+void free_geometry(struct Geometry* geometry);
+
+// Frees the CPU copy of the vertices and indices once they are no longer needed after the upload
+void release_geometry_data(struct Geometry* geometry);
+
+// Writes the bounds of each submesh of the full mesh, from the CPU copy of the vertices
+void get_submesh_bounds(const struct Geometry* geometry, struct SubmeshBounds* bounds);
+
+// Returns the vertices in VERTEX_FORMAT_PACKED, quantized to the bounds of their positions
+// Missing normals point along positive Z and missing UVs are zero
+struct PackedVertex* pack_vertices(const float* vertices,
+                                   uint32_t floats_per_vertex,
+                                   uint32_t vertex_count,
+                                   struct VertexQuantization* quantization);
+
+// Returns the indices of all submeshes with their base vertex added, as one triangle list for the whole geometry
+uint32_t* make_absolute_indices(const uint32_t* indices,
+                                uint32_t index_count,
+                                const struct Submesh* submeshes,
+                                uint32_t submesh_count);
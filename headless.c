@@ -0,0 +1,198 @@
+#include "headless.h"
+
+#include "character.h"
+#include "collision.h"
+#include "crowd.h"
+#include "jobs.h"
+#include "profiler.h"
+
+#include <cglm/mat4.h>
+#include <cglm/vec3.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define AGENT_MOVE_SPEED 10.0f // The same as the player
+#define AGENTS_PER_JOB 64
+#define IDLE_CHANCE 0.5f // How likely an agent is to stand still rather than walk after turning
+#define MIN_TICKS_UNTIL_TURN 60
+#define MAX_TICKS_UNTIL_TURN 240
+
+static vec3 gravity = { 0.0f, -0.1f, 0.0f };
+
+// How an agent wanders around, next to its character
+struct Agent
+{
+  vec3 direction; // Zero while idle
+  uint32_t ticks_until_turn;
+  uint32_t random_state;
+};
+
+struct TickContext
+{
+  struct Agent* agents;
+  struct Character* characters;
+  float delta_time;
+};
+
+static float random_float(uint32_t* state, float min, float max)
+{
+  // xorshift32
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return min + (max - min) * (float)(*state >> 8) / (float)(1u << 24);
+}
+
+// Picks a new random direction to walk in, or none to stand still
+static void turn_agent(struct Agent* agent)
+{
+  if (random_float(&agent->random_state, 0.0f, 1.0f) < IDLE_CHANCE)
+  {
+    glm_vec3_zero(agent->direction);
+  }
+  else
+  {
+    const float angle = random_float(&agent->random_state, 0.0f, GLM_PIf * 2.0f);
+    agent->direction[0] = cosf(angle);
+    agent->direction[1] = 0.0f;
+    agent->direction[2] = sinf(angle);
+  }
+
+  agent->ticks_until_turn =
+    (uint32_t)random_float(&agent->random_state, (float)MIN_TICKS_UNTIL_TURN, (float)MAX_TICKS_UNTIL_TURN);
+}
+
+static void steer_agents(void* data, uint32_t begin, uint32_t end)
+{
+  const struct TickContext* context = data;
+  for (uint32_t index = begin; index < end; ++index)
+  {
+    struct Agent* agent = &context->agents[index];
+    if (agent->ticks_until_turn-- == 0)
+    {
+      turn_agent(agent);
+    }
+
+    // Move like the player does, which keeps the transform before the tick for interpolation as well
+    struct Character* character = &context->characters[index];
+    glm_mat4_copy(character->transform, character->previous_transform);
+    glm_vec3_add(agent->direction, gravity, character->velocity);
+    glm_vec3_scale_as(character->velocity, context->delta_time * AGENT_MOVE_SPEED, character->velocity);
+  }
+}
+
+static void update_characters(void* data, uint32_t begin, uint32_t end)
+{
+  const struct TickContext* context = data;
+  for (uint32_t index = begin; index < end; ++index)
+  {
+    update_character(&context->characters[index]);
+  }
+}
+
+bool run_headless(enum CollisionBackend collision_backend, uint32_t agent_count, uint32_t tick_count, double tick_rate)
+{
+  if (!generate_level_collision(collision_backend))
+  {
+    return false;
+  }
+
+  struct Agent* agents = malloc(sizeof(struct Agent) * (agent_count > 0 ? agent_count : 1));
+  struct Character* characters = malloc(sizeof(struct Character) * (agent_count > 0 ? agent_count : 1));
+  if (!agents || !characters)
+  {
+    printf("Ran out of memory while spawning %u agents\n", agent_count);
+    free(characters);
+    free(agents);
+    destroy_level_collision();
+    return false;
+  }
+
+  struct Crowd* crowd = make_crowd(agent_count);
+  if (!crowd)
+  {
+    free(characters);
+    free(agents);
+    destroy_level_collision();
+    return false;
+  }
+
+  // Spawn the agents all over the floor of the level, the ones that end up in walls are pushed out on the first tick
+  {
+    vec3 min, max;
+    get_level_bounds(min, max);
+
+    for (uint32_t index = 0; index < agent_count; ++index)
+    {
+      struct Agent* agent = &agents[index];
+      agent->random_state = 0x9E3779B9u * (index + 1);
+
+      const vec3 position = { random_float(&agent->random_state, min[0], max[0]), min[1] + 0.01f,
+                              random_float(&agent->random_state, min[2], max[2]) };
+      init_character(&characters[index], position);
+      turn_agent(agent);
+    }
+  }
+
+  // Picks the batched collision functions up front, before the job threads start using them
+  printf("Simulating %u agents for %u ticks at %.0f Hz on %u threads, batched collision uses %s\n", agent_count,
+         tick_count, tick_rate, get_job_thread_count(), get_batch_collision_isa());
+
+  struct TickContext context;
+  context.agents = agents;
+  context.characters = characters;
+  context.delta_time = (float)(1.0 / tick_rate);
+
+  uint64_t min_tick = UINT64_MAX, max_tick = 0;
+  uint64_t total_pair_count = 0;
+  const uint64_t start = get_profiler_time();
+  for (uint32_t tick = 0; tick < tick_count; ++tick)
+  {
+    const uint64_t tick_start = get_profiler_time();
+
+    begin_cpu_zone(PROFILE_ZONE_UPDATE);
+    update_level(context.delta_time);
+    parallel_for(agent_count, AGENTS_PER_JOB, steer_agents, &context);
+
+    // Push apart the agents that overlap each other first, their characters then move through the level
+    begin_cpu_zone(PROFILE_ZONE_CROWD_COLLISION);
+    total_pair_count += separate_characters(crowd, characters, agent_count);
+    end_cpu_zone(PROFILE_ZONE_CROWD_COLLISION);
+
+    parallel_for(agent_count, AGENTS_PER_JOB, update_characters, &context);
+    end_cpu_zone(PROFILE_ZONE_UPDATE);
+
+    const uint64_t tick_duration = get_profiler_time() - tick_start;
+    min_tick = tick_duration < min_tick ? tick_duration : min_tick;
+    max_tick = tick_duration > max_tick ? tick_duration : max_tick;
+  }
+  const double elapsed = (double)(get_profiler_time() - start) * 1e-9;
+
+  uint32_t contact_count = 0;
+  for (uint32_t index = 0; index < agent_count; ++index)
+  {
+    contact_count += characters[index].in_contact;
+  }
+
+  const double updates = (double)agent_count * (double)tick_count;
+  printf("%.3f s, %.1f ticks/s (min %.3f ms, max %.3f ms per tick), %.0f agent updates/s, %.1f ns per agent update\n",
+         elapsed, (double)tick_count / elapsed, (double)min_tick * 1e-6, (double)max_tick * 1e-6, updates / elapsed,
+         elapsed * 1e9 / updates);
+  printf("%u of %u agents in contact with the level after the last tick, %.1f overlapping pairs of agents per tick\n",
+         contact_count, agent_count, (double)total_pair_count / (double)(tick_count > 0 ? tick_count : 1));
+
+  for (uint32_t index = 0; index < agent_count; ++index)
+  {
+    destroy_character(&characters[index]);
+  }
+  free(characters);
+  free(agents);
+
+  destroy_crowd(crowd);
+
+  destroy_level_collision();
+
+  return true;
+}
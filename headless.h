@@ -0,0 +1,10 @@
+#pragma once
+
+#include "level.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Simulates agent_count wandering characters in the level for tick_count fixed ticks, without a window or OpenGL
+// The agents push each other apart and update in parallel on the job threads, the throughput is printed at the end
+bool run_headless(enum CollisionBackend collision_backend, uint32_t agent_count, uint32_t tick_count, double tick_rate);
@@ -0,0 +1,186 @@
+#include "jobs.h"
+
+#include "thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_WORKER_COUNT 63
+
+struct ParallelFor
+{
+  JobFunction function;
+  void* data;
+  uint32_t count;
+  uint32_t batch_size;
+  volatile uint32_t next_batch;
+  uint32_t batch_count;
+};
+
+static Thread workers[MAX_WORKER_COUNT];
+static uint32_t worker_count = 0;
+
+static Mutex mutex;
+static Condition work_condition, done_condition;
+
+static Mutex submit_mutex; // Only one parallel_for is distributed to the workers at a time
+
+static struct ParallelFor* current = NULL;
+static uint32_t generation = 0; // Incremented for every new parallel_for so that workers notice it
+static uint32_t active_workers = 0;
+static bool quitting = false;
+
+static THREAD_LOCAL bool is_job_thread = false;
+
+static void run_batches(struct ParallelFor* job)
+{
+  for (;;)
+  {
+    const uint32_t batch = atomic_add_u32(&job->next_batch, 1);
+    if (batch >= job->batch_count)
+    {
+      return;
+    }
+
+    const uint32_t begin = batch * job->batch_size;
+    const uint32_t end = begin + job->batch_size < job->count ? begin + job->batch_size : job->count;
+    job->function(job->data, begin, end);
+  }
+}
+
+static void worker_main(void* data)
+{
+  is_job_thread = true;
+
+  uint32_t seen_generation = 0;
+
+  lock_mutex(&mutex);
+  for (;;)
+  {
+    while (!quitting && generation == seen_generation)
+    {
+      wait_condition(&work_condition, &mutex);
+    }
+
+    if (quitting)
+    {
+      break;
+    }
+
+    seen_generation = generation;
+    struct ParallelFor* job = current;
+    if (!job)
+    {
+      // Woke up too late, the job has already been finished by the other threads
+      continue;
+    }
+
+    ++active_workers;
+    unlock_mutex(&mutex);
+
+    run_batches(job);
+
+    lock_mutex(&mutex);
+    if (--active_workers == 0)
+    {
+      signal_condition(&done_condition);
+    }
+  }
+  unlock_mutex(&mutex);
+}
+
+bool init_jobs()
+{
+  init_mutex(&mutex);
+  init_mutex(&submit_mutex);
+  init_condition(&work_condition);
+  init_condition(&done_condition);
+
+  quitting = false;
+
+  const uint32_t cpu_count = get_cpu_count();
+  const uint32_t count = cpu_count - 1 < MAX_WORKER_COUNT ? cpu_count - 1 : MAX_WORKER_COUNT;
+  for (worker_count = 0; worker_count < count; ++worker_count)
+  {
+    if (!start_thread(&workers[worker_count], worker_main, NULL))
+    {
+      destroy_jobs();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void destroy_jobs()
+{
+  lock_mutex(&mutex);
+  quitting = true;
+  broadcast_condition(&work_condition);
+  unlock_mutex(&mutex);
+
+  for (uint32_t worker = 0; worker < worker_count; ++worker)
+  {
+    join_thread(workers[worker]);
+  }
+  worker_count = 0;
+
+  destroy_condition(&done_condition);
+  destroy_condition(&work_condition);
+  destroy_mutex(&submit_mutex);
+  destroy_mutex(&mutex);
+}
+
+uint32_t get_job_thread_count()
+{
+  return worker_count + 1;
+}
+
+void parallel_for(uint32_t count, uint32_t batch_size, JobFunction function, void* data)
+{
+  if (count == 0)
+  {
+    return;
+  }
+
+  batch_size = batch_size > 0 ? batch_size : 1;
+
+  // Not worth waking up the workers, or nested in another job where waiting on the workers could deadlock
+  if (worker_count == 0 || count <= batch_size || is_job_thread)
+  {
+    function(data, 0, count);
+    return;
+  }
+
+  struct ParallelFor job;
+  job.function = function;
+  job.data = data;
+  job.count = count;
+  job.batch_size = batch_size;
+  job.next_batch = 0;
+  job.batch_count = (count + batch_size - 1) / batch_size;
+
+  lock_mutex(&submit_mutex);
+
+  lock_mutex(&mutex);
+  current = &job;
+  ++generation;
+  broadcast_condition(&work_condition);
+  unlock_mutex(&mutex);
+
+  // The calling thread helps out as well
+  is_job_thread = true;
+  run_batches(&job);
+  is_job_thread = false;
+
+  // All batches have been taken now, wait for the workers that are still busy with theirs
+  lock_mutex(&mutex);
+  while (active_workers > 0)
+  {
+    wait_condition(&done_condition, &mutex);
+  }
+  current = NULL;
+  unlock_mutex(&mutex);
+
+  unlock_mutex(&submit_mutex);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Processes the items in [begin, end)
+typedef void (*JobFunction)(void* data, uint32_t begin, uint32_t end);
+
+// Starts one worker thread per additional CPU core
+bool init_jobs();
+void destroy_jobs();
+
+// Number of threads that work on a parallel_for, including the calling thread
+uint32_t get_job_thread_count();
+
+// Splits count items into chunks of batch_size items and processes them on all threads, returns when all are done
+// Runs on the calling thread only when called from within a job or before init_jobs()
+void parallel_for(uint32_t count, uint32_t batch_size, JobFunction function, void* data);
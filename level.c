@@ -1,60 +1,336 @@
 #include "level.h"
 
+#include "assets.h"
+#include "bvh.h"
+#include "camera.h"
+#include "collision_mesh.h"
+#include "cooked_mesh.h"
+#include "cooked_texture.h"
+#include "frustum.h"
 #include "geometry.h"
+#include "mover.h"
+#include "render_queue.h"
+#include "scene_query.h"
+#include "sdf.h"
 #include "shader.h"
 #include "texture.h"
 
+#include <cglm/mat4.h>
+#include <cglm/vec3.h>
+
 #include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LEVEL_FILENAME "levels/level.obj"
+#define LEVEL_MOVERS_FILENAME "levels/level.movers"
+#define LEVEL_TEXTURE_FILENAME "textures/brick.png"
+
+#define LEVEL_CHUNK_SIZE 8.0f // Of the chunks that the level is culled in, see partition.h
+
+#define MAX_MOVER_COUNT 16
+#define MAX_MOVER_LINE_LENGTH 512
+#define CASTS_PER_MOVER_BATCH 64
+
+#define SDF_VOXEL_SIZE 0.1f
+#define SDF_BAND 1.0f // Has to be larger than the radius of anything colliding with the SDF
+
+// Only what the render queue sets, the texture sampler keeps its default of unit 0
+static const char* const uniform_names[OBJECT_UNIFORM_COUNT] = { OBJECT_UNIFORM_NAMES };
+
+static struct ShaderProgram* shader_program;
 
-static GLuint shader_program;
-static GLint viewproj_uniform_location;
+static struct CookOptions cook_options = { VERTEX_FORMAT_FLOAT, false, false, 0.0f };
 
-static struct Geometry* geometry;
-static GLuint texture;
+static struct Geometry* geometry = NULL;
+static uint8_t* visible_chunks = NULL; // Flags of the level chunks that are in view, written each frame
+static GLuint texture = 0, placeholder_texture; // The placeholder is drawn with until the texture has arrived
 
-bool generate_level()
+// Loaded in the background while the first frames are drawn, see assets.h
+static struct Asset *collision_asset = NULL, *texture_asset = NULL;
+static enum CollisionBackend requested_backend;
+static bool compressed_textures;
+static struct TextureData* texture_data = NULL;
+
+static struct CookedMesh* level_mesh = NULL;
+static struct CollisionMesh* collision_mesh; // Both point into the cooked level mesh
+static struct Bvh* bvh;
+static struct Sdf* sdf = NULL;
+
+struct MoverDefinition
 {
-  geometry = make_geometry("levels/level.obj", GEOMETRY_TYPE_TRIS);
-  if (!geometry)
+  char filename[256]; // Read with %255s
+  vec3 origin, travel;
+  float period, spin;
+};
+
+// Read from LEVEL_MOVERS_FILENAME
+static struct MoverDefinition mover_definitions[MAX_MOVER_COUNT];
+static uint32_t mover_count = 0;
+
+static struct Mover* movers[MAX_MOVER_COUNT];
+static struct CookedMesh* mover_meshes[MAX_MOVER_COUNT];
+static struct Geometry* mover_geometries[MAX_MOVER_COUNT]; // NULL without rendering
+
+// Each line is the mesh filename, the origin, the travel, the period and the spin, see struct Mover
+// Empty lines and everything after a # are skipped
+static bool load_mover_definitions()
+{
+  FILE* file = fopen(LEVEL_MOVERS_FILENAME, "r");
+  if (!file)
   {
+    printf("Failed to open mover definitions \"%s\"\n", LEVEL_MOVERS_FILENAME);
     return false;
   }
 
-  // Load texture
-  if (!load_texture("textures/brick.png", &texture))
+  mover_count = 0;
+
+  char line[MAX_MOVER_LINE_LENGTH];
+  for (uint32_t line_number = 1; fgets(line, sizeof(line), file); ++line_number)
+  {
+    line[strcspn(line, "#\r\n")] = '\0';
+    if (line[strspn(line, " \t")] == '\0')
+    {
+      continue;
+    }
+
+    if (mover_count == MAX_MOVER_COUNT)
+    {
+      printf("Mover definitions \"%s\" have more than %d movers\n", LEVEL_MOVERS_FILENAME, MAX_MOVER_COUNT);
+      fclose(file);
+      return false;
+    }
+
+    struct MoverDefinition* definition = &mover_definitions[mover_count];
+    char extra;
+    if (sscanf(line, "%255s %f %f %f %f %f %f %f %f %c", definition->filename, &definition->origin[0],
+               &definition->origin[1], &definition->origin[2], &definition->travel[0], &definition->travel[1],
+               &definition->travel[2], &definition->period, &definition->spin, &extra) != 9 ||
+        definition->period <= 0.0f)
+    {
+      printf("Mover definitions \"%s\" have an invalid line %u\n", LEVEL_MOVERS_FILENAME, line_number);
+      fclose(file);
+      return false;
+    }
+
+    ++mover_count;
+  }
+
+  fclose(file);
+  return true;
+}
+
+static void destroy_movers()
+{
+  for (uint32_t index = 0; index < mover_count; ++index)
+  {
+    if (movers[index])
+    {
+      destroy_mover(movers[index]);
+      movers[index] = NULL;
+    }
+
+    if (mover_geometries[index])
+    {
+      destroy_geometry(mover_geometries[index]);
+      mover_geometries[index] = NULL;
+    }
+
+    if (mover_meshes[index])
+    {
+      destroy_cooked_mesh(mover_meshes[index]);
+      mover_meshes[index] = NULL;
+    }
+  }
+}
+
+// Only the static level is split into chunks, the movers are small and drawn whole
+static struct CookOptions get_cook_options(bool chunked)
+{
+  struct CookOptions options = cook_options;
+  options.chunk_size = chunked ? LEVEL_CHUNK_SIZE : 0.0f;
+  return options;
+}
+
+// Loads the movers along with their collision, their geometry is uploaded later with the level
+static bool generate_movers()
+{
+  if (!load_mover_definitions())
   {
-    destroy_geometry(geometry);
     return false;
   }
 
-  // Generate shader program
+  const struct CookOptions options = get_cook_options(false);
+  for (uint32_t index = 0; index < mover_count; ++index)
   {
-    GLuint vert, frag;
-    if (!load_shader("shaders/level.vert.glsl", GL_VERTEX_SHADER, &vert))
+    const struct MoverDefinition* definition = &mover_definitions[index];
+
+    struct CookedMesh* mesh = load_cooked_mesh(definition->filename, &options);
+    if (!mesh)
     {
-      destroy_geometry(geometry);
+      destroy_movers();
       return false;
     }
 
-    if (!load_shader("shaders/level.frag.glsl", GL_FRAGMENT_SHADER, &frag))
+    mover_meshes[index] = mesh;
+
+    movers[index] = make_mover(&mesh->collision_mesh, &mesh->bvh, definition->origin, definition->travel,
+                               definition->period, definition->spin);
+    if (!movers[index])
     {
-      destroy_geometry(geometry);
+      destroy_movers();
       return false;
     }
+  }
 
-    if (!generate_shader_program(vert, frag, &shader_program))
+  return true;
+}
+
+// Loads the collision for the static level, and the movers as well
+// The movers always collide with their triangles, as their SDF would have to be rebaked whenever they move
+// Needs no OpenGL context, so that it can run on any thread
+static bool generate_collision(enum CollisionBackend collision_backend)
+{
+  const struct CookOptions options = get_cook_options(true);
+  level_mesh = load_cooked_mesh(LEVEL_FILENAME, &options);
+  if (!level_mesh)
+  {
+    return false;
+  }
+
+  collision_mesh = &level_mesh->collision_mesh;
+  bvh = &level_mesh->bvh;
+
+  if (collision_backend == COLLISION_BACKEND_SDF)
+  {
+    sdf = make_sdf(collision_mesh, bvh, SDF_VOXEL_SIZE, SDF_BAND);
+    if (!sdf)
     {
-      destroy_geometry(geometry);
+      destroy_cooked_mesh(level_mesh);
+      level_mesh = NULL;
       return false;
     }
+  }
+
+  if (!generate_movers())
+  {
+    if (sdf)
+    {
+      destroy_sdf(sdf);
+      sdf = NULL;
+    }
+
+    destroy_cooked_mesh(level_mesh);
+    level_mesh = NULL;
+    return false;
+  }
+
+  return true;
+}
+
+static void destroy_collision()
+{
+  destroy_movers();
+
+  if (sdf)
+  {
+    destroy_sdf(sdf);
+    sdf = NULL;
+  }
+
+  if (level_mesh)
+  {
+    destroy_cooked_mesh(level_mesh);
+    level_mesh = NULL;
+  }
+}
 
-    glUseProgram(shader_program);
+static bool load_collision_asset(void* data)
+{
+  return generate_collision(*(const enum CollisionBackend*)data);
+}
 
-    // Retrieve uniform locations
-    viewproj_uniform_location = get_uniform_location(shader_program, "viewproj");
+// Straight from the cooked meshes to the GPU
+// Only the transform of a mover changes, so its vertices are uploaded once and then only needed on the GPU
+static bool upload_level_geometry(void* data)
+{
+  geometry = upload_geometry(&level_mesh->geometry);
+  if (!geometry)
+  {
+    return false;
+  }
 
-    // Set uniforms
-    set_uniform_i(shader_program, "tex", 0);
+  visible_chunks = malloc(geometry->submesh_count > 0 ? geometry->submesh_count : 1);
+  if (!visible_chunks)
+  {
+    printf("Ran out of memory while uploading the level, requested flags for %u chunks\n", geometry->submesh_count);
+    return false;
+  }
+
+  for (uint32_t index = 0; index < mover_count; ++index)
+  {
+    mover_geometries[index] = upload_geometry(&mover_meshes[index]->geometry);
+    if (!mover_geometries[index])
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool load_texture_asset(void* data)
+{
+  texture_data = load_texture_data(LEVEL_TEXTURE_FILENAME, compressed_textures);
+  return texture_data != NULL;
+}
+
+static bool upload_texture_asset(void* data)
+{
+  upload_texture(texture_data, &texture);
+  destroy_texture_data(texture_data);
+  texture_data = NULL;
+  return true;
+}
+
+void set_level_cook_options(const struct CookOptions* options)
+{
+  cook_options = *options;
+}
+
+bool generate_level(enum CollisionBackend collision_backend)
+{
+  // Generate shader program, which is small enough to not be worth loading in the background
+  shader_program =
+    make_shader_program("shaders/level.vert.glsl", "shaders/level.frag.glsl", uniform_names, OBJECT_UNIFORM_COUNT);
+  if (!shader_program)
+  {
+    return false;
+  }
+
+  // A single grey pixel
+  {
+    const uint8_t pixel[3] = { 128, 128, 128 };
+    glGenTextures(1, &placeholder_texture);
+    glBindTexture(GL_TEXTURE_2D, placeholder_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, pixel);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  }
+
+  // Queue the rest, which is cooked, parsed and decoded on the loader threads
+  requested_backend = collision_backend;
+  compressed_textures = has_compressed_textures();
+
+  collision_asset = request_asset(load_collision_asset, upload_level_geometry, &requested_backend);
+  texture_asset = request_asset(load_texture_asset, upload_texture_asset, NULL);
+  if (!collision_asset || !texture_asset)
+  {
+    destroy_level();
+    return false;
   }
 
   return true;
@@ -62,47 +338,236 @@ bool generate_level()
 
 void destroy_level()
 {
-  destroy_shader(shader_program);
-  destroy_texture(texture);
-  destroy_geometry(geometry);
+  // Whatever is still on its way has to arrive first, so that it can be destroyed
+  if (collision_asset)
+  {
+    release_asset(collision_asset);
+    collision_asset = NULL;
+  }
+
+  if (texture_asset)
+  {
+    release_asset(texture_asset);
+    texture_asset = NULL;
+  }
+
+  destroy_shader_program(shader_program);
+  destroy_texture(placeholder_texture);
+
+  if (texture)
+  {
+    destroy_texture(texture);
+    texture = 0;
+  }
+
+  destroy_collision();
+
+  if (geometry)
+  {
+    destroy_geometry(geometry);
+    geometry = NULL;
+  }
+
+  free(visible_chunks);
+  visible_chunks = NULL;
+}
+
+enum AssetState get_level_state()
+{
+  const enum AssetState collision_state = get_asset_state(collision_asset);
+  const enum AssetState texture_state = get_asset_state(texture_asset);
+  if (collision_state == ASSET_STATE_FAILED || texture_state == ASSET_STATE_FAILED)
+  {
+    return ASSET_STATE_FAILED;
+  }
+
+  return collision_state;
+}
+
+bool generate_level_collision(enum CollisionBackend collision_backend)
+{
+  return generate_collision(collision_backend);
+}
+
+void destroy_level_collision()
+{
+  destroy_collision();
+}
+
+bool cook_level()
+{
+  const struct CookOptions level_options = get_cook_options(true);
+  if (!cook_mesh(LEVEL_FILENAME, &level_options) || !cook_texture(LEVEL_TEXTURE_FILENAME))
+  {
+    return false;
+  }
+
+  if (!load_mover_definitions())
+  {
+    return false;
+  }
+
+  const struct CookOptions mover_options = get_cook_options(false);
+  for (uint32_t index = 0; index < mover_count; ++index)
+  {
+    if (!cook_mesh(mover_definitions[index].filename, &mover_options))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void update_level(float delta_time)
+{
+  for (uint32_t index = 0; index < mover_count; ++index)
+  {
+    update_mover(movers[index], delta_time);
+  }
 }
 
-void draw_level(mat4 viewproj_matrix)
+// Submits the geometry in the level of detail that suits its distance to the camera
+// Only the submeshes flagged in visible are drawn, all of them if it is NULL
+static void submit_level_geometry(const struct Geometry* level_geometry,
+                                  GLuint level_texture,
+                                  const uint8_t* visible,
+                                  mat4 world_matrix,
+                                  float alpha)
 {
-  glBindVertexArray(geometry->vertex_array);
-  glUseProgram(shader_program);
+  vec3 center;
+  glm_mat4_mulv3(world_matrix, (float*)level_geometry->lods.bounds_center, 1.0f, center);
+  const float pixels_per_unit = get_camera_pixels_per_unit(alpha, center, level_geometry->lods.bounds_radius);
+  const uint32_t lod = select_lod(level_geometry, pixels_per_unit);
+  submit_draw(shader_program, level_texture, level_geometry, lod, visible, world_matrix);
+}
 
-  // Set texture
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texture);
+void draw_level(const mat4 viewproj_matrix, float alpha)
+{
+  // The placeholder while the texture is still loading
+  const GLuint level_texture = get_asset_state(texture_asset) == ASSET_STATE_READY ? texture : placeholder_texture;
 
-  // Set view-projection matrix uniform
-  glUniformMatrix4fv(viewproj_uniform_location, 1, GL_FALSE, (float*)viewproj_matrix);
+  // The static level is in world space already, so its chunks are culled against the frustum as they are
+  struct Frustum frustum;
+  make_frustum(viewproj_matrix, &frustum);
+  if (cull_boxes(&frustum, level_mesh->geometry.submesh_bounds, geometry->submesh_count, visible_chunks) > 0)
+  {
+    submit_level_geometry(geometry, level_texture, visible_chunks, GLM_MAT4_IDENTITY, alpha);
+  }
 
-  // Draw the level
-  glDrawElements(GL_TRIANGLES, geometry->index_count, GL_UNSIGNED_INT, 0);
+  // The movers, whose vertices stay on the GPU and only their transform changes
+  for (uint32_t index = 0; index < mover_count; ++index)
+  {
+    mat4 world_matrix;
+    get_mover_render_transform(movers[index], alpha, world_matrix);
+    submit_level_geometry(mover_geometries[index], level_texture, NULL, world_matrix, alpha);
+  }
+}
+
+const struct Sdf* get_level_sdf()
+{
+  return sdf;
 }
 
 uint32_t get_triangle_count()
 {
-  return geometry->index_count / 3;
+  return collision_mesh->triangle_count;
 }
 
 void get_triangle(uint32_t index, vec3 v0, vec3 v1, vec3 v2, vec3 n)
 {
-  v0[0] = geometry->vertices[geometry->indices[index * 3 + 0] * geometry->floats_per_vertex + 0];
-  v0[1] = geometry->vertices[geometry->indices[index * 3 + 0] * geometry->floats_per_vertex + 1];
-  v0[2] = geometry->vertices[geometry->indices[index * 3 + 0] * geometry->floats_per_vertex + 2];
+  get_collision_triangle(collision_mesh, index, v0, v1, v2, n);
+}
+
+void get_triangle_batch(const uint32_t* triangles, uint32_t count, struct TriangleBatch* batch)
+{
+  get_collision_triangle_batch(collision_mesh, triangles, count, batch);
+}
+
+uint32_t query_level_triangles(const vec3 min, const vec3 max, uint32_t* triangles, uint32_t capacity)
+{
+  return query_bvh(bvh, min, max, triangles, capacity);
+}
+
+void cast_level(const struct SceneCast* casts, struct SceneHit* hits, uint32_t count)
+{
+  // The static part of the level through the same backend the characters collide with
+  if (sdf)
+  {
+    for (uint32_t index = 0; index < count; ++index)
+    {
+      const struct SceneCast* cast = &casts[index];
+      struct SceneHit* hit = &hits[index];
+      hit->hit = sphere_cast_sdf(sdf, (float*)cast->origin, (float*)cast->dir, cast->radius, cast->max_dist, &hit->dist,
+                                 hit->normal);
+    }
+  }
+  else
+  {
+    cast_scene(collision_mesh, bvh, casts, hits, count);
+  }
+
+  // Cast against each mover in its local space, where distances are the same as in world space
+  for (uint32_t index = 0; index < mover_count; ++index)
+  {
+    const struct Mover* mover = movers[index];
+
+    for (uint32_t first = 0; first < count; first += CASTS_PER_MOVER_BATCH)
+    {
+      const uint32_t remaining = count - first;
+      const uint32_t batch_count = remaining < CASTS_PER_MOVER_BATCH ? remaining : CASTS_PER_MOVER_BATCH;
+
+      struct SceneCast local_casts[CASTS_PER_MOVER_BATCH];
+      struct SceneHit local_hits[CASTS_PER_MOVER_BATCH];
+      for (uint32_t cast = 0; cast < batch_count; ++cast)
+      {
+        const struct SceneCast* world_cast = &casts[first + cast];
+        struct SceneCast* local_cast = &local_casts[cast];
+        glm_mat4_mulv3((vec4*)mover->inverse_transform, (float*)world_cast->origin, 1.0f, local_cast->origin);
+        glm_mat4_mulv3((vec4*)mover->inverse_transform, (float*)world_cast->dir, 0.0f, local_cast->dir);
+        local_cast->radius = world_cast->radius;
+
+        // Only look as far as the nearest hit so far
+        struct SceneHit* hit = &hits[first + cast];
+        local_cast->max_dist = hit->hit ? hit->dist : world_cast->max_dist;
+      }
 
-  v1[0] = geometry->vertices[geometry->indices[index * 3 + 1] * geometry->floats_per_vertex + 0];
-  v1[1] = geometry->vertices[geometry->indices[index * 3 + 1] * geometry->floats_per_vertex + 1];
-  v1[2] = geometry->vertices[geometry->indices[index * 3 + 1] * geometry->floats_per_vertex + 2];
+      cast_scene(mover->collision_mesh, mover->bvh, local_casts, local_hits, batch_count);
 
-  v2[0] = geometry->vertices[geometry->indices[index * 3 + 2] * geometry->floats_per_vertex + 0];
-  v2[1] = geometry->vertices[geometry->indices[index * 3 + 2] * geometry->floats_per_vertex + 1];
-  v2[2] = geometry->vertices[geometry->indices[index * 3 + 2] * geometry->floats_per_vertex + 2];
+      for (uint32_t cast = 0; cast < batch_count; ++cast)
+      {
+        const struct SceneHit* local_hit = &local_hits[cast];
+        struct SceneHit* hit = &hits[first + cast];
+        if (local_hit->hit && (!hit->hit || local_hit->dist < hit->dist))
+        {
+          hit->hit = true;
+          hit->dist = local_hit->dist;
+          glm_mat4_mulv3((vec4*)mover->transform, (float*)local_hit->normal, 0.0f, hit->normal);
+        }
+      }
+    }
+  }
+}
+
+uint32_t get_mover_count()
+{
+  return mover_count;
+}
+
+const struct Mover* get_mover(uint32_t index)
+{
+  return movers[index];
+}
+
+void get_level_bounds(vec3 min, vec3 max)
+{
+  if (bvh->primitive_count == 0)
+  {
+    glm_vec3_zero(min);
+    glm_vec3_zero(max);
+    return;
+  }
 
-  n[0] = geometry->vertices[geometry->indices[index * 3 + 0] * geometry->floats_per_vertex + 3];
-  n[1] = geometry->vertices[geometry->indices[index * 3 + 0] * geometry->floats_per_vertex + 4];
-  n[2] = geometry->vertices[geometry->indices[index * 3 + 0] * geometry->floats_per_vertex + 5];
+  glm_vec3_copy(bvh->nodes[0].min, min);
+  glm_vec3_copy(bvh->nodes[0].max, max);
 }
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "assets.h"
+#include "collision.h"
+#include "cooked_mesh.h"
+
 #include <cglm/types.h>
 
 #include <glad/gl.h>
@@ -7,9 +11,66 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-bool generate_level();
+struct Mover;
+struct SceneCast;
+struct SceneHit;
+struct Sdf;
+
+enum CollisionBackend
+{
+  COLLISION_BACKEND_TRIANGLES, // Exact tests against the level triangles
+  COLLISION_BACKEND_SDF        // Approximate tests against a baked signed distance field
+};
+
+// How the level and its movers are cooked, cooked meshes with other options are cooked again
+// Float vertices without optimization by default, has to be set before the level is generated or cooked
+void set_level_cook_options(const struct CookOptions* options);
+
+// Loads the level in the background, see assets.h, so that only its shaders are ready when this returns
+bool generate_level(enum CollisionBackend collision_backend);
 void destroy_level();
-void draw_level(mat4 viewproj_matrix);
 
+// The level can be simulated and drawn once it is ready, its texture may still arrive after that
+enum AssetState get_level_state();
+
+// Loads only what the level needs for collision, without an OpenGL context, instead of generate_level
+bool generate_level_collision(enum CollisionBackend collision_backend);
+void destroy_level_collision();
+
+// Cooks the meshes and the texture of the level offline, see cooked_mesh.h and cooked_texture.h, they are otherwise
+// cooked on demand when they are loaded
+bool cook_level();
+
+// Moves the movers of the level ahead by delta_time seconds
+void update_level(float delta_time);
+
+// Submits the level to the render queue, see render_queue.h, with the movers interpolated between their last two
+// updates, alpha is the fraction of the way in between
+// Chunks of the static level outside the view frustum of viewproj_matrix are left out
+// Only once the level is ready
+void draw_level(const mat4 viewproj_matrix, float alpha);
+
+// Returns the signed distance field of the level when using the SDF collision backend, NULL otherwise
+const struct Sdf* get_level_sdf();
+
+// Bounds of the static part of the level, without the movers
+void get_level_bounds(vec3 min, vec3 max);
+
+// The static part of the level, the movers are collided with separately in their own local space
 uint32_t get_triangle_count();
 void get_triangle(uint32_t index, vec3 v0, vec3 v1, vec3 v2, vec3 n);
+
+// Fills the first count (at most COLLISION_BATCH_SIZE) lanes of a batch with the given triangles
+void get_triangle_batch(const uint32_t* triangles, uint32_t count, struct TriangleBatch* batch);
+
+// Writes the indices of all triangles that potentially overlap the given box into triangles (up to capacity)
+// Returns the total number of candidate triangles, which can be larger than capacity
+uint32_t query_level_triangles(const vec3 min, const vec3 max, uint32_t* triangles, uint32_t capacity);
+
+// Finds the nearest level hit for each of a batch of rays and sphere casts, see scene_query.h, including the movers
+// The static part is cast against the signed distance field when using the SDF collision backend
+void cast_level(const struct SceneCast* casts, struct SceneHit* hits, uint32_t count);
+
+// Parts of the level that move, see mover.h
+uint32_t get_mover_count();
+const struct Mover* get_mover(uint32_t index);
@@ -1,30 +1,168 @@
 // #include "arrow.h"
+#include "assets.h"
 #include "camera.h"
+#include "collision.h"
+#include "debug_draw.h"
+#include "headless.h"
 #include "input.h"
+#include "jobs.h"
 #include "level.h"
 #include "player.h"
+#include "profiler.h"
+#include "render_queue.h"
+#include "shader.h"
 #include "window.h"
 
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_TICK_RATE 120.0 // Simulation ticks per second
+#define MAX_TICKS_PER_FRAME 8
+#define DEFAULT_HEADLESS_TICKS 1000
+#define ASSET_UPLOAD_BUDGET 2000000 // Nanoseconds per frame spent uploading assets that have been loaded
+#define SHADER_WATCH_INTERVAL 0.5   // Seconds between checks for changed shaders
 
 static mat4 viewproj_matrix;
 
 int main(int argc, char* argv[])
 {
+  // Parse the command line
+  enum CollisionBackend collision_backend = COLLISION_BACKEND_TRIANGLES;
+  const char* trace_path = NULL;
+  double tick_rate = DEFAULT_TICK_RATE;
+  uint32_t headless_agent_count = 0; // Zero runs with a window
+  uint32_t headless_tick_count = DEFAULT_HEADLESS_TICKS;
+  bool cook = false;
+  bool watch_shaders = false;
+  struct CookOptions cook_options = { VERTEX_FORMAT_FLOAT, false, false, 0.0f };
+  for (int arg = 1; arg < argc; ++arg)
+  {
+    if (strcmp(argv[arg], "--sdf") == 0)
+    {
+      collision_backend = COLLISION_BACKEND_SDF;
+    }
+    else if (strcmp(argv[arg], "--trace") == 0 && arg + 1 < argc)
+    {
+      trace_path = argv[++arg];
+    }
+    else if (strcmp(argv[arg], "--tick-rate") == 0 && arg + 1 < argc && atof(argv[arg + 1]) > 0.0)
+    {
+      tick_rate = atof(argv[++arg]);
+    }
+    else if (strcmp(argv[arg], "--headless") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) > 0)
+    {
+      headless_agent_count = (uint32_t)atoi(argv[++arg]);
+    }
+    else if (strcmp(argv[arg], "--ticks") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) > 0)
+    {
+      headless_tick_count = (uint32_t)atoi(argv[++arg]);
+    }
+    else if (strcmp(argv[arg], "--cook") == 0)
+    {
+      cook = true;
+    }
+    else if (strcmp(argv[arg], "--packed-vertices") == 0)
+    {
+      cook_options.vertex_format = VERTEX_FORMAT_PACKED;
+    }
+    else if (strcmp(argv[arg], "--optimize-meshes") == 0)
+    {
+      cook_options.optimize = true;
+    }
+    else if (strcmp(argv[arg], "--mesh-lods") == 0)
+    {
+      cook_options.lods = true;
+    }
+    else if (strcmp(argv[arg], "--watch-shaders") == 0)
+    {
+      watch_shaders = true;
+    }
+    else
+    {
+      printf("Unknown argument \"%s\"\n"
+             "Usage: %s [--sdf] [--trace <file>] [--tick-rate <hz>] [--headless <agents> [--ticks <count>]] [--cook] "
+             "[--packed-vertices] [--optimize-meshes] [--mesh-lods] [--watch-shaders]\n",
+             argv[arg], argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  init_batch_collision();
+
+  if (!init_jobs())
+  {
+    return EXIT_FAILURE;
+  }
+
+  set_level_cook_options(&cook_options);
+
+  // Only cook the level for the following starts, without running anything
+  if (cook)
+  {
+    const bool success = cook_level();
+    destroy_jobs();
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // Only simulate, without a window, OpenGL or the player
+  if (headless_agent_count > 0)
+  {
+    if (!init_profiler(false))
+    {
+      return EXIT_FAILURE;
+    }
+
+    const bool success = run_headless(collision_backend, headless_agent_count, headless_tick_count, tick_rate);
+
+    print_profiler_summary();
+    if (trace_path)
+    {
+      write_profiler_trace(trace_path);
+    }
+    destroy_profiler();
+
+    destroy_jobs();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
   if (!generate_window())
   {
     return EXIT_FAILURE;
   }
 
+  if (!init_profiler(true))
+  {
+    return EXIT_FAILURE;
+  }
+
   init_input();
 
+  if (!init_assets())
+  {
+    return EXIT_FAILURE;
+  }
+
+  if (!generate_render_queue())
+  {
+    return EXIT_FAILURE;
+  }
+
+  if (!generate_debug_draw())
+  {
+    return EXIT_FAILURE;
+  }
+
   if (!generate_player())
   {
     return EXIT_FAILURE;
   }
 
-  if (!generate_level())
+  if (!generate_level(collision_backend))
   {
     return EXIT_FAILURE;
   }
@@ -32,7 +170,11 @@ int main(int argc, char* argv[])
   // generate_arrow();
 
   // Main loop
+  const double tick_time = 1.0 / tick_rate;
+  double unsimulated_time = 0.0;
   double time = get_time();
+  double shader_watch_time = time;
+  bool level_ready = false, level_failed = false; // Frames are drawn while the level is loading, but not simulated
   while (!should_window_close())
   {
     if (is_key_down(KEY_ESC))
@@ -40,48 +182,132 @@ int main(int argc, char* argv[])
       request_window_close();
     }
 
-    // Update
+    // Pick up shaders that have been edited while running
+    if (watch_shaders && get_time() - shader_watch_time >= SHADER_WATCH_INTERVAL)
     {
-      // Calculate delta time
-      float delta_time;
+      reload_changed_shader_programs();
+      shader_watch_time = get_time();
+    }
+
+    // Upload what the loader threads have finished since the last frame
+    begin_cpu_zone(PROFILE_ZONE_UPLOAD_ASSETS);
+    update_assets(ASSET_UPLOAD_BUDGET);
+    end_cpu_zone(PROFILE_ZONE_UPLOAD_ASSETS);
+
+    if (!level_ready)
+    {
+      const enum AssetState level_state = get_level_state();
+      if (level_state == ASSET_STATE_FAILED)
       {
-        const double now = get_time();
-        delta_time = (float)(now - time);
-        time = now;
+        level_failed = true;
+        break;
+      }
 
-        const float dt = delta_time * 1000.0f;
-        printf("%.0f fps (%.2f ms)\n", 1000.0f / dt, dt);
+      level_ready = level_state == ASSET_STATE_READY;
+      if (level_ready)
+      {
+        // Place the camera before the first tick, so that there is something to render, and start the clock now
+        update_camera((vec2){ 0.0f, 0.0f }, 0.0f, *get_player_transform(), get_player_height());
+        time = get_time();
       }
+    }
 
-      // Get cursor input
-      vec2 cursor_delta;
-      get_cursor_delta(cursor_delta);
+    // Update the simulation in fixed ticks, as many as have become due since the last frame
+    {
+      const double now = get_time();
+      unsimulated_time += now - time;
+      time = now;
+
+      uint32_t tick_count = 0;
+      while (level_ready && unsimulated_time >= tick_time && tick_count < MAX_TICKS_PER_FRAME)
+      {
+        begin_cpu_zone(PROFILE_ZONE_UPDATE);
+
+        // Input accumulates until it is read, so frames without a tick do not lose any
+        vec2 cursor_delta;
+        get_cursor_delta(cursor_delta);
+
+        const float scroll_delta = get_scroll_delta();
+
+        update_level((float)tick_time);
+        update_player(cursor_delta, (float)tick_time);
 
-      // Get scroll input
-      const float scroll_delta = get_scroll_delta();
+        mat4* player_transform = get_player_transform();
+        const float player_height = get_player_height();
+        update_camera(cursor_delta, scroll_delta, *player_transform, player_height);
 
-      update_player(cursor_delta, delta_time);
+        end_cpu_zone(PROFILE_ZONE_UPDATE);
 
-      mat4* player_transform = get_player_transform();
-      const float player_height = get_player_height();
-      update_camera(cursor_delta, scroll_delta, *player_transform, player_height, viewproj_matrix);
+        unsimulated_time -= tick_time;
+        ++tick_count;
+      }
+
+      // Too far behind to catch up (after a breakpoint or a long stall), so drop the time instead of spiraling
+      if (unsimulated_time >= tick_time)
+      {
+        unsimulated_time = fmod(unsimulated_time, tick_time);
+      }
     }
 
-    // Render
+    // Render, in between the last two ticks
     {
+      const float alpha = (float)(unsimulated_time / tick_time);
+      get_camera_viewproj(alpha, viewproj_matrix);
+      begin_render_queue(viewproj_matrix);
+
       clear_window();
 
-      draw_level(viewproj_matrix);
-      draw_player(viewproj_matrix);
+      if (level_ready)
+      {
+        // Only submitted here, and drawn along with everything else in the queue
+        begin_cpu_zone(PROFILE_ZONE_DRAW_LEVEL);
+        draw_level(viewproj_matrix, alpha);
+        end_cpu_zone(PROFILE_ZONE_DRAW_LEVEL);
+
+        begin_cpu_zone(PROFILE_ZONE_DRAW_QUEUE);
+        begin_gpu_zone(PROFILE_ZONE_DRAW_QUEUE);
+        flush_render_queue();
+        end_gpu_zone(PROFILE_ZONE_DRAW_QUEUE);
+        end_cpu_zone(PROFILE_ZONE_DRAW_QUEUE);
+
+        // Only queued here, the GPU time is in that of the debug draw below
+        begin_cpu_zone(PROFILE_ZONE_DRAW_PLAYER);
+        draw_player(alpha);
+        end_cpu_zone(PROFILE_ZONE_DRAW_PLAYER);
+      }
+
+      // Everything queued for debug drawing during the frame, in a handful of draw calls
+      begin_cpu_zone(PROFILE_ZONE_DRAW_DEBUG);
+      begin_gpu_zone(PROFILE_ZONE_DRAW_DEBUG);
+      flush_debug_draw();
+      end_gpu_zone(PROFILE_ZONE_DRAW_DEBUG);
+      end_cpu_zone(PROFILE_ZONE_DRAW_DEBUG);
 
+      begin_cpu_zone(PROFILE_ZONE_SWAP);
       refresh_window();
+      end_cpu_zone(PROFILE_ZONE_SWAP);
+
+      end_profiler_frame();
     }
   }
 
+  print_profiler_summary();
+  if (trace_path)
+  {
+    write_profiler_trace(trace_path);
+  }
+  destroy_profiler();
+
   destroy_level();
   destroy_player();
+  destroy_debug_draw();
+  destroy_render_queue();
+
+  destroy_assets();
 
   destroy_window();
 
-  return EXIT_SUCCESS;
+  destroy_jobs();
+
+  return level_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,176 @@
+#include "mapped_file.h"
+
+#include <stdio.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+#define MAX_FILENAME_LENGTH 260 // Of the temporary files written next to others
+
+#ifdef _WIN32
+bool map_file(const char* filename, struct MappedFile* file)
+{
+  HANDLE handle =
+    CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (handle == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  // Empty files can not be mapped
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+  {
+    CloseHandle(handle);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(handle); // The mapping keeps the file open
+  if (!mapping)
+  {
+    printf("Failed to map file \"%s\"\n", filename);
+    return false;
+  }
+
+  const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!data)
+  {
+    printf("Failed to map file \"%s\"\n", filename);
+    CloseHandle(mapping);
+    return false;
+  }
+
+  file->data = data;
+  file->size = (size_t)size.QuadPart;
+  file->mapping = mapping;
+  return true;
+}
+
+void unmap_file(struct MappedFile* file)
+{
+  UnmapViewOfFile(file->data);
+  CloseHandle(file->mapping);
+}
+
+bool get_file_stamp(const char* filename, uint64_t* size, int64_t* modified_time)
+{
+  // In steps of 100 nanoseconds, unlike the whole seconds of _stat64
+  WIN32_FILE_ATTRIBUTE_DATA info;
+  if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &info))
+  {
+    return false;
+  }
+
+  *size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+  *modified_time =
+    (int64_t)(((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+  return true;
+}
+
+static bool replace_file(const char* filename, const char* new_filename)
+{
+  return MoveFileExA(new_filename, filename, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+#else
+bool map_file(const char* filename, struct MappedFile* file)
+{
+  const int descriptor = open(filename, O_RDONLY);
+  if (descriptor < 0)
+  {
+    return false;
+  }
+
+  // Empty files can not be mapped
+  struct stat info;
+  if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+  {
+    close(descriptor);
+    return false;
+  }
+
+  void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  close(descriptor); // The mapping keeps the file open
+  if (data == MAP_FAILED)
+  {
+    printf("Failed to map file \"%s\"\n", filename);
+    return false;
+  }
+
+  file->data = data;
+  file->size = (size_t)info.st_size;
+  return true;
+}
+
+void unmap_file(struct MappedFile* file)
+{
+  munmap((void*)file->data, file->size);
+}
+
+bool get_file_stamp(const char* filename, uint64_t* size, int64_t* modified_time)
+{
+  struct stat info;
+  if (stat(filename, &info) != 0)
+  {
+    return false;
+  }
+
+  *size = (uint64_t)info.st_size;
+#ifdef __APPLE__
+  *modified_time = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+  *modified_time = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+static bool replace_file(const char* filename, const char* new_filename)
+{
+  return rename(new_filename, filename) == 0;
+}
+#endif
+
+bool write_file(const char* filename, const void* data, size_t size)
+{
+  char temporary_filename[MAX_FILENAME_LENGTH];
+  const int length = snprintf(temporary_filename, MAX_FILENAME_LENGTH, "%s.tmp", filename);
+  if (length < 0 || length >= MAX_FILENAME_LENGTH)
+  {
+    printf("Filename \"%s\" is too long to write\n", filename);
+    return false;
+  }
+
+  FILE* file = fopen(temporary_filename, "wb");
+  if (!file)
+  {
+    printf("Failed to open \"%s\" for writing\n", temporary_filename);
+    return false;
+  }
+
+  // Flushed and closed before the rename, so that the file only ever appears in full
+  const bool written = fwrite(data, 1, size, file) == size && fflush(file) == 0;
+  if (fclose(file) != 0 || !written)
+  {
+    printf("Failed to write \"%s\"\n", temporary_filename);
+    remove(temporary_filename);
+    return false;
+  }
+
+  if (!replace_file(filename, temporary_filename))
+  {
+    printf("Failed to replace \"%s\"\n", filename);
+    remove(temporary_filename);
+    return false;
+  }
+
+  return true;
+}
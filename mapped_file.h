@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A whole file mapped read-only into memory, pages are only read from disk once they are touched
+struct MappedFile
+{
+  const void* data;
+  size_t size;
+#ifdef _WIN32
+  void* mapping; // Stand-in for the HANDLE of the file mapping, so that windows.h stays out of this header
+#endif
+};
+
+bool map_file(const char* filename, struct MappedFile* file);
+void unmap_file(struct MappedFile* file);
+
+// Size and last modification time of a file, without opening it, returns false if it does not exist
+// The time is as precise as the file system keeps it, far below a second, and only meant to be compared
+bool get_file_stamp(const char* filename, uint64_t* size, int64_t* modified_time);
+
+// Writes a temporary file next to filename and renames it over filename, so that the file is never seen half written
+// and mappings of the old file stay intact
+bool write_file(const char* filename, const void* data, size_t size);
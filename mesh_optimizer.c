@@ -0,0 +1,496 @@
+#include "mesh_optimizer.h"
+
+#include "geometry_data.h"
+
+#include <cglm/vec3.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_VERTEX UINT32_MAX
+
+// A cluster whose misses per triangle drop below this factor of those of the whole mesh is cut off, smaller clusters
+// can be sorted more freely for overdraw but cost some vertex cache efficiency at every cut
+#define CLUSTER_ACMR_THRESHOLD 1.05f
+
+struct Cluster
+{
+  uint32_t first_triangle, triangle_count;
+  float score; // Higher is drawn earlier
+};
+
+// Simulates a FIFO cache with a time stamp per vertex, the cache is empty again after advancing time past its size
+static bool is_cache_miss(uint32_t* cache_times, uint32_t* time, uint32_t vertex)
+{
+  if (*time - cache_times[vertex] > VERTEX_CACHE_SIZE)
+  {
+    cache_times[vertex] = (*time)++;
+    return true;
+  }
+
+  return false;
+}
+
+// Returns the number of cache misses, and the number of distinct vertices the triangles reference
+static uint32_t count_cache_misses(const uint32_t* indices,
+                                   uint32_t index_count,
+                                   uint32_t vertex_count,
+                                   uint32_t* referenced_count)
+{
+  uint32_t* cache_times = calloc(vertex_count > 0 ? vertex_count : 1, sizeof(uint32_t));
+  if (!cache_times)
+  {
+    *referenced_count = 0;
+    return 0;
+  }
+
+  uint32_t misses = 0, referenced = 0, time = VERTEX_CACHE_SIZE + 1;
+  for (uint32_t index = 0; index < index_count; ++index)
+  {
+    const uint32_t vertex = indices[index];
+    referenced += cache_times[vertex] == 0; // Time stamps start past zero, so only vertices seen before are set
+    misses += is_cache_miss(cache_times, &time, vertex);
+  }
+
+  free(cache_times);
+
+  *referenced_count = referenced;
+  return misses;
+}
+
+struct VertexCacheStats analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count)
+{
+  uint32_t referenced_count;
+  const uint32_t misses = count_cache_misses(indices, index_count, vertex_count, &referenced_count);
+
+  struct VertexCacheStats stats;
+  stats.acmr = index_count >= 3 ? (float)misses / (float)(index_count / 3) : 0.0f;
+  stats.atvr = referenced_count > 0 ? (float)misses / (float)referenced_count : 0.0f;
+  return stats;
+}
+
+// Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", SIGGRAPH 2007
+// Fans around one vertex at a time, emitting all its remaining triangles, then moves on to a vertex of those triangles
+// that is still in the cache and has few triangles left, or back to the most recent one with any left at a dead end
+bool optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count)
+{
+  const uint32_t triangle_count = index_count / 3;
+  if (triangle_count == 0)
+  {
+    return true;
+  }
+
+  uint32_t* live_counts = calloc(vertex_count, sizeof(uint32_t)); // Triangles of each vertex that are not emitted yet
+  uint32_t* adjacency_starts = malloc(sizeof(uint32_t) * (vertex_count + 1));
+  uint32_t* adjacency = malloc(sizeof(uint32_t) * index_count); // Triangles of each vertex
+  uint32_t* cache_times = calloc(vertex_count, sizeof(uint32_t));
+  uint32_t* dead_ends = malloc(sizeof(uint32_t) * index_count); // Stack of the vertices of the emitted triangles
+  uint32_t* output = malloc(sizeof(uint32_t) * index_count);
+  bool* emitted = calloc(triangle_count, sizeof(bool));
+  if (!live_counts || !adjacency_starts || !adjacency || !cache_times || !dead_ends || !output || !emitted)
+  {
+    printf("Ran out of memory while optimizing %u triangles for the vertex cache\n", triangle_count);
+    free(live_counts);
+    free(adjacency_starts);
+    free(adjacency);
+    free(cache_times);
+    free(dead_ends);
+    free(output);
+    free(emitted);
+    return false;
+  }
+
+  for (uint32_t index = 0; index < triangle_count * 3; ++index)
+  {
+    ++live_counts[indices[index]];
+  }
+
+  adjacency_starts[0] = 0;
+  for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+  {
+    adjacency_starts[vertex + 1] = adjacency_starts[vertex] + live_counts[vertex];
+  }
+
+  // Fill with the cache times as the write cursors, they are reset afterwards
+  for (uint32_t index = 0; index < triangle_count * 3; ++index)
+  {
+    const uint32_t vertex = indices[index];
+    adjacency[adjacency_starts[vertex] + cache_times[vertex]++] = index / 3;
+  }
+
+  memset(cache_times, 0, sizeof(uint32_t) * vertex_count);
+
+  uint32_t time = VERTEX_CACHE_SIZE + 1, dead_end_count = 0, output_count = 0, cursor = 0;
+  uint32_t fanning = indices[0];
+  while (fanning != NO_VERTEX)
+  {
+    // The vertices of the triangles emitted now are the candidates for the next fanning vertex
+    const uint32_t first_candidate = dead_end_count;
+    for (uint32_t adjacent = adjacency_starts[fanning]; adjacent < adjacency_starts[fanning + 1]; ++adjacent)
+    {
+      const uint32_t triangle = adjacency[adjacent];
+      if (emitted[triangle])
+      {
+        continue;
+      }
+
+      for (uint32_t corner = 0; corner < 3; ++corner)
+      {
+        const uint32_t vertex = indices[triangle * 3 + corner];
+        dead_ends[dead_end_count++] = vertex;
+        --live_counts[vertex];
+        is_cache_miss(cache_times, &time, vertex);
+        output[output_count++] = vertex;
+      }
+
+      emitted[triangle] = true;
+    }
+
+    // Prefer the candidate that has been in the cache the longest but will still be in it after emitting its fan
+    uint32_t next = NO_VERTEX;
+    int64_t best_priority = -1;
+    for (uint32_t candidate = first_candidate; candidate < dead_end_count; ++candidate)
+    {
+      const uint32_t vertex = dead_ends[candidate];
+      if (live_counts[vertex] == 0)
+      {
+        continue;
+      }
+
+      int64_t priority = 0;
+      const uint32_t age = time - cache_times[vertex];
+      if (age + 2 * live_counts[vertex] <= VERTEX_CACHE_SIZE)
+      {
+        priority = age;
+      }
+
+      if (priority > best_priority)
+      {
+        best_priority = priority;
+        next = vertex;
+      }
+    }
+
+    // At a dead end, go back to the most recently used vertex that still has triangles, or any vertex that has
+    while (next == NO_VERTEX && dead_end_count > 0)
+    {
+      const uint32_t vertex = dead_ends[--dead_end_count];
+      if (live_counts[vertex] > 0)
+      {
+        next = vertex;
+      }
+    }
+
+    while (next == NO_VERTEX && cursor < vertex_count)
+    {
+      if (live_counts[cursor] > 0)
+      {
+        next = cursor;
+      }
+      ++cursor;
+    }
+
+    fanning = next;
+  }
+
+  memcpy(indices, output, sizeof(uint32_t) * triangle_count * 3);
+
+  free(live_counts);
+  free(adjacency_starts);
+  free(adjacency);
+  free(cache_times);
+  free(dead_ends);
+  free(output);
+  free(emitted);
+  return true;
+}
+
+// Splits the triangles where the cache has to start over anyway, which is at triangles whose vertices all miss, and
+// within those runs wherever the misses so far are low enough to afford a cold cache for the next cluster
+// Returns the number of clusters
+static uint32_t find_clusters(const uint32_t* indices,
+                              uint32_t triangle_count,
+                              uint32_t vertex_count,
+                              float mesh_acmr,
+                              struct Cluster* clusters)
+{
+  uint32_t* cache_times = calloc(vertex_count, sizeof(uint32_t));
+  if (!cache_times)
+  {
+    clusters[0].first_triangle = 0;
+    return 1;
+  }
+
+  uint32_t cluster_count = 0, cluster_misses = 0, cluster_start = 0, time = VERTEX_CACHE_SIZE + 1;
+  for (uint32_t triangle = 0; triangle < triangle_count; ++triangle)
+  {
+    uint32_t misses = 0;
+    for (uint32_t corner = 0; corner < 3; ++corner)
+    {
+      misses += is_cache_miss(cache_times, &time, indices[triangle * 3 + corner]);
+    }
+
+    // A triangle right after a cut misses all three as well, but already starts the cluster that the cut opened
+    if (triangle == 0 || (misses == 3 && cluster_start != triangle))
+    {
+      clusters[cluster_count++].first_triangle = triangle;
+      cluster_start = triangle;
+      cluster_misses = 0;
+    }
+
+    cluster_misses += misses;
+
+    const uint32_t cluster_triangles = triangle - cluster_start + 1;
+    const float threshold = mesh_acmr * CLUSTER_ACMR_THRESHOLD * (float)cluster_triangles;
+    if (triangle + 1 < triangle_count && (float)cluster_misses <= threshold)
+    {
+      clusters[cluster_count++].first_triangle = triangle + 1;
+      cluster_start = triangle + 1;
+      cluster_misses = 0;
+      time += VERTEX_CACHE_SIZE + 1; // Like a new cluster would find it after any other
+    }
+  }
+
+  free(cache_times);
+  return cluster_count;
+}
+
+static int compare_clusters(const void* a, const void* b)
+{
+  const struct Cluster* cluster_a = a;
+  const struct Cluster* cluster_b = b;
+  if (cluster_a->score != cluster_b->score)
+  {
+    return cluster_a->score > cluster_b->score ? -1 : 1;
+  }
+
+  return cluster_a->first_triangle < cluster_b->first_triangle ? -1 : 1;
+}
+
+static float get_triangle_area(const float* vertices, uint32_t floats_per_vertex, const uint32_t* triangle, vec3 normal)
+{
+  vec3 edge_a, edge_b;
+  glm_vec3_sub((float*)&vertices[triangle[1] * floats_per_vertex], (float*)&vertices[triangle[0] * floats_per_vertex],
+               edge_a);
+  glm_vec3_sub((float*)&vertices[triangle[2] * floats_per_vertex], (float*)&vertices[triangle[0] * floats_per_vertex],
+               edge_b);
+  glm_vec3_cross(edge_a, edge_b, normal); // Twice the area long
+  return glm_vec3_norm(normal) * 0.5f;
+}
+
+// Adds the centroid of the triangle weighted by its area, returns the area
+static float add_triangle(const float* vertices,
+                          uint32_t floats_per_vertex,
+                          const uint32_t* triangle,
+                          vec3 centroid,
+                          vec3 normal)
+{
+  vec3 triangle_normal;
+  const float area = get_triangle_area(vertices, floats_per_vertex, triangle, triangle_normal);
+  for (uint32_t corner = 0; corner < 3; ++corner)
+  {
+    glm_vec3_muladds((float*)&vertices[triangle[corner] * floats_per_vertex], area / 3.0f, centroid);
+  }
+
+  glm_vec3_add(normal, triangle_normal, normal);
+  return area;
+}
+
+bool optimize_overdraw(uint32_t* indices,
+                       uint32_t index_count,
+                       const float* vertices,
+                       uint32_t floats_per_vertex,
+                       uint32_t vertex_count)
+{
+  const uint32_t triangle_count = index_count / 3;
+  if (triangle_count == 0)
+  {
+    return true;
+  }
+
+  struct Cluster* clusters = malloc(sizeof(struct Cluster) * triangle_count);
+  uint32_t* output = malloc(sizeof(uint32_t) * index_count);
+  if (!clusters || !output)
+  {
+    printf("Ran out of memory while optimizing %u triangles for overdraw\n", triangle_count);
+    free(clusters);
+    free(output);
+    return false;
+  }
+
+  const float mesh_acmr = analyze_vertex_cache(indices, index_count, vertex_count).acmr;
+  const uint32_t cluster_count = find_clusters(indices, triangle_count, vertex_count, mesh_acmr, clusters);
+
+  // Clusters far out along their own normal from the center of the mesh are more likely to be in front of others
+  vec3 mesh_centroid = GLM_VEC3_ZERO_INIT, mesh_normal = GLM_VEC3_ZERO_INIT; // Only the centroid is needed
+  float mesh_area = 0.0f;
+  for (uint32_t triangle = 0; triangle < triangle_count; ++triangle)
+  {
+    mesh_area += add_triangle(vertices, floats_per_vertex, &indices[triangle * 3], mesh_centroid, mesh_normal);
+  }
+
+  if (mesh_area > 0.0f)
+  {
+    glm_vec3_scale(mesh_centroid, 1.0f / mesh_area, mesh_centroid);
+  }
+
+  for (uint32_t cluster = 0; cluster < cluster_count; ++cluster)
+  {
+    const uint32_t end = cluster + 1 < cluster_count ? clusters[cluster + 1].first_triangle : triangle_count;
+    clusters[cluster].triangle_count = end - clusters[cluster].first_triangle;
+
+    vec3 centroid = GLM_VEC3_ZERO_INIT, normal = GLM_VEC3_ZERO_INIT;
+    float area = 0.0f;
+    for (uint32_t triangle = clusters[cluster].first_triangle; triangle < end; ++triangle)
+    {
+      area += add_triangle(vertices, floats_per_vertex, &indices[triangle * 3], centroid, normal);
+    }
+
+    clusters[cluster].score = 0.0f;
+    if (area > 0.0f)
+    {
+      glm_vec3_scale(centroid, 1.0f / area, centroid);
+      glm_vec3_sub(centroid, mesh_centroid, centroid);
+      glm_vec3_normalize(normal);
+      clusters[cluster].score = glm_vec3_dot(centroid, normal);
+    }
+  }
+
+  qsort(clusters, cluster_count, sizeof(struct Cluster), compare_clusters);
+
+  uint32_t output_count = 0;
+  for (uint32_t cluster = 0; cluster < cluster_count; ++cluster)
+  {
+    const uint32_t count = clusters[cluster].triangle_count * 3;
+    memcpy(&output[output_count], &indices[clusters[cluster].first_triangle * 3], sizeof(uint32_t) * count);
+    output_count += count;
+  }
+
+  memcpy(indices, output, sizeof(uint32_t) * triangle_count * 3);
+
+  free(clusters);
+  free(output);
+  return true;
+}
+
+bool optimize_vertex_fetch(float* vertices,
+                           uint32_t floats_per_vertex,
+                           uint32_t vertex_count,
+                           uint32_t* indices,
+                           uint32_t index_count)
+{
+  uint32_t* remap = malloc(sizeof(uint32_t) * (vertex_count > 0 ? vertex_count : 1)); // New index of each old vertex
+  float* output = malloc(sizeof(float) * floats_per_vertex * (vertex_count > 0 ? vertex_count : 1));
+  if (!remap || !output)
+  {
+    printf("Ran out of memory while optimizing %u vertices for vertex fetch\n", vertex_count);
+    free(remap);
+    free(output);
+    return false;
+  }
+
+  memset(remap, 0xFF, sizeof(uint32_t) * vertex_count);
+
+  uint32_t next = 0;
+  for (uint32_t index = 0; index < index_count; ++index)
+  {
+    uint32_t* vertex = &remap[indices[index]];
+    if (*vertex == NO_VERTEX)
+    {
+      *vertex = next++;
+    }
+
+    indices[index] = *vertex;
+  }
+
+  // Vertices that no triangle uses are kept at the end, so that the vertex count does not change
+  for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+  {
+    if (remap[vertex] == NO_VERTEX)
+    {
+      remap[vertex] = next++;
+    }
+
+    memcpy(&output[remap[vertex] * floats_per_vertex], &vertices[vertex * floats_per_vertex],
+           sizeof(float) * floats_per_vertex);
+  }
+
+  memcpy(vertices, output, sizeof(float) * floats_per_vertex * vertex_count);
+
+  free(remap);
+  free(output);
+  return true;
+}
+
+bool optimize_geometry(struct Geometry* geometry, struct VertexCacheStats* before, struct VertexCacheStats* after)
+{
+  // Each submesh uses the vertices from its base vertex up to its highest index, which are only reordered when no
+  // other submesh uses any of them
+  bool disjoint = true;
+  uint32_t* vertex_counts = malloc(sizeof(uint32_t) * (geometry->submesh_count > 0 ? geometry->submesh_count : 1));
+  if (!vertex_counts)
+  {
+    printf("Ran out of memory while optimizing geometry with %u submeshes\n", geometry->submesh_count);
+    return false;
+  }
+
+  for (uint32_t index = 0; index < geometry->submesh_count; ++index)
+  {
+    const struct Submesh* submesh = &geometry->submeshes[index];
+
+    uint32_t vertex_count = 0;
+    for (uint32_t offset = 0; offset < submesh->index_count; ++offset)
+    {
+      const uint32_t vertex = geometry->indices[submesh->first_index + offset] + 1;
+      vertex_count = vertex > vertex_count ? vertex : vertex_count;
+    }
+
+    vertex_counts[index] = vertex_count;
+
+    const uint32_t next_base_vertex =
+      index + 1 < geometry->submesh_count ? geometry->submeshes[index + 1].base_vertex : geometry->vertex_count;
+    disjoint = disjoint && submesh->base_vertex + vertex_count <= next_base_vertex;
+  }
+
+  uint32_t triangles = 0, misses_before = 0, misses_after = 0, referenced = 0;
+  for (uint32_t index = 0; index < geometry->submesh_count; ++index)
+  {
+    const struct Submesh* submesh = &geometry->submeshes[index];
+    uint32_t* indices = &geometry->indices[submesh->first_index];
+    float* vertices = &geometry->vertices[submesh->base_vertex * geometry->floats_per_vertex];
+    const uint32_t vertex_count = vertex_counts[index];
+
+    uint32_t submesh_referenced;
+    misses_before += count_cache_misses(indices, submesh->index_count, vertex_count, &submesh_referenced);
+    referenced += submesh_referenced;
+
+    if (!optimize_vertex_cache(indices, submesh->index_count, vertex_count) ||
+        !optimize_overdraw(indices, submesh->index_count, vertices, geometry->floats_per_vertex, vertex_count) ||
+        (disjoint &&
+         !optimize_vertex_fetch(vertices, geometry->floats_per_vertex, vertex_count, indices, submesh->index_count)))
+    {
+      free(vertex_counts);
+      return false;
+    }
+
+    misses_after += count_cache_misses(indices, submesh->index_count, vertex_count, &submesh_referenced);
+    triangles += submesh->index_count / 3;
+  }
+
+  free(vertex_counts);
+
+  if (before)
+  {
+    before->acmr = triangles > 0 ? (float)misses_before / (float)triangles : 0.0f;
+    before->atvr = referenced > 0 ? (float)misses_before / (float)referenced : 0.0f;
+  }
+
+  if (after)
+  {
+    after->acmr = triangles > 0 ? (float)misses_after / (float)triangles : 0.0f;
+    after->atvr = referenced > 0 ? (float)misses_after / (float)referenced : 0.0f;
+  }
+
+  return true;
+}
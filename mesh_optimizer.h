@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define VERTEX_CACHE_SIZE 16 // Entries, about what the post-transform caches of recent GPUs hold for our vertices
+
+struct Geometry;
+
+// How well a triangle list uses a FIFO post-transform vertex cache of VERTEX_CACHE_SIZE entries
+struct VertexCacheStats
+{
+  float acmr; // Average cache miss ratio, vertices transformed per triangle, between 0.5 at best and 3
+  float atvr; // Average transformed vertex ratio, vertices transformed per vertex referenced, 1 at best
+};
+
+struct VertexCacheStats analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count);
+
+// Reorders the triangles so that consecutive triangles share vertices while they are still in the cache (Tipsify)
+bool optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count);
+
+// Splits triangles that were ordered by optimize_vertex_cache into clusters and draws the clusters that face away from
+// the center of the mesh first, as they are the most likely to occlude the rest from any view
+bool optimize_overdraw(uint32_t* indices,
+                       uint32_t index_count,
+                       const float* vertices,
+                       uint32_t floats_per_vertex,
+                       uint32_t vertex_count);
+
+// Renumbers the vertices in the order the triangles first use them, so that vertex fetches walk through memory
+bool optimize_vertex_fetch(float* vertices,
+                           uint32_t floats_per_vertex,
+                           uint32_t vertex_count,
+                           uint32_t* indices,
+                           uint32_t index_count);
+
+// Runs all of the above on each submesh of triangle geometry that is still in CPU memory
+// Fills the statistics of all submeshes combined from before and after, when they are not NULL
+bool optimize_geometry(struct Geometry* geometry, struct VertexCacheStats* before, struct VertexCacheStats* after);
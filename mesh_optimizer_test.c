@@ -0,0 +1,86 @@
+// Checks of the mesh optimizer that need its internals, which is why it is included rather than linked
+#include "mesh_optimizer.c"
+
+#define SOUP_TRIANGLE_COUNT 1000
+#define FLOATS_PER_VERTEX 3
+
+// Triangles that share no vertices, so that every one of them misses the cache in full
+static bool make_soup(uint32_t* indices, float* vertices)
+{
+  uint32_t seed = 1;
+  for (uint32_t index = 0; index < SOUP_TRIANGLE_COUNT * 3; ++index)
+  {
+    indices[index] = index;
+    for (uint32_t axis = 0; axis < FLOATS_PER_VERTEX; ++axis)
+    {
+      seed = seed * 1664525u + 1013904223u;
+      vertices[index * FLOATS_PER_VERTEX + axis] = (float)(seed >> 8) / (float)(1u << 24);
+    }
+  }
+
+  return optimize_vertex_cache(indices, SOUP_TRIANGLE_COUNT * 3, SOUP_TRIANGLE_COUNT * 3);
+}
+
+static bool test_soup_clusters(const uint32_t* indices)
+{
+  struct Cluster clusters[SOUP_TRIANGLE_COUNT];
+  const float mesh_acmr = analyze_vertex_cache(indices, SOUP_TRIANGLE_COUNT * 3, SOUP_TRIANGLE_COUNT * 3).acmr;
+  const uint32_t cluster_count =
+    find_clusters(indices, SOUP_TRIANGLE_COUNT, SOUP_TRIANGLE_COUNT * 3, mesh_acmr, clusters);
+  if (cluster_count == 0 || cluster_count > SOUP_TRIANGLE_COUNT)
+  {
+    printf("Found %u clusters in a soup of %u triangles\n", cluster_count, SOUP_TRIANGLE_COUNT);
+    return false;
+  }
+
+  // No cluster may be empty, which is what a triangle that starts a cluster twice leads to
+  for (uint32_t cluster = 1; cluster < cluster_count; ++cluster)
+  {
+    if (clusters[cluster].first_triangle <= clusters[cluster - 1].first_triangle)
+    {
+      printf("Cluster %u of a soup starts at triangle %u, after the one before it at %u\n", cluster,
+             clusters[cluster].first_triangle, clusters[cluster - 1].first_triangle);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool test_soup_overdraw(uint32_t* indices, const float* vertices)
+{
+  if (!optimize_overdraw(indices, SOUP_TRIANGLE_COUNT * 3, vertices, FLOATS_PER_VERTEX, SOUP_TRIANGLE_COUNT * 3))
+  {
+    return false;
+  }
+
+  // Only reordered, so every triangle is still there exactly once
+  bool seen[SOUP_TRIANGLE_COUNT] = { false };
+  for (uint32_t triangle = 0; triangle < SOUP_TRIANGLE_COUNT; ++triangle)
+  {
+    const uint32_t original = indices[triangle * 3] / 3;
+    if (seen[original])
+    {
+      printf("Triangle %u of a soup is there more than once after optimizing for overdraw\n", original);
+      return false;
+    }
+
+    seen[original] = true;
+  }
+
+  return true;
+}
+
+int main()
+{
+  static uint32_t indices[SOUP_TRIANGLE_COUNT * 3];
+  static float vertices[SOUP_TRIANGLE_COUNT * 3 * FLOATS_PER_VERTEX];
+  if (!make_soup(indices, vertices))
+  {
+    return EXIT_FAILURE;
+  }
+
+  const bool success = test_soup_clusters(indices) && test_soup_overdraw(indices, vertices);
+  printf("%s\n", success ? "All mesh optimizer tests passed" : "Mesh optimizer tests failed");
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,92 @@
+#include "mover.h"
+
+#include "bvh.h"
+#include "transform.h"
+
+#include <cglm/affine.h>
+#include <cglm/box.h>
+#include <cglm/vec3.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void set_mover_transform(struct Mover* mover)
+{
+  // Ease in and out at both ends of the path
+  const float progress = 0.5f - 0.5f * cosf(GLM_PIf * 2.0f * mover->time / mover->period);
+
+  vec3 position;
+  glm_vec3_copy(mover->origin, position);
+  glm_vec3_muladds(mover->travel, progress, position);
+
+  glm_translate_make(mover->transform, position);
+  glm_rotate_y(mover->transform, mover->angle, mover->transform);
+
+  glm_mat4_copy(mover->transform, mover->inverse_transform);
+  glm_inv_tr(mover->inverse_transform);
+
+  if (mover->bvh->node_count == 0)
+  {
+    glm_vec3_copy(position, mover->min);
+    glm_vec3_copy(position, mover->max);
+    return;
+  }
+
+  vec3 local_bounds[2], bounds[2];
+  glm_vec3_copy(mover->bvh->nodes[0].min, local_bounds[0]);
+  glm_vec3_copy(mover->bvh->nodes[0].max, local_bounds[1]);
+  glm_aabb_transform(local_bounds, mover->transform, bounds);
+  glm_vec3_copy(bounds[0], mover->min);
+  glm_vec3_copy(bounds[1], mover->max);
+}
+
+struct Mover* make_mover(struct CollisionMesh* collision_mesh,
+                         struct Bvh* bvh,
+                         const vec3 origin,
+                         const vec3 travel,
+                         float period,
+                         float spin)
+{
+  struct Mover* mover = malloc(sizeof(struct Mover));
+  if (!mover)
+  {
+    printf("Ran out of memory while making a mover\n");
+    return NULL;
+  }
+
+  mover->collision_mesh = collision_mesh;
+  mover->bvh = bvh;
+
+  glm_vec3_copy((float*)origin, mover->origin);
+  glm_vec3_copy((float*)travel, mover->travel);
+  mover->period = period;
+  mover->spin = spin;
+  mover->time = 0.0f;
+  mover->angle = 0.0f;
+
+  set_mover_transform(mover);
+  glm_mat4_copy(mover->transform, mover->previous_transform);
+
+  return mover;
+}
+
+void destroy_mover(struct Mover* mover)
+{
+  free(mover);
+}
+
+void update_mover(struct Mover* mover, float delta_time)
+{
+  glm_mat4_copy(mover->transform, mover->previous_transform);
+
+  // Wrap around after every round trip and turn, so that neither loses precision over time
+  mover->time = fmodf(mover->time + delta_time, mover->period);
+  mover->angle = fmodf(mover->angle + mover->spin * delta_time, GLM_PIf * 2.0f);
+  set_mover_transform(mover);
+}
+
+void get_mover_render_transform(const struct Mover* mover, float alpha, mat4 dest)
+{
+  interpolate_transform(mover->previous_transform, mover->transform, alpha, dest);
+}
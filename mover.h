@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cglm/types.h>
+
+#include <stdint.h>
+
+#define NO_MOVER UINT32_MAX
+
+struct Bvh;
+struct CollisionMesh;
+
+// A rigid part of the level that moves back and forth while spinning around its up axis, like a platform or a door
+// Its collision mesh and BVH stay in local space and are never rebuilt, queries are transformed into that space instead
+struct Mover
+{
+  struct CollisionMesh* collision_mesh;
+  struct Bvh* bvh;
+
+  vec3 origin, travel; // Moves from origin to origin + travel and back
+  float period;        // Seconds for a round trip
+  float spin;          // Radians per second around the up axis
+  float time;          // Into the current round trip
+  float angle;         // Around the up axis
+
+  mat4 transform, previous_transform; // Local to world space, only ever a rotation and a translation
+  mat4 inverse_transform;             // World to local space
+  vec3 min, max;                      // Bounds in world space
+};
+
+// The collision mesh and the BVH over it are only referenced, they have to outlive the mover
+struct Mover* make_mover(struct CollisionMesh* collision_mesh,
+                         struct Bvh* bvh,
+                         const vec3 origin,
+                         const vec3 travel,
+                         float period,
+                         float spin);
+void destroy_mover(struct Mover* mover);
+
+void update_mover(struct Mover* mover, float delta_time);
+
+// Where to draw the mover in between its last two updates, see interpolate_transform
+void get_mover_render_transform(const struct Mover* mover, float alpha, mat4 dest);
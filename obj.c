@@ -0,0 +1,854 @@
+#include "obj.h"
+
+#include "jobs.h"
+#include "mapped_file.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_SIZE (1 << 20) // Bytes of the file parsed by one job
+#define MAX_POLYGON_CORNERS 64
+#define MAX_MANTISSA_DIGITS 19 // Any more do not fit into the 64-bit mantissa, and would not change a float anyway
+#define VERTICES_PER_JOB 4096
+
+#define NO_ATTRIBUTE UINT32_MAX // For corners without a UV or normal
+
+#define DEFAULT_MATERIAL 0 // For faces before the first "usemtl", named materials count up from 1 in order of first use
+
+// The statements that are read, anything else is skipped
+enum Statement
+{
+  STATEMENT_OTHER,
+  STATEMENT_POSITION, // "v"
+  STATEMENT_UV,       // "vt"
+  STATEMENT_NORMAL,   // "vn"
+  STATEMENT_FACE,     // "f"
+  STATEMENT_GROUP,    // "o" or "g", starts a new submesh with the current material
+  STATEMENT_MATERIAL  // "usemtl", starts a new submesh with another material
+};
+
+struct Corner
+{
+  uint32_t position, uv, normal;
+};
+
+// Where a new submesh starts, resolved into the submeshes of the geometry once the whole file is parsed
+struct SubmeshStart
+{
+  uint32_t first_corner;
+  const char* material; // Name from a "usemtl" statement, NULL if the material carries over
+  uint32_t material_length;
+};
+
+// A range of whole lines, counted in the first pass and parsed in the second
+struct Chunk
+{
+  const char* begin;
+  const char* end;
+
+  uint32_t position_count, uv_count, normal_count, corner_count, submesh_start_count;
+
+  // Of the whole file, summed up in between the passes
+  uint32_t first_position, first_uv, first_normal, first_corner, first_submesh_start;
+
+  const char* error; // Set by the second pass if the chunk could not be parsed
+};
+
+struct Parse
+{
+  struct Chunk* chunks;
+  enum GeometryType type;
+
+  float* positions; // 3 floats each
+  float* uvs;       // 2 floats each
+  float* normals;   // 3 floats each
+  struct Corner* corners;
+  struct SubmeshStart* submesh_starts;
+
+  // For filling the welded vertices
+  const struct Corner* unique_corners;
+  struct Geometry* geometry;
+};
+
+static const double powers_of_ten[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+static bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+static const char* skip_spaces(const char* cursor, const char* end)
+{
+  while (cursor < end && is_space(*cursor))
+  {
+    ++cursor;
+  }
+
+  return cursor;
+}
+
+// Returns the end of the line that starts at cursor, excluding the newline
+static const char* find_line_end(const char* cursor, const char* end)
+{
+  const char* newline = memchr(cursor, '\n', (size_t)(end - cursor));
+  return newline ? newline : end;
+}
+
+static bool is_token(const char* start, size_t length, const char* token)
+{
+  return strlen(token) == length && memcmp(start, token, length) == 0;
+}
+
+// Returns which statement a line is, and moves cursor past its keyword
+static enum Statement read_statement(const char** cursor, const char* end)
+{
+  const char* start = skip_spaces(*cursor, end);
+  const char* stop = start;
+  while (stop < end && !is_space(*stop))
+  {
+    ++stop;
+  }
+
+  *cursor = stop;
+
+  const size_t length = (size_t)(stop - start);
+  if (length == 1)
+  {
+    switch (start[0])
+    {
+    case 'v':
+      return STATEMENT_POSITION;
+    case 'f':
+      return STATEMENT_FACE;
+    case 'o':
+    case 'g':
+      return STATEMENT_GROUP;
+    }
+  }
+  else if (is_token(start, length, "vt"))
+  {
+    return STATEMENT_UV;
+  }
+  else if (is_token(start, length, "vn"))
+  {
+    return STATEMENT_NORMAL;
+  }
+  else if (is_token(start, length, "usemtl"))
+  {
+    return STATEMENT_MATERIAL;
+  }
+
+  return STATEMENT_OTHER;
+}
+
+// Parses a decimal float without going through the locale-aware strtof, returns NULL if there is none at cursor
+static const char* parse_float(const char* cursor, const char* end, float* value)
+{
+  bool negative = false;
+  if (cursor < end && (*cursor == '-' || *cursor == '+'))
+  {
+    negative = *cursor == '-';
+    ++cursor;
+  }
+
+  uint64_t mantissa = 0;
+  int digit_count = 0, exponent = 0;
+  bool has_digits = false;
+
+  for (; cursor < end && is_digit(*cursor); ++cursor)
+  {
+    has_digits = true;
+    if (digit_count < MAX_MANTISSA_DIGITS)
+    {
+      mantissa = mantissa * 10 + (uint64_t)(*cursor - '0');
+      digit_count += mantissa > 0;
+    }
+    else
+    {
+      ++exponent;
+    }
+  }
+
+  if (cursor < end && *cursor == '.')
+  {
+    for (++cursor; cursor < end && is_digit(*cursor); ++cursor)
+    {
+      has_digits = true;
+      if (digit_count < MAX_MANTISSA_DIGITS)
+      {
+        mantissa = mantissa * 10 + (uint64_t)(*cursor - '0');
+        digit_count += mantissa > 0;
+        --exponent;
+      }
+    }
+  }
+
+  if (!has_digits)
+  {
+    return NULL;
+  }
+
+  if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+  {
+    ++cursor;
+
+    bool negative_exponent = false;
+    if (cursor < end && (*cursor == '-' || *cursor == '+'))
+    {
+      negative_exponent = *cursor == '-';
+      ++cursor;
+    }
+
+    int explicit_exponent = 0;
+    for (; cursor < end && is_digit(*cursor); ++cursor)
+    {
+      if (explicit_exponent < 1000)
+      {
+        explicit_exponent = explicit_exponent * 10 + (*cursor - '0');
+      }
+    }
+
+    exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+  }
+
+  // Powers of ten up to 22 are exact in a double, so are mantissas of up to 53 bits
+  double result = (double)mantissa;
+  if (exponent < 0 && exponent >= -22)
+  {
+    result /= powers_of_ten[-exponent];
+  }
+  else if (exponent > 0 && exponent <= 22)
+  {
+    result *= powers_of_ten[exponent];
+  }
+  else if (exponent != 0)
+  {
+    result *= pow(10.0, exponent);
+  }
+
+  *value = (float)(negative ? -result : result);
+  return cursor;
+}
+
+// Parses a 1-based or negative relative OBJ index into a 0-based one, given how many elements were read before
+static const char* parse_index(const char* cursor, const char* end, uint32_t preceding_count, uint32_t* index)
+{
+  bool negative = false;
+  if (cursor < end && *cursor == '-')
+  {
+    negative = true;
+    ++cursor;
+  }
+
+  int64_t value = 0;
+  const char* start = cursor;
+  for (; cursor < end && is_digit(*cursor) && value <= UINT32_MAX; ++cursor)
+  {
+    value = value * 10 + (*cursor - '0');
+  }
+
+  if (cursor == start || value == 0 || value > UINT32_MAX)
+  {
+    return NULL;
+  }
+
+  // Out of range indices are caught when the vertices are welded
+  if (negative)
+  {
+    *index = value <= preceding_count ? preceding_count - (uint32_t)value : NO_ATTRIBUTE - 1;
+  }
+  else
+  {
+    *index = (uint32_t)(value - 1);
+  }
+
+  return cursor;
+}
+
+// Returns how many corners a face line has, without parsing them
+static uint32_t count_face_corners(const char* cursor, const char* end)
+{
+  uint32_t count = 0;
+  while ((cursor = skip_spaces(cursor, end)) < end)
+  {
+    ++count;
+    while (cursor < end && !is_space(*cursor))
+    {
+      ++cursor;
+    }
+  }
+
+  return count;
+}
+
+// First pass, counts the elements of each kind in a chunk so that the second pass knows where to write them
+static void count_chunks(void* data, uint32_t begin, uint32_t end)
+{
+  struct Parse* parse = data;
+  for (uint32_t index = begin; index < end; ++index)
+  {
+    struct Chunk* chunk = &parse->chunks[index];
+    for (const char* line = chunk->begin; line < chunk->end;)
+    {
+      const char* line_end = find_line_end(line, chunk->end);
+
+      const char* cursor = line;
+      const enum Statement statement = read_statement(&cursor, line_end);
+      if (statement == STATEMENT_POSITION)
+      {
+        ++chunk->position_count;
+      }
+      else if (statement == STATEMENT_UV)
+      {
+        ++chunk->uv_count;
+      }
+      else if (statement == STATEMENT_NORMAL)
+      {
+        ++chunk->normal_count;
+      }
+      else if (statement == STATEMENT_GROUP || statement == STATEMENT_MATERIAL)
+      {
+        ++chunk->submesh_start_count;
+      }
+      else if (statement == STATEMENT_FACE)
+      {
+        const uint32_t corner_count = count_face_corners(cursor, line_end);
+        if (parse->type == GEOMETRY_TYPE_TRIS)
+        {
+          chunk->corner_count += corner_count >= 3 ? (corner_count - 2) * 3 : 0;
+        }
+        else
+        {
+          chunk->corner_count += corner_count;
+        }
+      }
+
+      line = line_end + 1;
+    }
+  }
+}
+
+static const char* parse_floats(const char* cursor, const char* end, uint32_t count, float* values)
+{
+  for (uint32_t index = 0; index < count; ++index)
+  {
+    cursor = parse_float(skip_spaces(cursor, end), end, &values[index]);
+    if (!cursor)
+    {
+      return NULL;
+    }
+  }
+
+  return cursor;
+}
+
+// Parses one corner of a face, like "1", "1/2", "1//3" or "1/2/3"
+static const char* parse_corner(const char* cursor,
+                                const char* end,
+                                const uint32_t preceding_counts[3],
+                                struct Corner* corner)
+{
+  corner->uv = NO_ATTRIBUTE;
+  corner->normal = NO_ATTRIBUTE;
+
+  cursor = parse_index(cursor, end, preceding_counts[0], &corner->position);
+  if (!cursor || cursor == end || *cursor != '/')
+  {
+    return cursor;
+  }
+
+  ++cursor;
+  if (cursor < end && *cursor != '/')
+  {
+    cursor = parse_index(cursor, end, preceding_counts[1], &corner->uv);
+    if (!cursor || cursor == end || *cursor != '/')
+    {
+      return cursor;
+    }
+  }
+
+  if (cursor == end || *cursor != '/')
+  {
+    return cursor;
+  }
+
+  return parse_index(cursor + 1, end, preceding_counts[2], &corner->normal);
+}
+
+// Second pass, parses the elements of each chunk straight into their place in the arrays for the whole file
+static void parse_chunks(void* data, uint32_t begin, uint32_t end)
+{
+  struct Parse* parse = data;
+  for (uint32_t index = begin; index < end; ++index)
+  {
+    struct Chunk* chunk = &parse->chunks[index];
+
+    uint32_t position = chunk->first_position, uv = chunk->first_uv, normal = chunk->first_normal;
+    struct Corner* corner = &parse->corners[chunk->first_corner];
+    struct SubmeshStart* submesh_start = &parse->submesh_starts[chunk->first_submesh_start];
+
+    for (const char* line = chunk->begin; line < chunk->end && !chunk->error;)
+    {
+      const char* line_end = find_line_end(line, chunk->end);
+
+      const char* cursor = line;
+      const enum Statement statement = read_statement(&cursor, line_end);
+      if (statement == STATEMENT_POSITION)
+      {
+        if (!parse_floats(cursor, line_end, 3, &parse->positions[position++ * 3]))
+        {
+          chunk->error = "invalid position";
+        }
+      }
+      else if (statement == STATEMENT_UV)
+      {
+        if (!parse_floats(cursor, line_end, 2, &parse->uvs[uv++ * 2]))
+        {
+          chunk->error = "invalid UV";
+        }
+      }
+      else if (statement == STATEMENT_NORMAL)
+      {
+        if (!parse_floats(cursor, line_end, 3, &parse->normals[normal++ * 3]))
+        {
+          chunk->error = "invalid normal";
+        }
+      }
+      else if (statement == STATEMENT_GROUP || statement == STATEMENT_MATERIAL)
+      {
+        submesh_start->first_corner = (uint32_t)(corner - parse->corners);
+        submesh_start->material = NULL;
+        submesh_start->material_length = 0;
+
+        if (statement == STATEMENT_MATERIAL)
+        {
+          // The name is the rest of the line, which may contain spaces
+          const char* name = skip_spaces(cursor, line_end);
+          const char* name_end = line_end;
+          while (name_end > name && is_space(name_end[-1]))
+          {
+            --name_end;
+          }
+
+          submesh_start->material = name;
+          submesh_start->material_length = (uint32_t)(name_end - name);
+        }
+
+        ++submesh_start;
+      }
+      else if (statement == STATEMENT_FACE)
+      {
+        const uint32_t preceding_counts[3] = { position, uv, normal };
+
+        struct Corner polygon[MAX_POLYGON_CORNERS];
+        uint32_t corner_count = 0;
+        while ((cursor = skip_spaces(cursor, line_end)) < line_end)
+        {
+          if (corner_count == MAX_POLYGON_CORNERS)
+          {
+            chunk->error = "face with too many corners";
+            break;
+          }
+
+          cursor = parse_corner(cursor, line_end, preceding_counts, &polygon[corner_count++]);
+          if (!cursor || (cursor < line_end && !is_space(*cursor)))
+          {
+            chunk->error = "invalid face";
+            break;
+          }
+        }
+
+        if (chunk->error)
+        {
+          break;
+        }
+
+        if (parse->type == GEOMETRY_TYPE_TRIS)
+        {
+          if (corner_count < 3)
+          {
+            chunk->error = "face with less than 3 corners";
+            break;
+          }
+
+          for (uint32_t polygon_corner = 2; polygon_corner < corner_count; ++polygon_corner)
+          {
+            *corner++ = polygon[0];
+            *corner++ = polygon[polygon_corner - 1];
+            *corner++ = polygon[polygon_corner];
+          }
+        }
+        else
+        {
+          if (corner_count != (uint32_t)parse->type)
+          {
+            chunk->error = "face with the wrong number of corners for the geometry type";
+            break;
+          }
+
+          memcpy(corner, polygon, sizeof(struct Corner) * corner_count);
+          corner += corner_count;
+        }
+      }
+
+      line = line_end + 1;
+    }
+  }
+}
+
+// Interleaves the attributes of the welded vertices in the same layout as geometry loaded through assimp
+static void fill_vertices(void* data, uint32_t begin, uint32_t end)
+{
+  const struct Parse* parse = data;
+  struct Geometry* geometry = parse->geometry;
+  const bool has_normals = parse->normals != NULL;
+  const bool has_uvs = parse->uvs != NULL;
+
+  for (uint32_t index = begin; index < end; ++index)
+  {
+    const struct Corner* corner = &parse->unique_corners[index];
+    float* vertex = &geometry->vertices[index * geometry->floats_per_vertex];
+
+    memcpy(vertex, &parse->positions[corner->position * 3], sizeof(float) * 3);
+    vertex += 3;
+
+    if (has_normals)
+    {
+      if (corner->normal != NO_ATTRIBUTE)
+      {
+        memcpy(vertex, &parse->normals[corner->normal * 3], sizeof(float) * 3);
+      }
+      else
+      {
+        memset(vertex, 0, sizeof(float) * 3);
+      }
+      vertex += 3;
+    }
+
+    if (has_uvs)
+    {
+      if (corner->uv != NO_ATTRIBUTE)
+      {
+        memcpy(vertex, &parse->uvs[corner->uv * 2], sizeof(float) * 2);
+      }
+      else
+      {
+        memset(vertex, 0, sizeof(float) * 2);
+      }
+    }
+  }
+}
+
+static void free_parse(struct Parse* parse)
+{
+  free(parse->chunks);
+  free(parse->positions);
+  free(parse->uvs);
+  free(parse->normals);
+  free(parse->corners);
+  free(parse->submesh_starts);
+}
+
+// Turns the submesh starts into the submeshes of the geometry, skipping those without any faces
+static bool make_submeshes(const struct Parse* parse,
+                           uint32_t submesh_start_count,
+                           uint32_t corner_count,
+                           struct Geometry* geometry)
+{
+  // Materials are identified by their name, numbered in the order they are first used in
+  const char** material_names = malloc(sizeof(const char*) * (submesh_start_count > 0 ? submesh_start_count : 1));
+  uint32_t* material_lengths = malloc(sizeof(uint32_t) * (submesh_start_count > 0 ? submesh_start_count : 1));
+  geometry->submeshes = malloc(sizeof(struct Submesh) * (submesh_start_count + 1));
+  if (!material_names || !material_lengths || !geometry->submeshes)
+  {
+    free(material_names);
+    free(material_lengths);
+    return false;
+  }
+
+  uint32_t material_count = 0;
+  uint32_t material = DEFAULT_MATERIAL;
+  uint32_t first_corner = 0;
+  geometry->submesh_count = 0;
+  for (uint32_t index = 0; index <= submesh_start_count; ++index)
+  {
+    // The last submesh ends with the file
+    const struct SubmeshStart* start = index < submesh_start_count ? &parse->submesh_starts[index] : NULL;
+    const uint32_t end_corner = start ? start->first_corner : corner_count;
+    if (end_corner > first_corner)
+    {
+      struct Submesh* submesh = &geometry->submeshes[geometry->submesh_count++];
+      submesh->first_index = first_corner;
+      submesh->index_count = end_corner - first_corner;
+      submesh->base_vertex = 0; // Set while welding
+      submesh->material = material;
+    }
+
+    first_corner = end_corner;
+
+    if (start && start->material)
+    {
+      uint32_t name = 0;
+      while (name < material_count && !(material_lengths[name] == start->material_length &&
+                                         memcmp(material_names[name], start->material, start->material_length) == 0))
+      {
+        ++name;
+      }
+
+      if (name == material_count)
+      {
+        material_names[material_count] = start->material;
+        material_lengths[material_count] = start->material_length;
+        ++material_count;
+      }
+
+      material = DEFAULT_MATERIAL + 1 + name;
+    }
+  }
+
+  free(material_names);
+  free(material_lengths);
+  return true;
+}
+
+// Splits the file into chunks that end at line breaks
+static bool split_chunks(const struct MappedFile* file, struct Parse* parse, uint32_t* chunk_count)
+{
+  *chunk_count = (uint32_t)((file->size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+  parse->chunks = calloc(*chunk_count, sizeof(struct Chunk));
+  if (!parse->chunks)
+  {
+    return false;
+  }
+
+  const char* data = file->data;
+  const char* file_end = data + file->size;
+  const char* begin = data;
+  for (uint32_t index = 0; index < *chunk_count; ++index)
+  {
+    const char* end = index + 1 < *chunk_count ? data + (size_t)(index + 1) * CHUNK_SIZE : file_end;
+    if (end < begin)
+    {
+      end = begin; // The previous chunk ended in a line that was longer than a whole chunk
+    }
+    else if (end < file_end)
+    {
+      end = find_line_end(end, file_end);
+      end = end < file_end ? end + 1 : end;
+    }
+
+    parse->chunks[index].begin = begin;
+    parse->chunks[index].end = end;
+    begin = end;
+  }
+
+  return true;
+}
+
+// Welds corners with identical indices into shared vertices and writes the index of each corner into the geometry
+// The position index is used as the hash, with a chain of the vertices that share each position, which keeps the
+// lookups as local as the faces of the file are
+// Vertices are not shared between submeshes, each submesh gets its own range that starts at its base vertex
+// Returns the unique corners in the order of their vertices, or NULL if any corner is out of range
+static struct Corner* weld_corners(const struct Parse* parse,
+                                   const uint32_t counts[3],
+                                   struct Geometry* geometry,
+                                   const char* filename)
+{
+  const uint32_t corner_count = geometry->index_count;
+  uint32_t* first_vertices = malloc(sizeof(uint32_t) * (counts[0] > 0 ? counts[0] : 1)); // Per position
+  uint32_t* next_vertices = malloc(sizeof(uint32_t) * (corner_count > 0 ? corner_count : 1)); // Per vertex
+  struct Corner* unique_corners = malloc(sizeof(struct Corner) * (corner_count > 0 ? corner_count : 1));
+  if (!first_vertices || !next_vertices || !unique_corners)
+  {
+    printf("Ran out of memory while welding vertices of geometry \"%s\"\n", filename);
+    free(first_vertices);
+    free(next_vertices);
+    free(unique_corners);
+    return NULL;
+  }
+
+  memset(first_vertices, 0xFF, sizeof(uint32_t) * counts[0]);
+
+  uint32_t vertex_count = 0;
+  for (uint32_t submesh_index = 0; submesh_index < geometry->submesh_count; ++submesh_index)
+  {
+    struct Submesh* submesh = &geometry->submeshes[submesh_index];
+    submesh->base_vertex = vertex_count;
+
+    for (uint32_t index = submesh->first_index; index < submesh->first_index + submesh->index_count; ++index)
+    {
+      const struct Corner* corner = &parse->corners[index];
+      if (corner->position >= counts[0] || (corner->uv != NO_ATTRIBUTE && corner->uv >= counts[1]) ||
+          (corner->normal != NO_ATTRIBUTE && corner->normal >= counts[2]))
+      {
+        printf("Geometry \"%s\" has a face that references a vertex that does not exist\n", filename);
+        free(first_vertices);
+        free(next_vertices);
+        free(unique_corners);
+        return NULL;
+      }
+
+      // The chains are newest first, so they can be left as they are between submeshes and cut off at the base vertex
+      uint32_t vertex = first_vertices[corner->position];
+      while (vertex != NO_ATTRIBUTE && vertex >= submesh->base_vertex &&
+             (unique_corners[vertex].uv != corner->uv || unique_corners[vertex].normal != corner->normal))
+      {
+        vertex = next_vertices[vertex];
+      }
+
+      if (vertex == NO_ATTRIBUTE || vertex < submesh->base_vertex)
+      {
+        vertex = vertex_count++;
+        unique_corners[vertex] = *corner;
+        next_vertices[vertex] = first_vertices[corner->position];
+        first_vertices[corner->position] = vertex;
+      }
+
+      geometry->indices[index] = vertex - submesh->base_vertex;
+    }
+  }
+
+  free(first_vertices);
+  free(next_vertices);
+
+  geometry->vertex_count = vertex_count;
+  return unique_corners;
+}
+
+struct Geometry* load_obj(const char* filename, enum GeometryType type)
+{
+  struct MappedFile file;
+  if (!map_file(filename, &file))
+  {
+    printf("Failed to load geometry \"%s\"\n", filename);
+    return NULL;
+  }
+
+  struct Parse parse = { 0 };
+  parse.type = type;
+
+  uint32_t chunk_count;
+  if (!split_chunks(&file, &parse, &chunk_count))
+  {
+    printf("Ran out of memory while loading geometry \"%s\"\n", filename);
+    unmap_file(&file);
+    return NULL;
+  }
+
+  parallel_for(chunk_count, 1, count_chunks, &parse);
+
+  // Turn the counts into where each chunk writes into the arrays for the whole file
+  uint32_t counts[3] = { 0, 0, 0 };
+  uint32_t corner_count = 0, submesh_start_count = 0;
+  for (uint32_t index = 0; index < chunk_count; ++index)
+  {
+    struct Chunk* chunk = &parse.chunks[index];
+    chunk->first_position = counts[0];
+    chunk->first_uv = counts[1];
+    chunk->first_normal = counts[2];
+    chunk->first_corner = corner_count;
+    chunk->first_submesh_start = submesh_start_count;
+
+    counts[0] += chunk->position_count;
+    counts[1] += chunk->uv_count;
+    counts[2] += chunk->normal_count;
+    corner_count += chunk->corner_count;
+    submesh_start_count += chunk->submesh_start_count;
+  }
+
+  parse.positions = malloc(sizeof(float) * 3 * (counts[0] > 0 ? counts[0] : 1));
+  parse.uvs = counts[1] > 0 ? malloc(sizeof(float) * 2 * counts[1]) : NULL;
+  parse.normals = counts[2] > 0 ? malloc(sizeof(float) * 3 * counts[2]) : NULL;
+  parse.corners = malloc(sizeof(struct Corner) * (corner_count > 0 ? corner_count : 1));
+  parse.submesh_starts = malloc(sizeof(struct SubmeshStart) * (submesh_start_count > 0 ? submesh_start_count : 1));
+
+  struct Geometry* geometry = calloc(1, sizeof(struct Geometry));
+  if (!parse.positions || (counts[1] > 0 && !parse.uvs) || (counts[2] > 0 && !parse.normals) || !parse.corners ||
+      !parse.submesh_starts || !geometry)
+  {
+    printf("Ran out of memory while loading geometry \"%s\"\n", filename);
+    free(geometry);
+    free_parse(&parse);
+    unmap_file(&file);
+    return NULL;
+  }
+
+  parallel_for(chunk_count, 1, parse_chunks, &parse);
+
+  for (uint32_t index = 0; index < chunk_count; ++index)
+  {
+    if (parse.chunks[index].error)
+    {
+      printf("Failed to load geometry \"%s\", %s\n", filename, parse.chunks[index].error);
+      free(geometry);
+      free_parse(&parse);
+      unmap_file(&file);
+      return NULL;
+    }
+  }
+
+  // Same vertex definition as for assimp, position, then normal and UV if the file has any
+  geometry->index_count = corner_count;
+  geometry->lods.lod_count = 1;
+  geometry->floats_per_vertex = 3 + (parse.normals ? 3 : 0) + (parse.uvs ? 2 : 0);
+
+  // The material names still point into the file
+  const bool has_submeshes = make_submeshes(&parse, submesh_start_count, corner_count, geometry);
+  unmap_file(&file);
+  if (!has_submeshes)
+  {
+    printf("Ran out of memory while making the submeshes of geometry \"%s\", requested %u submeshes\n", filename,
+           submesh_start_count + 1);
+    free_geometry(geometry);
+    free_parse(&parse);
+    return NULL;
+  }
+
+  geometry->indices = malloc(sizeof(uint32_t) * (corner_count > 0 ? corner_count : 1));
+  if (!geometry->indices)
+  {
+    printf("Ran out of memory while loading geometry \"%s\", requested %zu bytes for indices\n", filename,
+           sizeof(uint32_t) * corner_count);
+    free_geometry(geometry);
+    free_parse(&parse);
+    return NULL;
+  }
+
+  struct Corner* unique_corners = weld_corners(&parse, counts, geometry, filename);
+  if (!unique_corners)
+  {
+    free_geometry(geometry);
+    free_parse(&parse);
+    return NULL;
+  }
+
+  const size_t vertex_size = sizeof(float) * geometry->floats_per_vertex;
+  geometry->vertices = malloc(vertex_size * (geometry->vertex_count > 0 ? geometry->vertex_count : 1));
+  if (!geometry->vertices)
+  {
+    printf("Ran out of memory while loading geometry \"%s\", requested %zu bytes for vertices\n", filename,
+           vertex_size * geometry->vertex_count);
+    free(unique_corners);
+    free_geometry(geometry);
+    free_parse(&parse);
+    return NULL;
+  }
+
+  parse.unique_corners = unique_corners;
+  parse.geometry = geometry;
+  parallel_for(geometry->vertex_count, VERTICES_PER_JOB, fill_vertices, &parse);
+
+  free(unique_corners);
+  free_parse(&parse);
+
+  return geometry;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "geometry_data.h"
+
+// Reads an OBJ file without assimp: the file is mapped, split into chunks of lines that are parsed in parallel, and
+// vertices with the same position, UV and normal indices are welded into one
+// All faces of the file end up in the geometry, polygons are turned into triangle fans for GEOMETRY_TYPE_TRIS
+// Every "o", "g" and "usemtl" statement starts a new submesh, so that objects and materials can be told apart
+struct Geometry* load_obj(const char* filename, enum GeometryType type);
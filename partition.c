@@ -0,0 +1,218 @@
+#include "partition.h"
+
+#include "geometry_data.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A triangle of the source, with the submesh it is in and the cell its center falls into
+struct ChunkTriangle
+{
+  uint32_t submesh;
+  uint32_t cell[3]; // Counted from the lowest corner of the geometry, so never negative
+  uint32_t first_index;
+};
+
+// Orders by submesh and then by cell, rows along X after each other, and keeps the source order within a cell
+static int compare_chunk_triangles(const void* a, const void* b)
+{
+  const struct ChunkTriangle* first = a;
+  const struct ChunkTriangle* second = b;
+
+  const uint32_t first_keys[5] = { first->submesh, first->cell[2], first->cell[1], first->cell[0],
+                                   first->first_index };
+  const uint32_t second_keys[5] = { second->submesh, second->cell[2], second->cell[1], second->cell[0],
+                                    second->first_index };
+  for (int key = 0; key < 5; ++key)
+  {
+    if (first_keys[key] != second_keys[key])
+    {
+      return first_keys[key] < second_keys[key] ? -1 : 1;
+    }
+  }
+
+  return 0;
+}
+
+static bool is_same_chunk(const struct ChunkTriangle* a, const struct ChunkTriangle* b)
+{
+  return a->submesh == b->submesh && a->cell[0] == b->cell[0] && a->cell[1] == b->cell[1] && a->cell[2] == b->cell[2];
+}
+
+// Lays the chunks out one after another, only counting their vertices and themselves unless there is room for them
+static void lay_out_chunks(const struct Geometry* geometry,
+                           const struct ChunkTriangle* triangles,
+                           uint32_t triangle_count,
+                           uint32_t* stamps,
+                           uint32_t* remap,
+                           float* vertices,
+                           uint32_t* indices,
+                           struct Submesh* submeshes,
+                           uint32_t* vertex_count,
+                           uint32_t* chunk_count)
+{
+  // A vertex belongs to the current chunk once its stamp is the number of chunks so far
+  memset(stamps, 0, sizeof(uint32_t) * geometry->vertex_count);
+
+  *vertex_count = 0;
+  *chunk_count = 0;
+
+  uint32_t index_count = 0;
+  for (uint32_t triangle = 0; triangle < triangle_count; ++triangle)
+  {
+    const struct ChunkTriangle* chunk_triangle = &triangles[triangle];
+    const struct Submesh* source = &geometry->submeshes[chunk_triangle->submesh];
+
+    if (triangle == 0 || !is_same_chunk(chunk_triangle, &triangles[triangle - 1]))
+    {
+      if (submeshes)
+      {
+        struct Submesh* chunk = &submeshes[*chunk_count];
+        chunk->first_index = index_count;
+        chunk->index_count = 0;
+        chunk->base_vertex = *vertex_count;
+        chunk->material = source->material;
+      }
+
+      ++*chunk_count;
+    }
+
+    for (uint32_t corner = 0; corner < 3; ++corner)
+    {
+      const uint32_t vertex = source->base_vertex + geometry->indices[chunk_triangle->first_index + corner];
+      if (stamps[vertex] != *chunk_count)
+      {
+        stamps[vertex] = *chunk_count;
+        if (vertices)
+        {
+          remap[vertex] = *vertex_count - submeshes[*chunk_count - 1].base_vertex;
+          memcpy(&vertices[(size_t)*vertex_count * geometry->floats_per_vertex],
+                 &geometry->vertices[(size_t)vertex * geometry->floats_per_vertex],
+                 sizeof(float) * geometry->floats_per_vertex);
+        }
+
+        ++*vertex_count;
+      }
+
+      if (indices)
+      {
+        indices[index_count] = remap[vertex];
+        ++submeshes[*chunk_count - 1].index_count;
+      }
+
+      ++index_count;
+    }
+  }
+}
+
+bool partition_geometry(struct Geometry* geometry, float chunk_size)
+{
+  if (geometry->lods.lod_count > 1)
+  {
+    printf("Geometry has to be partitioned before its levels of detail are generated\n");
+    return false;
+  }
+
+  if (chunk_size <= 0.0f || geometry->vertex_count == 0)
+  {
+    return true;
+  }
+
+  const uint32_t floats_per_vertex = geometry->floats_per_vertex;
+
+  float min[3] = { INFINITY, INFINITY, INFINITY };
+  for (uint32_t vertex = 0; vertex < geometry->vertex_count; ++vertex)
+  {
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      min[axis] = fminf(min[axis], geometry->vertices[(size_t)vertex * floats_per_vertex + axis]);
+    }
+  }
+
+  const uint32_t triangle_count = geometry->index_count / 3;
+  struct ChunkTriangle* triangles = malloc(sizeof(struct ChunkTriangle) * (triangle_count > 0 ? triangle_count : 1));
+  uint32_t* stamps = malloc(sizeof(uint32_t) * geometry->vertex_count);
+  uint32_t* remap = malloc(sizeof(uint32_t) * geometry->vertex_count);
+  uint32_t* indices = malloc(sizeof(uint32_t) * (geometry->index_count > 0 ? geometry->index_count : 1));
+  if (!triangles || !stamps || !remap || !indices)
+  {
+    printf("Ran out of memory while partitioning geometry with %u triangles\n", triangle_count);
+    free(triangles);
+    free(stamps);
+    free(remap);
+    free(indices);
+    return false;
+  }
+
+  uint32_t chunk_triangle_count = 0;
+  for (uint32_t submesh = 0; submesh < geometry->submesh_count; ++submesh)
+  {
+    const struct Submesh* source = &geometry->submeshes[submesh];
+    for (uint32_t offset = 0; offset + 3 <= source->index_count; offset += 3)
+    {
+      struct ChunkTriangle* triangle = &triangles[chunk_triangle_count++];
+      triangle->submesh = submesh;
+      triangle->first_index = source->first_index + offset;
+
+      float center[3] = { 0.0f, 0.0f, 0.0f };
+      for (uint32_t corner = 0; corner < 3; ++corner)
+      {
+        const uint32_t vertex = source->base_vertex + geometry->indices[triangle->first_index + corner];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          center[axis] += geometry->vertices[(size_t)vertex * floats_per_vertex + axis] / 3.0f;
+        }
+      }
+
+      // Clamped to the range of the cell coordinates, which only merges the outermost cells of absurdly large geometry
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        const float cell = floorf((center[axis] - min[axis]) / chunk_size);
+        triangle->cell[axis] = cell < (float)UINT32_MAX ? (uint32_t)fmaxf(cell, 0.0f) : UINT32_MAX;
+      }
+    }
+  }
+
+  qsort(triangles, chunk_triangle_count, sizeof(struct ChunkTriangle), compare_chunk_triangles);
+
+  // Counted first, so that only as much memory as the chunks take is allocated
+  uint32_t vertex_count, chunk_count;
+  lay_out_chunks(geometry, triangles, chunk_triangle_count, stamps, remap, NULL, NULL, NULL, &vertex_count,
+                 &chunk_count);
+
+  float* vertices = malloc(sizeof(float) * floats_per_vertex * (vertex_count > 0 ? vertex_count : 1));
+  struct Submesh* submeshes = malloc(sizeof(struct Submesh) * (chunk_count > 0 ? chunk_count : 1));
+  if (!vertices || !submeshes)
+  {
+    printf("Ran out of memory while partitioning geometry into %u chunks\n", chunk_count);
+    free(vertices);
+    free(submeshes);
+    free(triangles);
+    free(stamps);
+    free(remap);
+    free(indices);
+    return false;
+  }
+
+  lay_out_chunks(geometry, triangles, chunk_triangle_count, stamps, remap, vertices, indices, submeshes, &vertex_count,
+                 &chunk_count);
+
+  free(triangles);
+  free(stamps);
+  free(remap);
+
+  free(geometry->vertices);
+  free(geometry->indices);
+  free(geometry->submeshes);
+
+  geometry->vertices = vertices;
+  geometry->indices = indices;
+  geometry->submeshes = submeshes;
+  geometry->vertex_count = vertex_count;
+  geometry->index_count = chunk_triangle_count * 3;
+  geometry->submesh_count = chunk_count;
+
+  return true;
+}
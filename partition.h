@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdbool.h>
+
+struct Geometry;
+
+// Splits each submesh of CPU geometry into chunks of the triangles whose centers fall into the same cube of chunk_size
+// on each side, so that chunks off-screen can be culled, see frustum.h
+// Each chunk gets its own range of vertices, so vertices on the borders between chunks are duplicated, and the chunks
+// of a submesh keep its material
+// Only works before levels of detail are generated, as they are generated for each chunk on its own
+bool partition_geometry(struct Geometry* geometry, float chunk_size);
@@ -10,5 +10,9 @@ void destroy_player();
 mat4* get_player_transform();
 float get_player_height();
 
+// Interpolated between the last two updates of the player, see interpolate_transform
+void get_player_render_transform(float alpha, mat4 dest);
+
 void update_player(const vec2 cursor_delta, float delta_time);
-void draw_player(const mat4 viewproj_matrix);
+// Queues the capsule of the player as a debug draw, interpolated like get_player_render_transform
+void draw_player(float alpha);
@@ -0,0 +1,316 @@
+#include "profiler.h"
+
+#include "thread.h"
+
+#include <glad/gl.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <time.h>
+#endif
+
+#define EVENT_CAPACITY (1u << 16) // Has to be a power of two
+#define MAX_ZONE_DEPTH 16
+#define GPU_FRAME_LATENCY 4 // Frames that GPU queries are given to finish before they are read back
+
+enum ProfileTrack
+{
+  PROFILE_TRACK_CPU,
+  PROFILE_TRACK_GPU
+};
+
+struct ProfileEvent
+{
+  uint64_t start; // Nanoseconds since the profiler was initialized, GPU events start when their commands were issued
+  uint64_t duration;
+  uint32_t thread; // Small per-thread id, 0 for the GPU
+  uint8_t zone;
+  uint8_t track;
+};
+
+struct ZoneStack
+{
+  uint64_t starts[MAX_ZONE_DEPTH];
+  uint8_t zones[MAX_ZONE_DEPTH];
+  uint32_t depth;
+};
+
+static const char* zone_names[PROFILE_ZONE_COUNT] = { "update",          "player collision", "camera collision",
+                                                      "crowd collision", "draw_level",       "draw_queue",
+                                                      "draw_player",     "draw_debug",       "load asset",
+                                                      "upload assets",   "swap" };
+
+// Lock-free ring buffer, every writer claims a slot with an atomic increment and the oldest events are overwritten
+static struct ProfileEvent events[EVENT_CAPACITY];
+static volatile uint32_t event_count = 0; // Total number of events ever written, wraps around the ring buffer
+
+static uint64_t start_time = 0;
+static volatile uint32_t thread_count = 0;
+static THREAD_LOCAL uint32_t thread_id = 0;
+static THREAD_LOCAL struct ZoneStack zone_stack;
+
+static bool gpu_enabled = false;
+static GLuint gpu_queries[GPU_FRAME_LATENCY][PROFILE_ZONE_COUNT];
+static uint64_t gpu_starts[GPU_FRAME_LATENCY][PROFILE_ZONE_COUNT];
+static bool gpu_pending[GPU_FRAME_LATENCY][PROFILE_ZONE_COUNT];
+static uint32_t gpu_frame = 0;
+
+static uint64_t get_raw_time()
+{
+#ifdef _WIN32
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
+
+uint64_t get_profiler_time()
+{
+  return get_raw_time() - start_time;
+}
+
+static uint32_t get_thread_id()
+{
+  if (thread_id == 0)
+  {
+    thread_id = atomic_add_u32(&thread_count, 1) + 1;
+  }
+
+  return thread_id;
+}
+
+static void record_event(enum ProfileZone zone, enum ProfileTrack track, uint32_t thread, uint64_t start, uint64_t end)
+{
+  const uint32_t index = atomic_add_u32(&event_count, 1) & (EVENT_CAPACITY - 1);
+
+  struct ProfileEvent* event = &events[index];
+  event->start = start;
+  event->duration = end > start ? end - start : 0;
+  event->thread = thread;
+  event->zone = (uint8_t)zone;
+  event->track = (uint8_t)track;
+}
+
+bool init_profiler(bool gpu)
+{
+  start_time = get_raw_time();
+  atomic_store_u32(&event_count, 0);
+
+  gpu_enabled = gpu;
+  if (gpu_enabled)
+  {
+    glGenQueries(GPU_FRAME_LATENCY * PROFILE_ZONE_COUNT, &gpu_queries[0][0]);
+    for (uint32_t frame = 0; frame < GPU_FRAME_LATENCY; ++frame)
+    {
+      for (uint32_t zone = 0; zone < PROFILE_ZONE_COUNT; ++zone)
+      {
+        gpu_pending[frame][zone] = false;
+      }
+    }
+    gpu_frame = 0;
+  }
+
+  return true;
+}
+
+void destroy_profiler()
+{
+  if (gpu_enabled)
+  {
+    glDeleteQueries(GPU_FRAME_LATENCY * PROFILE_ZONE_COUNT, &gpu_queries[0][0]);
+    gpu_enabled = false;
+  }
+}
+
+void begin_cpu_zone(enum ProfileZone zone)
+{
+  if (zone_stack.depth < MAX_ZONE_DEPTH)
+  {
+    zone_stack.starts[zone_stack.depth] = get_profiler_time();
+    zone_stack.zones[zone_stack.depth] = (uint8_t)zone;
+  }
+
+  ++zone_stack.depth;
+}
+
+void end_cpu_zone(enum ProfileZone zone)
+{
+  if (zone_stack.depth == 0)
+  {
+    printf("Ended profiler zone \"%s\" that was never begun\n", zone_names[zone]);
+    return;
+  }
+
+  --zone_stack.depth;
+  if (zone_stack.depth >= MAX_ZONE_DEPTH)
+  {
+    // Too deep to have been recorded
+    return;
+  }
+
+  if (zone_stack.zones[zone_stack.depth] != zone)
+  {
+    printf("Ended profiler zone \"%s\" while \"%s\" is innermost\n", zone_names[zone],
+           zone_names[zone_stack.zones[zone_stack.depth]]);
+  }
+
+  record_event(zone, PROFILE_TRACK_CPU, get_thread_id(), zone_stack.starts[zone_stack.depth], get_profiler_time());
+}
+
+void begin_gpu_zone(enum ProfileZone zone)
+{
+  if (!gpu_enabled || gpu_pending[gpu_frame][zone])
+  {
+    // The query from GPU_FRAME_LATENCY frames ago is still not done, skip this one rather than stall
+    return;
+  }
+
+  gpu_starts[gpu_frame][zone] = get_profiler_time();
+  glBeginQuery(GL_TIME_ELAPSED, gpu_queries[gpu_frame][zone]);
+}
+
+void end_gpu_zone(enum ProfileZone zone)
+{
+  if (!gpu_enabled || gpu_pending[gpu_frame][zone])
+  {
+    return;
+  }
+
+  glEndQuery(GL_TIME_ELAPSED);
+  gpu_pending[gpu_frame][zone] = true;
+}
+
+void end_profiler_frame()
+{
+  if (!gpu_enabled)
+  {
+    return;
+  }
+
+  gpu_frame = (gpu_frame + 1) % GPU_FRAME_LATENCY;
+
+  // Read back the oldest frame, which is about to be reused, if its queries are done by now
+  for (uint32_t zone = 0; zone < PROFILE_ZONE_COUNT; ++zone)
+  {
+    if (!gpu_pending[gpu_frame][zone])
+    {
+      continue;
+    }
+
+    GLuint available;
+    glGetQueryObjectuiv(gpu_queries[gpu_frame][zone], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+    {
+      continue;
+    }
+
+    GLuint64 elapsed;
+    glGetQueryObjectui64v(gpu_queries[gpu_frame][zone], GL_QUERY_RESULT, &elapsed);
+    gpu_pending[gpu_frame][zone] = false;
+
+    const uint64_t start = gpu_starts[gpu_frame][zone];
+    record_event((enum ProfileZone)zone, PROFILE_TRACK_GPU, 0, start, start + elapsed);
+  }
+}
+
+// Returns the first recorded event index still in the ring buffer and the number of events from there on
+static uint32_t get_recorded_events(uint32_t* first)
+{
+  const uint32_t count = atomic_load_u32(&event_count);
+  *first = count > EVENT_CAPACITY ? count - EVENT_CAPACITY : 0;
+  return count - *first;
+}
+
+static int compare_durations(const void* a, const void* b)
+{
+  const uint64_t duration_a = *(const uint64_t*)a;
+  const uint64_t duration_b = *(const uint64_t*)b;
+  return (duration_a > duration_b) - (duration_a < duration_b);
+}
+
+void print_profiler_summary()
+{
+  uint32_t first;
+  const uint32_t count = get_recorded_events(&first);
+
+  uint64_t* durations = malloc(sizeof(uint64_t) * (count > 0 ? count : 1));
+  if (!durations)
+  {
+    printf("Ran out of memory while summarizing %u profiler events\n", count);
+    return;
+  }
+
+  printf("%-20s %-4s %8s %10s %10s %10s\n", "Zone", "", "Count", "Min (ms)", "Avg (ms)", "P99 (ms)");
+  for (uint32_t track = PROFILE_TRACK_CPU; track <= PROFILE_TRACK_GPU; ++track)
+  {
+    for (uint32_t zone = 0; zone < PROFILE_ZONE_COUNT; ++zone)
+    {
+      uint32_t zone_count = 0;
+      uint64_t total = 0;
+      for (uint32_t event = first; event != first + count; ++event)
+      {
+        const struct ProfileEvent* e = &events[event & (EVENT_CAPACITY - 1)];
+        if (e->zone == zone && e->track == track)
+        {
+          durations[zone_count++] = e->duration;
+          total += e->duration;
+        }
+      }
+
+      if (zone_count == 0)
+      {
+        continue;
+      }
+
+      qsort(durations, zone_count, sizeof(uint64_t), compare_durations);
+      const uint32_t p99 = (uint32_t)((uint64_t)(zone_count - 1) * 99 / 100);
+
+      printf("%-20s %-4s %8u %10.3f %10.3f %10.3f\n", zone_names[zone], track == PROFILE_TRACK_CPU ? "CPU" : "GPU",
+             zone_count, (double)durations[0] * 1e-6, (double)total / (double)zone_count * 1e-6,
+             (double)durations[p99] * 1e-6);
+    }
+  }
+
+  free(durations);
+}
+
+bool write_profiler_trace(const char* path)
+{
+  FILE* file = fopen(path, "w");
+  if (!file)
+  {
+    printf("Failed to open trace file \"%s\"\n", path);
+    return false;
+  }
+
+  uint32_t first;
+  const uint32_t count = get_recorded_events(&first);
+
+  // Complete events, with timestamps in microseconds, in a process for the CPU threads and one for the GPU
+  fprintf(file, "{\"traceEvents\":[\n");
+  fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+  fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"GPU\"}}");
+  for (uint32_t event = first; event != first + count; ++event)
+  {
+    const struct ProfileEvent* e = &events[event & (EVENT_CAPACITY - 1)];
+    fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            zone_names[e->zone], e->track == PROFILE_TRACK_CPU ? 1 : 2, e->thread, (double)e->start * 1e-3,
+            (double)e->duration * 1e-3);
+  }
+  fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  fclose(file);
+
+  printf("Wrote %u profiler events to \"%s\"\n", count, path);
+  return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum ProfileZone
+{
+  PROFILE_ZONE_UPDATE,
+  PROFILE_ZONE_PLAYER_COLLISION,
+  PROFILE_ZONE_CAMERA_COLLISION,
+  PROFILE_ZONE_CROWD_COLLISION,
+  PROFILE_ZONE_DRAW_LEVEL,
+  PROFILE_ZONE_DRAW_QUEUE,
+  PROFILE_ZONE_DRAW_PLAYER,
+  PROFILE_ZONE_DRAW_DEBUG,
+  PROFILE_ZONE_LOAD_ASSET,
+  PROFILE_ZONE_UPLOAD_ASSETS,
+  PROFILE_ZONE_SWAP,
+  PROFILE_ZONE_COUNT
+};
+
+// The GPU zones need a current OpenGL context, without one only CPU zones are recorded
+bool init_profiler(bool gpu);
+void destroy_profiler();
+
+// CPU zones nest, and can be recorded from any thread
+void begin_cpu_zone(enum ProfileZone zone);
+void end_cpu_zone(enum ProfileZone zone);
+
+// GPU zones can not nest, as only one GL_TIME_ELAPSED query can be active at a time
+void begin_gpu_zone(enum ProfileZone zone);
+void end_gpu_zone(enum ProfileZone zone);
+
+// Collects the GPU timings that have become available, call once per frame
+void end_profiler_frame();
+
+// Min, average and 99th percentile duration per zone, over the events still in the ring buffer
+void print_profiler_summary();
+
+// Writes the events still in the ring buffer in the Chrome trace event format, which Perfetto can open as well
+bool write_profiler_trace(const char* path);
+
+uint64_t get_profiler_time(); // In nanoseconds
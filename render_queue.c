@@ -0,0 +1,253 @@
+#include "render_queue.h"
+
+#include "geometry.h"
+#include "shader.h"
+
+#include <cglm/mat4.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_QUEUE_CAPACITY 64
+
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+// Bits of each state in the sort key, from the most significant down, only the low bits of each name are used, which
+// can only cost some state changes when names collide
+#define KEY_PROGRAM_BITS 10
+#define KEY_TEXTURE_BITS 10
+#define KEY_VERTEX_ARRAY_BITS 12
+#define KEY_DEPTH_BITS 32 // The bits of the depth as a float, which sort like the float itself as it is never negative
+
+// Laid out like the FRAME_UNIFORM_BLOCK in the shaders, with std140 rules
+struct FrameUniforms
+{
+  mat4 viewproj;
+};
+
+struct DrawItem
+{
+  const struct ShaderProgram* program;
+  GLuint texture;
+  const struct Geometry* geometry;
+  uint32_t lod;
+  const uint8_t* visible_submeshes;
+  mat4 world;
+};
+
+struct SortEntry
+{
+  uint64_t key;
+  uint32_t item;
+};
+
+static GLuint frame_buffer;
+static mat4 viewproj;
+
+// Grow as needed and are emptied every frame, so that they settle at the size of the busiest frame
+static struct DrawItem* items = NULL;
+static struct SortEntry *entries = NULL, *sorted_entries = NULL;
+static uint32_t item_count = 0, item_capacity = 0;
+
+static bool grow_queue()
+{
+  const uint32_t capacity = item_capacity > 0 ? item_capacity * 2 : MIN_QUEUE_CAPACITY;
+
+  // Each buffer that could be grown is kept, the capacity only changes once all of them have
+  struct DrawItem* new_items = realloc(items, sizeof(struct DrawItem) * capacity);
+  items = new_items ? new_items : items;
+
+  struct SortEntry* new_entries = new_items ? realloc(entries, sizeof(struct SortEntry) * capacity) : NULL;
+  entries = new_entries ? new_entries : entries;
+
+  struct SortEntry* new_sorted_entries =
+    new_entries ? realloc(sorted_entries, sizeof(struct SortEntry) * capacity) : NULL;
+  if (!new_sorted_entries)
+  {
+    printf("Ran out of memory while queuing draws, requested %u of them\n", capacity);
+    return false;
+  }
+
+  sorted_entries = new_sorted_entries;
+  item_capacity = capacity;
+  return true;
+}
+
+static uint64_t make_sort_key(GLuint program, GLuint texture, GLuint vertex_array, float depth)
+{
+  uint32_t depth_bits;
+  depth = depth > 0.0f ? depth : 0.0f;
+  memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+  uint64_t key = program & ((1u << KEY_PROGRAM_BITS) - 1);
+  key = (key << KEY_TEXTURE_BITS) | (texture & ((1u << KEY_TEXTURE_BITS) - 1));
+  key = (key << KEY_VERTEX_ARRAY_BITS) | (vertex_array & ((1u << KEY_VERTEX_ARRAY_BITS) - 1));
+  return (key << KEY_DEPTH_BITS) | depth_bits;
+}
+
+// Least significant digit first, which keeps the order of equal keys, and skips the digits that all keys share
+static struct SortEntry* sort_entries(uint32_t count)
+{
+  struct SortEntry* source = entries;
+  struct SortEntry* destination = sorted_entries;
+  for (uint32_t shift = 0; shift < 64; shift += RADIX_BITS)
+  {
+    uint32_t offsets[RADIX_SIZE] = { 0 };
+    for (uint32_t entry = 0; entry < count; ++entry)
+    {
+      ++offsets[(source[entry].key >> shift) & (RADIX_SIZE - 1)];
+    }
+
+    if (offsets[(source[0].key >> shift) & (RADIX_SIZE - 1)] == count)
+    {
+      continue;
+    }
+
+    uint32_t offset = 0;
+    for (uint32_t digit = 0; digit < RADIX_SIZE; ++digit)
+    {
+      const uint32_t digit_count = offsets[digit];
+      offsets[digit] = offset;
+      offset += digit_count;
+    }
+
+    for (uint32_t entry = 0; entry < count; ++entry)
+    {
+      destination[offsets[(source[entry].key >> shift) & (RADIX_SIZE - 1)]++] = source[entry];
+    }
+
+    struct SortEntry* swap = source;
+    source = destination;
+    destination = swap;
+  }
+
+  return source;
+}
+
+bool generate_render_queue()
+{
+  glGenBuffers(1, &frame_buffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, frame_buffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(struct FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, frame_buffer);
+
+  return true;
+}
+
+void destroy_render_queue()
+{
+  glDeleteBuffers(1, &frame_buffer);
+
+  free(items);
+  free(entries);
+  free(sorted_entries);
+  items = NULL;
+  entries = NULL;
+  sorted_entries = NULL;
+  item_count = item_capacity = 0;
+}
+
+void begin_render_queue(const mat4 viewproj_matrix)
+{
+  item_count = 0;
+  glm_mat4_copy((vec4*)viewproj_matrix, viewproj);
+
+  // Respecified every frame, which lets the driver hand out fresh storage instead of waiting on the GPU
+  struct FrameUniforms frame;
+  glm_mat4_copy((vec4*)viewproj_matrix, frame.viewproj);
+  glBindBuffer(GL_UNIFORM_BUFFER, frame_buffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(struct FrameUniforms), &frame, GL_DYNAMIC_DRAW);
+}
+
+void submit_draw(const struct ShaderProgram* program,
+                 GLuint texture,
+                 const struct Geometry* geometry,
+                 uint32_t lod,
+                 const uint8_t* visible_submeshes,
+                 const mat4 world_matrix)
+{
+  if (item_count == item_capacity && !grow_queue())
+  {
+    return;
+  }
+
+  struct DrawItem* item = &items[item_count];
+  item->program = program;
+  item->texture = texture;
+  item->geometry = geometry;
+  item->lod = lod;
+  item->visible_submeshes = visible_submeshes;
+  glm_mat4_copy((vec4*)world_matrix, item->world);
+
+  // Front to back within the same state, by the distance of the bounding sphere center along the view direction
+  vec4 center, clip;
+  glm_mat4_mulv3(item->world, (float*)geometry->lods.bounds_center, 1.0f, center);
+  center[3] = 1.0f;
+  glm_mat4_mulv(viewproj, center, clip);
+
+  entries[item_count].key = make_sort_key(program->program, texture, geometry->vertex_array, clip[3]);
+  entries[item_count].item = item_count;
+  ++item_count;
+}
+
+void flush_render_queue()
+{
+  if (item_count == 0)
+  {
+    return;
+  }
+
+  const struct SortEntry* sorted = sort_entries(item_count);
+
+  // Nothing is known to be bound yet
+  GLuint program = 0;
+  GLuint texture = 0;
+  bool texture_bound = false;
+  const struct Geometry* geometry = NULL;
+  const float* world = NULL;
+
+  glActiveTexture(GL_TEXTURE0);
+
+  for (uint32_t entry = 0; entry < item_count; ++entry)
+  {
+    const struct DrawItem* item = &items[sorted[entry].item];
+    const GLint* locations = item->program->uniform_locations;
+
+    // Uniforms belong to the program, so a new one needs all of them again
+    if (item->program->program != program)
+    {
+      program = item->program->program;
+      glUseProgram(program);
+      geometry = NULL;
+      world = NULL;
+    }
+
+    if (!texture_bound || item->texture != texture)
+    {
+      texture = item->texture;
+      texture_bound = true;
+      glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    if (item->geometry != geometry)
+    {
+      geometry = item->geometry;
+      glBindVertexArray(geometry->vertex_array);
+      glUniform3fv(locations[OBJECT_UNIFORM_POSITION_OFFSET], 1, geometry->quantization.position_offset);
+      glUniform3fv(locations[OBJECT_UNIFORM_POSITION_SCALE], 1, geometry->quantization.position_scale);
+      glUniform1i(locations[OBJECT_UNIFORM_PACKED_NORMALS], geometry->vertex_format == VERTEX_FORMAT_PACKED);
+    }
+
+    if (!world || memcmp(world, item->world, sizeof(mat4)) != 0)
+    {
+      world = (const float*)item->world;
+      glUniformMatrix4fv(locations[OBJECT_UNIFORM_WORLD], 1, GL_FALSE, world);
+    }
+
+    draw_geometry(geometry, item->lod, item->visible_submeshes);
+  }
+
+  item_count = 0;
+}
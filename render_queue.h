@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cglm/types.h>
+
+#include <glad/gl.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct Geometry;
+struct ShaderProgram;
+
+// Uniforms that the queue sets for every item it draws, each program drawn through it has to be made with these
+// names first, in this order
+enum ObjectUniform
+{
+  OBJECT_UNIFORM_WORLD,
+  OBJECT_UNIFORM_POSITION_OFFSET, // Decode packed vertices, see struct VertexQuantization
+  OBJECT_UNIFORM_POSITION_SCALE,
+  OBJECT_UNIFORM_PACKED_NORMALS,
+  OBJECT_UNIFORM_COUNT
+};
+
+#define OBJECT_UNIFORM_NAMES "world", "position_offset", "position_scale", "packed_normals"
+
+// Collects the draws of a frame, sorts them by program, texture, vertex array and then front to back, and issues them
+// with only the state changes between neighbors, so that the calls grow with the states rather than the objects
+// Per-frame uniforms live in a single uniform buffer that every program shares, see FRAME_UNIFORM_BLOCK
+bool generate_render_queue();
+void destroy_render_queue();
+
+// Empties the queue and uploads the uniforms of the frame, before anything is drawn in it
+void begin_render_queue(const mat4 viewproj_matrix);
+
+// Queues a level of detail of uploaded triangle geometry, with a texture in unit 0 unless it is 0
+// Only the submeshes flagged in visible_submeshes are drawn, all of them if it is NULL, and it has to stay as it is
+// until the queue is flushed
+void submit_draw(const struct ShaderProgram* program,
+                 GLuint texture,
+                 const struct Geometry* geometry,
+                 uint32_t lod,
+                 const uint8_t* visible_submeshes,
+                 const mat4 world_matrix);
+
+// Draws everything that was submitted since begin_render_queue
+void flush_render_queue();
@@ -0,0 +1,146 @@
+#include "scene_query.h"
+
+#include "bvh.h"
+#include "collision.h"
+#include "collision_mesh.h"
+#include "jobs.h"
+
+#include <cglm/vec3.h>
+
+#include <float.h>
+#include <math.h>
+
+#define CASTS_PER_JOB 64
+#define MAX_TRAVERSAL_DEPTH 128 // Twice the maximum depth of the BVH
+
+struct CastContext
+{
+  const struct CollisionMesh* mesh;
+  const struct Bvh* bvh;
+  const struct SceneCast* casts;
+  struct SceneHit* hits;
+};
+
+// Returns the distance at which a ray enters a box grown by radius, or FLT_MAX if it misses it within max_dist
+static float enter_node(const struct BvhNode* node, const vec3 origin, const vec3 inv_dir, float radius, float max_dist)
+{
+  float t_min = 0.0f, t_max = max_dist;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    // Parallel to the slab, where 0 * inf would give NaN for an origin on one of its planes
+    if (isinf(inv_dir[axis]))
+    {
+      if (origin[axis] < node->min[axis] - radius || origin[axis] > node->max[axis] + radius)
+      {
+        return FLT_MAX;
+      }
+
+      continue;
+    }
+
+    const float t0 = (node->min[axis] - radius - origin[axis]) * inv_dir[axis];
+    const float t1 = (node->max[axis] + radius - origin[axis]) * inv_dir[axis];
+    t_min = glm_max(t_min, glm_min(t0, t1));
+    t_max = glm_min(t_max, glm_max(t0, t1));
+  }
+
+  return t_min <= t_max ? t_min : FLT_MAX;
+}
+
+static void find_nearest_hit(const struct CollisionMesh* mesh,
+                             const struct Bvh* bvh,
+                             const struct SceneCast* cast,
+                             struct SceneHit* hit)
+{
+  hit->hit = false;
+  hit->dist = cast->max_dist;
+
+  if (bvh->primitive_count == 0)
+  {
+    return;
+  }
+
+  const vec3 inv_dir = { 1.0f / cast->dir[0], 1.0f / cast->dir[1], 1.0f / cast->dir[2] };
+
+  // Front to back traversal, skipping nodes that start beyond the nearest hit so far
+  uint32_t stack[MAX_TRAVERSAL_DEPTH];
+  uint32_t stack_size = 0;
+
+  if (enter_node(&bvh->nodes[0], cast->origin, inv_dir, cast->radius, hit->dist) == FLT_MAX)
+  {
+    return;
+  }
+  stack[stack_size++] = 0;
+
+  while (stack_size > 0)
+  {
+    const struct BvhNode* node = &bvh->nodes[stack[--stack_size]];
+    if (node->count > 0)
+    {
+      for (uint32_t primitive = node->first; primitive < node->first + node->count; ++primitive)
+      {
+        vec3 v0, v1, v2, n;
+        get_collision_triangle(mesh, bvh->primitives[primitive], v0, v1, v2, n);
+
+        float dist;
+        vec3 normal;
+        if (sphere_triangle_cast((float*)cast->origin, (float*)cast->dir, cast->radius, hit->dist, v0, v1, v2, n,
+                                 &dist, normal) &&
+            (!hit->hit || dist < hit->dist))
+        {
+          hit->hit = true;
+          hit->dist = dist;
+          glm_vec3_copy(normal, hit->normal);
+        }
+      }
+
+      continue;
+    }
+
+    const uint32_t left = node->first;
+    const uint32_t right = node->first + 1;
+    const float left_dist = enter_node(&bvh->nodes[left], cast->origin, inv_dir, cast->radius, hit->dist);
+    const float right_dist = enter_node(&bvh->nodes[right], cast->origin, inv_dir, cast->radius, hit->dist);
+
+    // Push the farther child first so that the nearer one is visited first
+    const bool left_first = left_dist <= right_dist;
+    const uint32_t near_child = left_first ? left : right;
+    const uint32_t far_child = left_first ? right : left;
+    const float near_dist = left_first ? left_dist : right_dist;
+    const float far_dist = left_first ? right_dist : left_dist;
+
+    if (far_dist != FLT_MAX)
+    {
+      stack[stack_size++] = far_child;
+    }
+
+    if (near_dist != FLT_MAX)
+    {
+      stack[stack_size++] = near_child;
+    }
+  }
+}
+
+static void cast_batch(void* data, uint32_t begin, uint32_t end)
+{
+  const struct CastContext* context = data;
+  for (uint32_t index = begin; index < end; ++index)
+  {
+    find_nearest_hit(context->mesh, context->bvh, &context->casts[index], &context->hits[index]);
+  }
+}
+
+void cast_scene(const struct CollisionMesh* mesh,
+                const struct Bvh* bvh,
+                const struct SceneCast* casts,
+                struct SceneHit* hits,
+                uint32_t count)
+{
+  struct CastContext context;
+  context.mesh = mesh;
+  context.bvh = bvh;
+  context.casts = casts;
+  context.hits = hits;
+
+  parallel_for(count, CASTS_PER_JOB, cast_batch, &context);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cglm/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct Bvh;
+struct CollisionMesh;
+
+// A ray (radius 0) or sphere moving from origin along the normalized direction dir for up to max_dist
+struct SceneCast
+{
+  vec3 origin;
+  vec3 dir;
+  float radius;
+  float max_dist;
+};
+
+struct SceneHit
+{
+  bool hit;
+  float dist;  // Distance travelled along dir until the first contact
+  vec3 normal; // Pointing away from the surface that was hit
+};
+
+// Finds the nearest hit for each cast against a collision mesh, using its BVH to skip most triangles
+// Large batches are spread over the job threads
+void cast_scene(const struct CollisionMesh* mesh,
+                const struct Bvh* bvh,
+                const struct SceneCast* casts,
+                struct SceneHit* hits,
+                uint32_t count);
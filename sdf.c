@@ -0,0 +1,508 @@
+#include "sdf.h"
+
+#include "bvh.h"
+#include "collision.h"
+#include "collision_mesh.h"
+#include "jobs.h"
+
+#include <cglm/vec3.h>
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLES_PER_AXIS (SDF_BRICK_SIZE + 1)
+#define SAMPLES_PER_BRICK (SAMPLES_PER_AXIS * SAMPLES_PER_AXIS * SAMPLES_PER_AXIS)
+#define QUANTIZATION_SCALE 32767.0f
+
+#define MAX_CAST_STEPS 256
+
+struct BakeContext
+{
+  const struct CollisionMesh* mesh;
+  const struct Bvh* bvh;
+  struct Sdf* sdf;
+  bool* near_surface; // Per brick
+};
+
+static uint32_t get_brick_cell_count(const struct Sdf* sdf)
+{
+  return sdf->brick_counts[0] * sdf->brick_counts[1] * sdf->brick_counts[2];
+}
+
+static void get_brick_bounds(const struct Sdf* sdf, uint32_t brick, vec3 min, vec3 max)
+{
+  const uint32_t x = brick % sdf->brick_counts[0];
+  const uint32_t y = (brick / sdf->brick_counts[0]) % sdf->brick_counts[1];
+  const uint32_t z = brick / (sdf->brick_counts[0] * sdf->brick_counts[1]);
+
+  const float brick_size = sdf->voxel_size * SDF_BRICK_SIZE;
+  min[0] = sdf->origin[0] + (float)x * brick_size;
+  min[1] = sdf->origin[1] + (float)y * brick_size;
+  min[2] = sdf->origin[2] + (float)z * brick_size;
+
+  glm_vec3_adds(min, brick_size, max);
+}
+
+// Gathers the triangles within band of a brick, growing the candidate buffer as needed
+static uint32_t gather_brick_triangles(const struct BakeContext* context,
+                                       uint32_t brick,
+                                       uint32_t** triangles,
+                                       uint32_t* capacity)
+{
+  vec3 min, max;
+  get_brick_bounds(context->sdf, brick, min, max);
+  glm_vec3_adds(min, -context->sdf->band, min);
+  glm_vec3_adds(max, context->sdf->band, max);
+
+  uint32_t count = query_bvh(context->bvh, min, max, *triangles, *capacity);
+  if (count > *capacity)
+  {
+    uint32_t* new_triangles = realloc(*triangles, sizeof(uint32_t) * count);
+    if (!new_triangles)
+    {
+      return 0;
+    }
+
+    *triangles = new_triangles;
+    *capacity = count;
+    count = query_bvh(context->bvh, min, max, *triangles, *capacity);
+  }
+
+  // The BVH returns whole leaves, so only keep the triangles that actually overlap the box
+  uint32_t kept = 0;
+  for (uint32_t candidate = 0; candidate < count; ++candidate)
+  {
+    const uint32_t triangle = (*triangles)[candidate];
+    const float* triangle_min = context->mesh->mins[triangle];
+    const float* triangle_max = context->mesh->maxs[triangle];
+    if (triangle_min[0] <= max[0] && triangle_max[0] >= min[0] && triangle_min[1] <= max[1] &&
+        triangle_max[1] >= min[1] && triangle_min[2] <= max[2] && triangle_max[2] >= min[2])
+    {
+      (*triangles)[kept++] = triangle;
+    }
+  }
+
+  return kept;
+}
+
+static void find_near_bricks(void* data, uint32_t begin, uint32_t end)
+{
+  struct BakeContext* context = data;
+
+  uint32_t* triangles = NULL;
+  uint32_t capacity = 0;
+  for (uint32_t brick = begin; brick < end; ++brick)
+  {
+    context->near_surface[brick] = gather_brick_triangles(context, brick, &triangles, &capacity) > 0;
+  }
+
+  free(triangles);
+}
+
+// Calculates the signed distance from pos to the closest of the given triangles, clamped to the band
+static float get_signed_distance(const struct BakeContext* context,
+                                 const uint32_t* triangles,
+                                 uint32_t triangle_count,
+                                 vec3 pos)
+{
+  float best_dist_sq = FLT_MAX;
+  float best_side = 1.0f; // Distance along the normal of the closest triangle, which decides the sign
+
+  for (uint32_t index = 0; index < triangle_count; ++index)
+  {
+    vec3 v0, v1, v2, n;
+    get_collision_triangle(context->mesh, triangles[index], v0, v1, v2, n);
+
+    vec3 closest, d;
+    closest_point_on_triangle(pos, v0, v1, v2, closest);
+    glm_vec3_sub(pos, closest, d);
+
+    const float dist_sq = glm_vec3_dot(d, d);
+    const float side = glm_vec3_dot(d, n);
+
+    // Where triangles share the closest point (on an edge or vertex), the one facing pos most directly decides
+    if (dist_sq < best_dist_sq - 1e-8f || (dist_sq <= best_dist_sq + 1e-8f && fabsf(side) > fabsf(best_side)))
+    {
+      best_dist_sq = dist_sq;
+      best_side = side;
+    }
+  }
+
+  const float dist = glm_min(sqrtf(best_dist_sq), context->sdf->band);
+  return best_side < 0.0f ? -dist : dist;
+}
+
+static void bake_bricks(void* data, uint32_t begin, uint32_t end)
+{
+  struct BakeContext* context = data;
+  struct Sdf* sdf = context->sdf;
+
+  uint32_t* triangles = NULL;
+  uint32_t capacity = 0;
+  for (uint32_t brick = begin; brick < end; ++brick)
+  {
+    if (sdf->bricks[brick] < 0)
+    {
+      continue;
+    }
+
+    const uint32_t triangle_count = gather_brick_triangles(context, brick, &triangles, &capacity);
+
+    vec3 min, max;
+    get_brick_bounds(sdf, brick, min, max);
+
+    int16_t* samples = &sdf->samples[(size_t)sdf->bricks[brick] * SAMPLES_PER_BRICK];
+    for (uint32_t z = 0; z < SAMPLES_PER_AXIS; ++z)
+    {
+      for (uint32_t y = 0; y < SAMPLES_PER_AXIS; ++y)
+      {
+        for (uint32_t x = 0; x < SAMPLES_PER_AXIS; ++x)
+        {
+          vec3 pos = { min[0] + (float)x * sdf->voxel_size, min[1] + (float)y * sdf->voxel_size,
+                       min[2] + (float)z * sdf->voxel_size };
+
+          const float dist = get_signed_distance(context, triangles, triangle_count, pos);
+          samples[(z * SAMPLES_PER_AXIS + y) * SAMPLES_PER_AXIS + x] =
+            (int16_t)lroundf(dist / sdf->band * QUANTIZATION_SCALE);
+        }
+      }
+    }
+  }
+
+  free(triangles);
+}
+
+struct Sdf* make_sdf(const struct CollisionMesh* mesh, const struct Bvh* bvh, float voxel_size, float band)
+{
+  struct Sdf* sdf = malloc(sizeof(struct Sdf));
+  if (!sdf)
+  {
+    printf("Ran out of memory while generating SDF\n");
+    return NULL;
+  }
+
+  sdf->voxel_size = voxel_size;
+  sdf->band = band;
+  sdf->samples = NULL;
+  sdf->allocated_brick_count = 0;
+
+  // Cover the mesh bounds plus the band around them
+  {
+    vec3 min, max;
+    glm_vec3_fill(min, FLT_MAX);
+    glm_vec3_fill(max, -FLT_MAX);
+    for (uint32_t triangle = 0; triangle < mesh->triangle_count; ++triangle)
+    {
+      glm_vec3_minv(min, mesh->mins[triangle], min);
+      glm_vec3_maxv(max, mesh->maxs[triangle], max);
+    }
+
+    if (mesh->triangle_count == 0)
+    {
+      glm_vec3_zero(min);
+      glm_vec3_zero(max);
+    }
+
+    glm_vec3_adds(min, -band, sdf->origin);
+    glm_vec3_adds(max, band, max);
+
+    const float brick_size = voxel_size * SDF_BRICK_SIZE;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      const float extent = max[axis] - sdf->origin[axis];
+      sdf->brick_counts[axis] = (uint32_t)ceilf(extent / brick_size);
+      sdf->brick_counts[axis] = sdf->brick_counts[axis] > 0 ? sdf->brick_counts[axis] : 1;
+    }
+  }
+
+  const uint32_t brick_cell_count = get_brick_cell_count(sdf);
+  sdf->bricks = malloc(sizeof(int32_t) * brick_cell_count);
+  bool* near_surface = malloc(sizeof(bool) * brick_cell_count);
+  if (!sdf->bricks || !near_surface)
+  {
+    printf("Ran out of memory while generating SDF with %u bricks\n", brick_cell_count);
+    free(near_surface);
+    destroy_sdf(sdf);
+    return NULL;
+  }
+
+  struct BakeContext context = { mesh, bvh, sdf, near_surface };
+
+  // Only the bricks with triangles in reach of the band are allocated
+  parallel_for(brick_cell_count, 64, find_near_bricks, &context);
+
+  for (uint32_t brick = 0; brick < brick_cell_count; ++brick)
+  {
+    sdf->bricks[brick] = near_surface[brick] ? (int32_t)sdf->allocated_brick_count++ : -1;
+  }
+
+  free(near_surface);
+
+  const size_t samples_size = sizeof(int16_t) * SAMPLES_PER_BRICK * sdf->allocated_brick_count;
+  sdf->samples = malloc(samples_size > 0 ? samples_size : 1);
+  if (!sdf->samples)
+  {
+    printf("Ran out of memory while generating SDF, requested %zu bytes for samples\n", samples_size);
+    destroy_sdf(sdf);
+    return NULL;
+  }
+
+  parallel_for(brick_cell_count, 4, bake_bricks, &context);
+
+  printf("Baked SDF with %u of %u bricks allocated (%.1f MB) on %u threads\n", sdf->allocated_brick_count,
+         brick_cell_count, (double)samples_size / (1024.0 * 1024.0), get_job_thread_count());
+
+  return sdf;
+}
+
+void destroy_sdf(struct Sdf* sdf)
+{
+  free(sdf->bricks);
+  free(sdf->samples);
+  free(sdf);
+}
+
+float sample_sdf(const struct Sdf* sdf, const vec3 pos)
+{
+  // Find the voxel containing pos
+  int32_t cell[3];
+  float fraction[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    const float grid = (pos[axis] - sdf->origin[axis]) / sdf->voxel_size;
+    if (!(grid >= 0.0f && grid < (float)(sdf->brick_counts[axis] * SDF_BRICK_SIZE)))
+    {
+      return sdf->band;
+    }
+
+    cell[axis] = (int32_t)grid;
+    fraction[axis] = grid - (float)cell[axis];
+  }
+
+  const uint32_t brick_x = cell[0] / SDF_BRICK_SIZE;
+  const uint32_t brick_y = cell[1] / SDF_BRICK_SIZE;
+  const uint32_t brick_z = cell[2] / SDF_BRICK_SIZE;
+
+  const int32_t brick =
+    sdf->bricks[(brick_z * sdf->brick_counts[1] + brick_y) * sdf->brick_counts[0] + brick_x];
+  if (brick < 0)
+  {
+    return sdf->band;
+  }
+
+  const uint32_t x = cell[0] - brick_x * SDF_BRICK_SIZE;
+  const uint32_t y = cell[1] - brick_y * SDF_BRICK_SIZE;
+  const uint32_t z = cell[2] - brick_z * SDF_BRICK_SIZE;
+
+  // Trilinear interpolation, the brick border makes sure that all 8 samples are in the same brick
+  const int16_t* samples = &sdf->samples[(size_t)brick * SAMPLES_PER_BRICK];
+  const int16_t* s = &samples[(z * SAMPLES_PER_AXIS + y) * SAMPLES_PER_AXIS + x];
+
+  const uint32_t dy = SAMPLES_PER_AXIS;
+  const uint32_t dz = SAMPLES_PER_AXIS * SAMPLES_PER_AXIS;
+
+  const float x00 = glm_lerp(s[0], s[1], fraction[0]);
+  const float x10 = glm_lerp(s[dy], s[dy + 1], fraction[0]);
+  const float x01 = glm_lerp(s[dz], s[dz + 1], fraction[0]);
+  const float x11 = glm_lerp(s[dz + dy], s[dz + dy + 1], fraction[0]);
+
+  const float y0 = glm_lerp(x00, x10, fraction[1]);
+  const float y1 = glm_lerp(x01, x11, fraction[1]);
+
+  return glm_lerp(y0, y1, fraction[2]) * (sdf->band / QUANTIZATION_SCALE);
+}
+
+void get_sdf_normal(const struct Sdf* sdf, const vec3 pos, vec3 normal)
+{
+  // Central differences
+  const float h = sdf->voxel_size * 0.5f;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    vec3 a, b;
+    glm_vec3_copy((float*)pos, a);
+    glm_vec3_copy((float*)pos, b);
+    a[axis] += h;
+    b[axis] -= h;
+
+    normal[axis] = sample_sdf(sdf, a) - sample_sdf(sdf, b);
+  }
+
+  if (glm_vec3_norm2(normal) > 0.0f)
+  {
+    glm_vec3_normalize(normal);
+  }
+  else
+  {
+    glm_vec3_copy(GLM_YUP, normal);
+  }
+}
+
+// Returns the smallest distance along the axis of a capsule, and the point on the axis where it was found
+static float get_capsule_axis_distance(const struct Sdf* sdf,
+                                       vec3 capsule_base,
+                                       vec3 capsule_tip,
+                                       float capsule_radius,
+                                       vec3 closest_pos)
+{
+  // The centers of the end spheres
+  vec3 a, b;
+  {
+    vec3 axis;
+    glm_vec3_sub(capsule_tip, capsule_base, axis);
+
+    const float length = glm_vec3_norm(axis);
+    if (length > 2.0f * capsule_radius)
+    {
+      glm_vec3_scale(axis, capsule_radius / length, axis);
+      glm_vec3_add(capsule_base, axis, a);
+      glm_vec3_sub(capsule_tip, axis, b);
+    }
+    else
+    {
+      // Too short for two spheres, fall back to a single one in the middle
+      glm_vec3_center(capsule_base, capsule_tip, a);
+      glm_vec3_copy(a, b);
+    }
+  }
+
+  // Find the point on the axis closest to the surface, sampling at least once per voxel
+  const uint32_t sample_count = (uint32_t)ceilf(glm_vec3_distance(a, b) / sdf->voxel_size) + 1;
+
+  float best_dist = FLT_MAX;
+  for (uint32_t sample = 0; sample < sample_count; ++sample)
+  {
+    const float t = sample_count > 1 ? (float)sample / (float)(sample_count - 1) : 0.0f;
+
+    vec3 pos;
+    glm_vec3_lerp(a, b, t, pos);
+
+    const float dist = sample_sdf(sdf, pos);
+    if (dist < best_dist)
+    {
+      best_dist = dist;
+      glm_vec3_copy(pos, closest_pos);
+    }
+  }
+
+  return best_dist;
+}
+
+bool capsule_sdf_collision(const struct Sdf* sdf,
+                           vec3 capsule_base,
+                           vec3 capsule_tip,
+                           float capsule_radius,
+                           vec3 pen_normal,
+                           float* pen_depth)
+{
+  vec3 closest_pos;
+  const float dist = get_capsule_axis_distance(sdf, capsule_base, capsule_tip, capsule_radius, closest_pos);
+  if (dist >= capsule_radius)
+  {
+    return false;
+  }
+
+  get_sdf_normal(sdf, closest_pos, pen_normal);
+  *pen_depth = capsule_radius - dist;
+
+  return true;
+}
+
+bool capsule_sdf_sweep(const struct Sdf* sdf,
+                       vec3 capsule_base,
+                       vec3 capsule_tip,
+                       float capsule_radius,
+                       vec3 motion,
+                       float skin,
+                       float* toi,
+                       vec3 hit_normal)
+{
+  const float motion_length = glm_vec3_norm(motion);
+  if (motion_length <= 0.0f)
+  {
+    return false;
+  }
+
+  // Conservative advancement, the capsule only translates so it can not get closer than motion_length per unit of t
+  // Surfaces within skin that the capsule is not moving towards are stepped past, so that it can slide along them
+  const float min_step = sdf->voxel_size * 0.25f / motion_length;
+
+  float t = 0.0f, safe_t = 0.0f;
+  vec3 closest_pos;
+  for (uint32_t step = 0; step < MAX_CAST_STEPS; ++step)
+  {
+    vec3 base, tip;
+    glm_vec3_copy(capsule_base, base);
+    glm_vec3_muladds(motion, t, base);
+    glm_vec3_copy(capsule_tip, tip);
+    glm_vec3_muladds(motion, t, tip);
+
+    const float gap = get_capsule_axis_distance(sdf, base, tip, capsule_radius, closest_pos) - capsule_radius - skin;
+    if (gap <= SWEEP_TOLERANCE)
+    {
+      vec3 normal;
+      get_sdf_normal(sdf, closest_pos, normal);
+      if (glm_vec3_dot(normal, motion) < 0.0f)
+      {
+        *toi = t;
+        glm_vec3_copy(normal, hit_normal);
+        return true;
+      }
+    }
+
+    safe_t = t;
+    t += glm_max(gap / motion_length, min_step);
+    if (t > 1.0f)
+    {
+      return false;
+    }
+  }
+
+  // Ran out of steps, which happens when grazing thin geometry, so stop where the capsule was last seen clear rather
+  // than letting it move through
+  *toi = safe_t;
+  get_sdf_normal(sdf, closest_pos, hit_normal);
+  return true;
+}
+
+bool sphere_cast_sdf(const struct Sdf* sdf,
+                     vec3 origin,
+                     vec3 dir,
+                     float radius,
+                     float max_dist,
+                     float* hit_dist,
+                     vec3 hit_normal)
+{
+  // Sphere tracing, with a minimum step so that it keeps moving along grazing surfaces
+  const float min_step = sdf->voxel_size * 0.25f;
+  const float epsilon = sdf->voxel_size * 0.05f;
+
+  float t = 0.0f, safe_t = 0.0f;
+  vec3 pos;
+  for (uint32_t step = 0; step < MAX_CAST_STEPS; ++step)
+  {
+    glm_vec3_copy(origin, pos);
+    glm_vec3_muladds(dir, t, pos);
+
+    const float dist = sample_sdf(sdf, pos) - radius;
+    if (dist <= epsilon)
+    {
+      *hit_dist = t;
+      get_sdf_normal(sdf, pos, hit_normal);
+      return true;
+    }
+
+    safe_t = t;
+    t += glm_max(dist, min_step);
+    if (t > max_dist)
+    {
+      return false;
+    }
+  }
+
+  // Out of steps before max_dist, so stop where the sphere was last clear rather than pass through
+  *hit_dist = safe_t;
+  get_sdf_normal(sdf, pos, hit_normal);
+  return true;
+}
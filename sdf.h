@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cglm/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SDF_BRICK_SIZE 8 // Voxels per brick along each axis
+
+struct Bvh;
+struct CollisionMesh;
+
+// Sparse signed distance field, stored in bricks that are only allocated close to the surface
+struct Sdf
+{
+  vec3 origin; // Position of the first sample
+  float voxel_size;
+  float band; // Distances are only stored up to this far from the surface, anything further away reads as band
+  uint32_t brick_counts[3];
+  int32_t* bricks;  // Index of the allocated brick per brick cell, or -1 if there is no surface nearby
+  int16_t* samples; // (SDF_BRICK_SIZE + 1)^3 quantized distances per allocated brick, including the shared border
+  uint32_t allocated_brick_count;
+};
+
+// Bakes the distance field of a collision mesh in parallel, the BVH is used to find the triangles near each brick
+struct Sdf* make_sdf(const struct CollisionMesh* mesh, const struct Bvh* bvh, float voxel_size, float band);
+void destroy_sdf(struct Sdf* sdf);
+
+float sample_sdf(const struct Sdf* sdf, const vec3 pos);
+void get_sdf_normal(const struct Sdf* sdf, const vec3 pos, vec3 normal);
+
+bool capsule_sdf_collision(const struct Sdf* sdf,
+                           vec3 capsule_base,
+                           vec3 capsule_tip,
+                           float capsule_radius,
+                           vec3 pen_normal,
+                           float* pen_depth);
+
+// Moves a capsule by up to motion until it comes within skin of a surface it is moving towards
+// Returns whether it does, and if so the fraction of motion until then and the surface normal there
+// Also stops where the capsule was last clear when the march runs out of steps, so that it never tunnels
+bool capsule_sdf_sweep(const struct Sdf* sdf,
+                       vec3 capsule_base,
+                       vec3 capsule_tip,
+                       float capsule_radius,
+                       vec3 motion,
+                       float skin,
+                       float* toi,
+                       vec3 hit_normal);
+
+// Marches a sphere from origin along the normalized direction dir
+// Returns whether it touches the surface within max_dist, and if so the distance travelled until then and the surface
+// normal there, also stops where the sphere was last clear when the march runs out of steps
+bool sphere_cast_sdf(const struct Sdf* sdf,
+                     vec3 origin,
+                     vec3 dir,
+                     float radius,
+                     float max_dist,
+                     float* hit_dist,
+                     vec3 hit_normal);
@@ -1,46 +1,106 @@
 #include "shader.h"
 
+#include "cooked_file.h"
+
+#include <glfw/glfw3.h>
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define SHADER_LOG_SIZE 512
 
-bool load_shader(const char* filename, GLenum type, GLuint* shader)
+#define CACHE_MAGIC 0x47525043 // "CPRG" when read as little-endian
+#define CACHE_VERSION 2
+#define CACHE_EXTENSION ".program"
+
+#define MAX_SHADER_PROGRAM_COUNT 16
+
+// From ARB_get_program_binary, which is core since OpenGL 4.1 but not in the 3.3 loader
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+typedef void(GLAD_API_PTR* GetProgramBinaryFunction)(GLuint program, GLsizei buffer_size, GLsizei* length,
+                                                     GLenum* binary_format, void* binary);
+typedef void(GLAD_API_PTR* ProgramBinaryFunction)(GLuint program, GLenum binary_format, const void* binary,
+                                                  GLsizei length);
+typedef void(GLAD_API_PTR* ProgramParameteriFunction)(GLuint program, GLenum pname, GLint value);
+
+// At the start of every cache file, followed by the program binary
+struct CacheHeader
+{
+  struct CookedFileHeader common;
+
+  uint64_t source_hash; // Of both shaders, the cache is stale once either changes
+  uint64_t driver_hash; // Of the vendor, renderer and version strings, binaries only load on the driver that made them
+
+  uint32_t binary_format;
+  uint32_t binary_size;
+};
+
+static GetProgramBinaryFunction get_program_binary = NULL; // All three NULL without driver support
+static ProgramBinaryFunction program_binary = NULL;
+static ProgramParameteriFunction program_parameteri = NULL;
+static uint64_t driver_hash;
+static bool binaries_checked = false;
+
+static struct ShaderProgram* programs[MAX_SHADER_PROGRAM_COUNT]; // All live ones, for reloading
+static uint32_t program_count = 0;
+
+static uint64_t hash_string(uint64_t hash, const GLubyte* string)
+{
+  return string ? hash_data(hash, string, strlen((const char*)string) + 1) : hash;
+}
+
+static void check_program_binaries()
 {
-  FILE* file = fopen(filename, "rb");
-  if (!file)
+  if (binaries_checked)
   {
-    printf("Failed to load shader \"%s\"\n", filename);
-    return false;
+    return;
   }
 
-  fseek(file, 0, SEEK_END);
-  GLint length = (GLint)ftell(file);
-  if (length <= 0)
+  binaries_checked = true;
+
+  if (!glfwExtensionSupported("GL_ARB_get_program_binary"))
   {
-    printf("Shader \"%s\" has unexpected length %d\n", filename, length);
-    fclose(file);
-    return false;
+    printf("Program binaries are not supported, shaders are compiled on every start\n");
+    return;
   }
 
-  fseek(file, 0, SEEK_SET);
+  // Drivers may support the extension without any format that can be saved
+  GLint format_count = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+  if (format_count <= 0)
+  {
+    printf("Program binaries are not supported, shaders are compiled on every start\n");
+    return;
+  }
 
-  GLchar* source = malloc(length);
-  if (!source)
+  get_program_binary = (GetProgramBinaryFunction)glfwGetProcAddress("glGetProgramBinary");
+  program_binary = (ProgramBinaryFunction)glfwGetProcAddress("glProgramBinary");
+  program_parameteri = (ProgramParameteriFunction)glfwGetProcAddress("glProgramParameteri");
+  if (!get_program_binary || !program_binary || !program_parameteri)
   {
-    printf("Ran out of memory while loading shader \"%s\", requested %d bytes for source", filename, length);
-    fclose(file);
-    return false;
+    get_program_binary = NULL;
+    program_binary = NULL;
+    program_parameteri = NULL;
+    return;
   }
 
-  fread(source, length, 1, file);
-  fclose(file);
+  driver_hash = HASH_SEED;
+  driver_hash = hash_string(driver_hash, glGetString(GL_VENDOR));
+  driver_hash = hash_string(driver_hash, glGetString(GL_RENDERER));
+  driver_hash = hash_string(driver_hash, glGetString(GL_VERSION));
+}
 
+static bool compile_shader(const char* filename, const struct MappedFile* source, GLenum type, GLuint* shader)
+{
   *shader = glCreateShader(type);
 
-  const GLchar* sources[] = { source };
+  const GLchar* sources[] = { source->data };
+  const GLint length = (GLint)source->size;
   glShaderSource(*shader, 1, sources, &length);
-  free(source);
 
   glCompileShader(*shader);
 
@@ -50,61 +110,302 @@ bool load_shader(const char* filename, GLenum type, GLuint* shader)
   {
     GLchar log[SHADER_LOG_SIZE];
     glGetShaderInfoLog(*shader, SHADER_LOG_SIZE, NULL, log);
-    printf("Failed to compile shader:\n%s", log);
+    printf("Failed to compile shader \"%s\":\n%s", filename, log);
+    glDeleteShader(*shader);
     return false;
   }
 
   return true;
 }
 
-void destroy_shader(GLuint shader_program)
+// Returns 0 when there is no cache that is up to date and loads on this driver
+static GLuint load_cached_program(const char* cache_filename, uint64_t source_hash)
 {
-  glDeleteProgram(shader_program);
+  struct MappedFile file;
+  if (!map_cooked_file(cache_filename, sizeof(struct CacheHeader), CACHE_MAGIC, CACHE_VERSION, &file))
+  {
+    return 0;
+  }
+
+  const struct CacheHeader* header = file.data;
+  if (header->source_hash != source_hash || header->driver_hash != driver_hash ||
+      file.size - sizeof(struct CacheHeader) != header->binary_size)
+  {
+    unmap_file(&file);
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  program_binary(program, header->binary_format, header + 1, (GLsizei)header->binary_size);
+  unmap_file(&file);
+
+  // Drivers reject binaries of their own after an update as well, in which case the program is compiled again
+  GLint success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success)
+  {
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  return program;
 }
 
-bool generate_shader_program(GLuint vertex_shader, GLuint fragment_shader, GLuint* shader_program)
+static void write_cached_program(const char* cache_filename, uint64_t source_hash, GLuint program)
 {
-  *shader_program = glCreateProgram();
-  glAttachShader(*shader_program, vertex_shader);
-  glAttachShader(*shader_program, fragment_shader);
+  GLint binary_size = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_size);
+  if (binary_size <= 0)
+  {
+    return;
+  }
 
-  glLinkProgram(*shader_program);
+  struct CacheHeader* header = malloc(sizeof(struct CacheHeader) + (size_t)binary_size);
+  if (!header)
+  {
+    printf("Ran out of memory while caching shader program \"%s\"\n", cache_filename);
+    return;
+  }
+
+  GLenum binary_format;
+  GLsizei length = 0;
+  get_program_binary(program, binary_size, &length, &binary_format, header + 1);
+
+  const size_t size = sizeof(struct CacheHeader) + (size_t)length;
+  header->common.magic = CACHE_MAGIC;
+  header->common.version = CACHE_VERSION;
+  header->common.file_size = size;
+  header->source_hash = source_hash;
+  header->driver_hash = driver_hash;
+  header->binary_format = binary_format;
+  header->binary_size = (uint32_t)length;
+
+  // A cache that cannot be written only costs the compile on the next start
+  write_file(cache_filename, header, size);
+
+  free(header);
+}
+
+static GLuint compile_program(const struct ShaderProgram* shader_program,
+                              const struct MappedFile* vertex_source,
+                              const struct MappedFile* fragment_source)
+{
+  GLuint vertex_shader, fragment_shader;
+  if (!compile_shader(shader_program->vertex_filename, vertex_source, GL_VERTEX_SHADER, &vertex_shader))
+  {
+    return 0;
+  }
+
+  if (!compile_shader(shader_program->fragment_filename, fragment_source, GL_FRAGMENT_SHADER, &fragment_shader))
+  {
+    glDeleteShader(vertex_shader);
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+
+  if (program_parameteri)
+  {
+    program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+
+  glLinkProgram(program);
 
   glDeleteShader(vertex_shader);
   glDeleteShader(fragment_shader);
 
   GLint success;
-  glGetProgramiv(*shader_program, GL_LINK_STATUS, &success);
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
   if (!success)
   {
     GLchar log[SHADER_LOG_SIZE];
-    glGetProgramInfoLog(*shader_program, SHADER_LOG_SIZE, NULL, log);
-    printf("Failed to link shader program:\n%s", log);
+    glGetProgramInfoLog(program, SHADER_LOG_SIZE, NULL, log);
+    printf("Failed to link shader program \"%s\", \"%s\":\n%s", shader_program->vertex_filename,
+           shader_program->fragment_filename, log);
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  return program;
+}
+
+// Maps both sources of the program, returns false without a message if either is missing or empty for the moment
+static bool map_sources(const struct ShaderProgram* shader_program,
+                        struct MappedFile* vertex_source,
+                        struct MappedFile* fragment_source)
+{
+  if (!map_file(shader_program->vertex_filename, vertex_source))
+  {
+    return false;
+  }
+
+  if (!map_file(shader_program->fragment_filename, fragment_source))
+  {
+    unmap_file(vertex_source);
     return false;
   }
 
   return true;
 }
 
-GLint get_uniform_location(GLuint shader_program, const char* name)
+static uint64_t hash_sources(const struct MappedFile* vertex_source, const struct MappedFile* fragment_source)
 {
-  GLint uniform_location = glGetUniformLocation(shader_program, name);
-  if (shader_program < 0)
+  // The length of the vertex shader keeps sources that only move text from one to the other apart
+  uint64_t source_hash = HASH_SEED;
+  source_hash = hash_data(source_hash, &vertex_source->size, sizeof(vertex_source->size));
+  source_hash = hash_data(source_hash, vertex_source->data, vertex_source->size);
+  return hash_data(source_hash, fragment_source->data, fragment_source->size);
+}
+
+// Links the program from the given sources with the given hash, from the cache if possible, and looks up its uniforms
+// Leaves the program as it was when this fails, but remembers the hash of the sources either way, so that the same
+// sources are not tried again
+static bool link_shader_program(struct ShaderProgram* shader_program,
+                                const struct MappedFile* vertex_source,
+                                const struct MappedFile* fragment_source,
+                                uint64_t source_hash)
+{
+  shader_program->source_hash = source_hash;
+
+  char cache_filename[MAX_COOKED_FILENAME_LENGTH];
+  if (!get_cooked_filename(shader_program->vertex_filename, CACHE_EXTENSION, cache_filename))
+  {
+    return false;
+  }
+
+  GLuint program = get_program_binary ? load_cached_program(cache_filename, source_hash) : 0;
+  if (!program)
   {
-    printf("Failed to get uniform location for %s", name);
+    program = compile_program(shader_program, vertex_source, fragment_source);
+    if (program && get_program_binary)
+    {
+      write_cached_program(cache_filename, source_hash, program);
+    }
   }
 
-  return uniform_location;
+  if (!program)
+  {
+    return false;
+  }
+
+  if (shader_program->program)
+  {
+    glDeleteProgram(shader_program->program);
+  }
+
+  shader_program->program = program;
+
+  for (uint32_t uniform = 0; uniform < shader_program->uniform_count; ++uniform)
+  {
+    shader_program->uniform_locations[uniform] = glGetUniformLocation(program, shader_program->uniform_names[uniform]);
+  }
+
+  const GLuint frame_block = glGetUniformBlockIndex(program, FRAME_UNIFORM_BLOCK);
+  if (frame_block != GL_INVALID_INDEX)
+  {
+    glUniformBlockBinding(program, frame_block, FRAME_UNIFORM_BINDING);
+  }
+
+  return true;
 }
 
-void set_uniform_i(GLuint shader_program, const char* name, int value)
+struct ShaderProgram* make_shader_program(const char* vertex_filename,
+                                          const char* fragment_filename,
+                                          const char* const* uniform_names,
+                                          uint32_t uniform_count)
 {
-  const GLint uniform_location = get_uniform_location(shader_program, name);
-  glUniform1i(uniform_location, value);
+  if (uniform_count > MAX_PROGRAM_UNIFORMS)
+  {
+    printf("Shader program \"%s\", \"%s\" has %u uniforms, at most %u are supported\n", vertex_filename,
+           fragment_filename, uniform_count, MAX_PROGRAM_UNIFORMS);
+    return NULL;
+  }
+
+  if (program_count == MAX_SHADER_PROGRAM_COUNT)
+  {
+    printf("Too many shader programs, at most %u are supported\n", MAX_SHADER_PROGRAM_COUNT);
+    return NULL;
+  }
+
+  check_program_binaries();
+
+  struct ShaderProgram* shader_program = malloc(sizeof(struct ShaderProgram));
+  if (!shader_program)
+  {
+    printf("Ran out of memory while making shader program \"%s\", \"%s\"\n", vertex_filename, fragment_filename);
+    return NULL;
+  }
+
+  shader_program->program = 0;
+  shader_program->vertex_filename = vertex_filename;
+  shader_program->fragment_filename = fragment_filename;
+  shader_program->uniform_names = uniform_names;
+  shader_program->uniform_count = uniform_count;
+
+  struct MappedFile vertex_source, fragment_source;
+  if (!map_sources(shader_program, &vertex_source, &fragment_source))
+  {
+    printf("Failed to load shader program \"%s\", \"%s\"\n", vertex_filename, fragment_filename);
+    free(shader_program);
+    return NULL;
+  }
+
+  const bool linked = link_shader_program(shader_program, &vertex_source, &fragment_source,
+                                          hash_sources(&vertex_source, &fragment_source));
+  unmap_file(&vertex_source);
+  unmap_file(&fragment_source);
+  if (!linked)
+  {
+    free(shader_program);
+    return NULL;
+  }
+
+  programs[program_count++] = shader_program;
+
+  return shader_program;
+}
+
+void destroy_shader_program(struct ShaderProgram* shader_program)
+{
+  for (uint32_t index = 0; index < program_count; ++index)
+  {
+    if (programs[index] == shader_program)
+    {
+      programs[index] = programs[--program_count];
+      break;
+    }
+  }
+
+  glDeleteProgram(shader_program->program);
+  free(shader_program);
 }
 
-void set_uniform_vec4(GLuint shader_program, const char* name, const vec4 value)
+void reload_changed_shader_programs()
 {
-  const GLint uniform_location = get_uniform_location(shader_program, name);
-  glUniform4fv(uniform_location, 1, value);
+  for (uint32_t index = 0; index < program_count; ++index)
+  {
+    struct ShaderProgram* shader_program = programs[index];
+
+    // Sources that are missing or empty for the moment, while an editor saves them, count as unchanged
+    struct MappedFile vertex_source, fragment_source;
+    if (!map_sources(shader_program, &vertex_source, &fragment_source))
+    {
+      continue;
+    }
+
+    // By contents rather than modification times, which some file systems only keep to the second, so that every
+    // save is picked up, also right after one that failed to compile
+    const uint64_t source_hash = hash_sources(&vertex_source, &fragment_source);
+    if (source_hash != shader_program->source_hash &&
+        link_shader_program(shader_program, &vertex_source, &fragment_source, source_hash))
+    {
+      printf("Reloaded shader program \"%s\", \"%s\"\n", shader_program->vertex_filename,
+             shader_program->fragment_filename);
+    }
+
+    unmap_file(&vertex_source);
+    unmap_file(&fragment_source);
+  }
 }
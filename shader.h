@@ -1,16 +1,42 @@
 #pragma once
 
-#include <cglm/types.h>
-
 #include <glad/gl.h>
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#define MAX_PROGRAM_UNIFORMS 16
+
+// Uniform block of per-frame data that every program shares, bound to the buffer of the render queue
+#define FRAME_UNIFORM_BLOCK "Frame"
+#define FRAME_UNIFORM_BINDING 0
+
+// A linked vertex and fragment shader, with the locations of its uniforms looked up once whenever it is linked
+// Linked programs are cached next to their vertex shader as <vertex_filename>.program, so each vertex shader is used
+// by one program only
+struct ShaderProgram
+{
+  GLuint program;
+  GLint uniform_locations[MAX_PROGRAM_UNIFORMS]; // In the order of the names the program was made with
+
+  const char* vertex_filename;
+  const char* fragment_filename;
+  const char* const* uniform_names;
+  uint32_t uniform_count;
 
-bool load_shader(const char* filename, GLenum type, GLuint* shader);
-void destroy_shader(GLuint shader_program);
+  uint64_t source_hash; // Of the sources when they were last tried, whether or not they compiled
+};
 
-bool generate_shader_program(GLuint vertex_shader, GLuint fragment_shader, GLuint* shader_program);
+// Loads the program from its cache if the driver supports program binaries and the cache was written by the same
+// driver from the same sources, and otherwise compiles and links the sources and writes the cache
+// The filenames and uniform names have to outlive the program, uniforms that are not used by the shaders get -1
+struct ShaderProgram* make_shader_program(const char* vertex_filename,
+                                          const char* fragment_filename,
+                                          const char* const* uniform_names,
+                                          uint32_t uniform_count);
+void destroy_shader_program(struct ShaderProgram* program);
 
-GLint get_uniform_location(GLuint shader_program, const char* name);
-void set_uniform_i(GLuint shader_program, const char* name, int value);
-void set_uniform_vec4(GLuint shader_program, const char* name, const vec4 value);
+// Relinks the programs whose sources have been changed on disk since, a program that fails to compile or link keeps
+// the last one that worked, call from the main thread
+// The programs and their uniform locations change, so anything that was set on them has to be set again
+void reload_changed_shader_programs();
@@ -0,0 +1,19 @@
+#version 330 core
+
+layout(std140) uniform Frame // Shared by all programs, see render_queue.c
+{
+  mat4 viewproj;
+};
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec4 in_color;
+layout(location = 2) in vec3 in_center; // Per instance, zero for lines
+layout(location = 3) in vec3 in_scale;  // Per instance, one for lines
+
+out vec4 color;
+
+void main()
+{
+  gl_Position = viewproj * vec4(in_center + in_scale * in_position, 1.0);
+  color = in_color;
+}
@@ -1,21 +1,41 @@
 #version 330 core
 
-uniform mat4 viewproj;
+uniform mat4 world; // Identity for the static level
 
-layout(location = 0) in vec3 in_position;
-layout(location = 1) in vec3 in_normal;
+layout(std140) uniform Frame // Shared by all programs, see render_queue.c
+{
+  mat4 viewproj;
+};
+
+// Decode packed vertices, identity and false for float vertices
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+uniform bool packed_normals;
+
+layout(location = 0) in vec3 in_position; // Normalized to the bounds when packed
+layout(location = 1) in vec3 in_normal;   // Only x and y are set when packed, as octahedral coordinates
 layout(location = 2) in vec2 in_uv;
 
 out vec3 pos; // In world space
 out vec3 normal;
 out vec2 uv;
 
+vec3 decode_octahedral(vec2 encoded)
+{
+  vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+  float fold = max(-n.z, 0.0); // Unfolds the lower half of the octahedron
+  n.xy += vec2(n.x >= 0.0 ? -fold : fold, n.y >= 0.0 ? -fold : fold);
+  return normalize(n);
+}
+
 void main()
 {
-  normal = in_normal;
+  vec3 local_normal = packed_normals ? decode_octahedral(in_normal.xy) : in_normal;
+  normal = mat3(world) * local_normal; // Rotation and translation only
   uv = in_uv;
 
-  pos = in_position;
+  vec3 local_pos = position_offset + in_position * position_scale;
+  pos = (world * vec4(local_pos, 1.0)).xyz;
 
   gl_Position = viewproj * vec4(pos, 1.0);
 }
\ No newline at end of file
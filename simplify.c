@@ -0,0 +1,495 @@
+#include "simplify.h"
+
+#include "geometry_data.h"
+#include "mesh_optimizer.h"
+
+#include <cglm/vec3.h>
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A level of detail has to have at most this fraction of the indices of the previous one
+#define LOD_MIN_REDUCTION 0.75f
+
+// Sum of squared distances to a set of weighted planes: v^T A v + 2 b^T v + c, with the symmetric A in its upper half
+struct Quadric
+{
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+  double weight;
+};
+
+struct Collapse
+{
+  uint32_t from, to;
+  float cost;
+};
+
+// All the arrays that simplify works with
+struct Simplification
+{
+  const float* vertices;
+  uint32_t floats_per_vertex;
+
+  struct Quadric* quadrics;
+  bool* locked;                // Vertices on borders
+  bool* touched;               // Vertices that already took part in a collapse of the current pass
+  uint32_t* remap;             // The vertex each vertex has collapsed onto, itself if it has not
+  uint32_t* adjacency_starts;  // Offset of the first triangle of each vertex in adjacency, and the total at the end
+  uint32_t* adjacency;         // Triangles of each vertex
+  struct Collapse* collapses;
+};
+
+static const float* get_position(const struct Simplification* simplification, uint32_t vertex)
+{
+  return &simplification->vertices[vertex * simplification->floats_per_vertex];
+}
+
+static void add_plane(struct Quadric* quadric, const vec3 normal, float distance, float weight)
+{
+  const double x = normal[0], y = normal[1], z = normal[2], d = distance, w = weight;
+  quadric->a00 += w * x * x;
+  quadric->a01 += w * x * y;
+  quadric->a02 += w * x * z;
+  quadric->a11 += w * y * y;
+  quadric->a12 += w * y * z;
+  quadric->a22 += w * z * z;
+  quadric->b0 += w * x * d;
+  quadric->b1 += w * y * d;
+  quadric->b2 += w * z * d;
+  quadric->c += w * d * d;
+  quadric->weight += w;
+}
+
+static void add_quadric(struct Quadric* quadric, const struct Quadric* other)
+{
+  quadric->a00 += other->a00;
+  quadric->a01 += other->a01;
+  quadric->a02 += other->a02;
+  quadric->a11 += other->a11;
+  quadric->a12 += other->a12;
+  quadric->a22 += other->a22;
+  quadric->b0 += other->b0;
+  quadric->b1 += other->b1;
+  quadric->b2 += other->b2;
+  quadric->c += other->c;
+  quadric->weight += other->weight;
+}
+
+// Returns the weighted mean of the squared distances of the position to the planes of both quadrics
+static float get_collapse_cost(const struct Quadric* a, const struct Quadric* b, const float* position)
+{
+  struct Quadric sum = *a;
+  add_quadric(&sum, b);
+
+  const double x = position[0], y = position[1], z = position[2];
+  const double squared_distance = sum.a00 * x * x + sum.a11 * y * y + sum.a22 * z * z +
+                                  2.0 * (sum.a01 * x * y + sum.a02 * x * z + sum.a12 * y * z) +
+                                  2.0 * (sum.b0 * x + sum.b1 * y + sum.b2 * z) + sum.c;
+
+  return sum.weight > 0.0 ? (float)fmax(squared_distance / sum.weight, 0.0) : 0.0f;
+}
+
+static float get_triangle_normal(const struct Simplification* simplification,
+                                 uint32_t a,
+                                 uint32_t b,
+                                 uint32_t c,
+                                 vec3 normal)
+{
+  vec3 edge_a, edge_b;
+  glm_vec3_sub((float*)get_position(simplification, b), (float*)get_position(simplification, a), edge_a);
+  glm_vec3_sub((float*)get_position(simplification, c), (float*)get_position(simplification, a), edge_b);
+  glm_vec3_cross(edge_a, edge_b, normal);
+
+  const float length = glm_vec3_norm(normal);
+  if (length > 0.0f)
+  {
+    glm_vec3_scale(normal, 1.0f / length, normal);
+  }
+
+  return length * 0.5f; // Area
+}
+
+// Adds the plane of each triangle to the quadrics of its vertices, weighted by its area, and locks the vertices of
+// every edge that is not shared with a triangle that runs along it the other way
+static void init_simplification(struct Simplification* simplification,
+                                const uint32_t* indices,
+                                uint32_t index_count,
+                                uint32_t vertex_count)
+{
+  uint32_t* starts = simplification->adjacency_starts;
+  uint32_t* edges = simplification->adjacency; // The outgoing edges of each vertex for now, triangles later
+  memset(starts, 0, sizeof(uint32_t) * (vertex_count + 1));
+  for (uint32_t index = 0; index < index_count; ++index)
+  {
+    ++starts[indices[index] + 1];
+  }
+
+  for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+  {
+    starts[vertex + 1] += starts[vertex];
+  }
+
+  // Fill with the remap as the write cursors, it is reset afterwards
+  memset(simplification->remap, 0, sizeof(uint32_t) * vertex_count);
+  for (uint32_t index = 0; index < index_count; ++index)
+  {
+    const uint32_t from = indices[index];
+    const uint32_t to = indices[index % 3 == 2 ? index - 2 : index + 1];
+    edges[starts[from] + simplification->remap[from]++] = to;
+  }
+
+  for (uint32_t index = 0; index < index_count; ++index)
+  {
+    const uint32_t from = indices[index];
+    const uint32_t to = indices[index % 3 == 2 ? index - 2 : index + 1];
+
+    bool shared = false;
+    for (uint32_t edge = starts[to]; edge < starts[to + 1] && !shared; ++edge)
+    {
+      shared = edges[edge] == from;
+    }
+
+    if (!shared)
+    {
+      simplification->locked[from] = true;
+      simplification->locked[to] = true;
+    }
+  }
+
+  for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+  {
+    simplification->remap[vertex] = vertex;
+  }
+
+  for (uint32_t index = 0; index < index_count; index += 3)
+  {
+    vec3 normal;
+    const float area =
+      get_triangle_normal(simplification, indices[index], indices[index + 1], indices[index + 2], normal);
+    const float distance = -glm_vec3_dot(normal, (float*)get_position(simplification, indices[index]));
+    for (uint32_t corner = 0; corner < 3; ++corner)
+    {
+      add_plane(&simplification->quadrics[indices[index + corner]], normal, distance, area);
+    }
+  }
+}
+
+static int compare_collapses(const void* a, const void* b)
+{
+  const struct Collapse* collapse_a = a;
+  const struct Collapse* collapse_b = b;
+  if (collapse_a->cost != collapse_b->cost)
+  {
+    return collapse_a->cost < collapse_b->cost ? -1 : 1;
+  }
+
+  return collapse_a->from < collapse_b->from ? -1 : (collapse_a->from > collapse_b->from ? 1 : 0);
+}
+
+// Returns the cheaper direction to collapse each edge in, sorted by cost, skipping edges that can not be collapsed
+static uint32_t find_collapses(struct Simplification* simplification, const uint32_t* indices, uint32_t index_count)
+{
+  uint32_t collapse_count = 0;
+  for (uint32_t index = 0; index < index_count; ++index)
+  {
+    // Every edge inside the mesh runs both ways, once in each of its triangles
+    const uint32_t a = indices[index];
+    const uint32_t b = indices[index % 3 == 2 ? index - 2 : index + 1];
+    if (a >= b || (simplification->locked[a] && simplification->locked[b]))
+    {
+      continue;
+    }
+
+    struct Collapse* collapse = &simplification->collapses[collapse_count++];
+    const float cost_to_b = simplification->locked[a]
+                              ? FLT_MAX
+                              : get_collapse_cost(&simplification->quadrics[a], &simplification->quadrics[b],
+                                                  get_position(simplification, b));
+    const float cost_to_a = simplification->locked[b]
+                              ? FLT_MAX
+                              : get_collapse_cost(&simplification->quadrics[a], &simplification->quadrics[b],
+                                                  get_position(simplification, a));
+
+    collapse->from = cost_to_b <= cost_to_a ? a : b;
+    collapse->to = cost_to_b <= cost_to_a ? b : a;
+    collapse->cost = cost_to_b <= cost_to_a ? cost_to_b : cost_to_a;
+  }
+
+  qsort(simplification->collapses, collapse_count, sizeof(struct Collapse), compare_collapses);
+  return collapse_count;
+}
+
+static void build_adjacency(struct Simplification* simplification,
+                            const uint32_t* indices,
+                            uint32_t index_count,
+                            uint32_t vertex_count)
+{
+  uint32_t* starts = simplification->adjacency_starts;
+  memset(starts, 0, sizeof(uint32_t) * (vertex_count + 1));
+  for (uint32_t index = 0; index < index_count; ++index)
+  {
+    ++starts[indices[index] + 1];
+  }
+
+  for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+  {
+    starts[vertex + 1] += starts[vertex];
+  }
+
+  // Use the starts as write cursors, which moves each of them onto the start of the next vertex
+  for (uint32_t index = 0; index < index_count; ++index)
+  {
+    simplification->adjacency[starts[indices[index]]++] = index / 3;
+  }
+
+  for (uint32_t vertex = vertex_count; vertex > 0; --vertex)
+  {
+    starts[vertex] = starts[vertex - 1];
+  }
+  starts[0] = 0;
+}
+
+// Checks whether moving from onto to turns any triangle of from around that does not collapse with the edge
+static bool flips_triangle(const struct Simplification* simplification,
+                           const uint32_t* indices,
+                           uint32_t from,
+                           uint32_t to)
+{
+  const uint32_t* remap = simplification->remap;
+  const uint32_t* starts = simplification->adjacency_starts;
+  for (uint32_t adjacent = starts[from]; adjacent < starts[from + 1]; ++adjacent)
+  {
+    const uint32_t* triangle = &indices[simplification->adjacency[adjacent] * 3];
+    const uint32_t corners[3] = { remap[triangle[0]], remap[triangle[1]], remap[triangle[2]] };
+    if (corners[0] == to || corners[1] == to || corners[2] == to)
+    {
+      continue;
+    }
+
+    const uint32_t moved[3] = { corners[0] == from ? to : corners[0], corners[1] == from ? to : corners[1],
+                                corners[2] == from ? to : corners[2] };
+
+    vec3 before, after;
+    get_triangle_normal(simplification, corners[0], corners[1], corners[2], before);
+    get_triangle_normal(simplification, moved[0], moved[1], moved[2], after);
+    if (glm_vec3_dot(before, after) <= 0.0f)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+uint32_t simplify(const uint32_t* indices,
+                  uint32_t index_count,
+                  const float* vertices,
+                  uint32_t floats_per_vertex,
+                  uint32_t vertex_count,
+                  uint32_t target_index_count,
+                  uint32_t* destination,
+                  float* error)
+{
+  index_count -= index_count % 3;
+  memcpy(destination, indices, sizeof(uint32_t) * index_count);
+  *error = 0.0f;
+
+  struct Simplification simplification;
+  simplification.vertices = vertices;
+  simplification.floats_per_vertex = floats_per_vertex;
+  simplification.quadrics = calloc(vertex_count > 0 ? vertex_count : 1, sizeof(struct Quadric));
+  simplification.locked = calloc(vertex_count > 0 ? vertex_count : 1, sizeof(bool));
+  simplification.touched = malloc(sizeof(bool) * (vertex_count > 0 ? vertex_count : 1));
+  simplification.remap = malloc(sizeof(uint32_t) * (vertex_count > 0 ? vertex_count : 1));
+  simplification.adjacency_starts = malloc(sizeof(uint32_t) * (vertex_count + 1));
+  simplification.adjacency = malloc(sizeof(uint32_t) * (index_count > 0 ? index_count : 1));
+  simplification.collapses = malloc(sizeof(struct Collapse) * (index_count > 0 ? index_count : 1));
+  if (!simplification.quadrics || !simplification.locked || !simplification.touched || !simplification.remap ||
+      !simplification.adjacency_starts || !simplification.adjacency || !simplification.collapses)
+  {
+    printf("Ran out of memory while simplifying %u triangles\n", index_count / 3);
+    target_index_count = index_count; // Leaves the triangles as they are
+  }
+  else
+  {
+    init_simplification(&simplification, destination, index_count, vertex_count);
+  }
+
+  // Collapses the cheapest edges in passes, as long as they do not involve vertices that already moved in the same pass
+  float max_cost = 0.0f;
+  while (index_count > target_index_count)
+  {
+    const uint32_t collapse_count = find_collapses(&simplification, destination, index_count);
+    build_adjacency(&simplification, destination, index_count, vertex_count);
+    memset(simplification.touched, 0, sizeof(bool) * vertex_count);
+
+    // Each collapse of an edge inside the mesh removes the two triangles along it
+    const uint32_t triangles_to_remove = (index_count - target_index_count + 2) / 3;
+    uint32_t removed = 0;
+    for (uint32_t index = 0; index < collapse_count && removed < triangles_to_remove; ++index)
+    {
+      const struct Collapse* collapse = &simplification.collapses[index];
+      if (simplification.touched[collapse->from] || simplification.touched[collapse->to] ||
+          flips_triangle(&simplification, destination, collapse->from, collapse->to))
+      {
+        continue;
+      }
+
+      simplification.remap[collapse->from] = collapse->to;
+      add_quadric(&simplification.quadrics[collapse->to], &simplification.quadrics[collapse->from]);
+      simplification.touched[collapse->from] = true;
+      simplification.touched[collapse->to] = true;
+      max_cost = fmaxf(max_cost, collapse->cost);
+      removed += 2;
+    }
+
+    if (removed == 0)
+    {
+      break;
+    }
+
+    // Apply the collapses and drop the triangles that collapsed with their edges
+    uint32_t kept = 0;
+    for (uint32_t index = 0; index < index_count; index += 3)
+    {
+      const uint32_t a = simplification.remap[destination[index]];
+      const uint32_t b = simplification.remap[destination[index + 1]];
+      const uint32_t c = simplification.remap[destination[index + 2]];
+      if (a != b && b != c && c != a)
+      {
+        destination[kept++] = a;
+        destination[kept++] = b;
+        destination[kept++] = c;
+      }
+    }
+
+    index_count = kept;
+  }
+
+  free(simplification.quadrics);
+  free(simplification.locked);
+  free(simplification.touched);
+  free(simplification.remap);
+  free(simplification.adjacency_starts);
+  free(simplification.adjacency);
+  free(simplification.collapses);
+
+  *error = sqrtf(max_cost);
+  return index_count;
+}
+
+// Bounding sphere around the center of the bounding box, which is close enough for picking levels of detail
+static void compute_bounds(struct Geometry* geometry)
+{
+  vec3 min = { FLT_MAX, FLT_MAX, FLT_MAX }, max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  for (uint32_t vertex = 0; vertex < geometry->vertex_count; ++vertex)
+  {
+    float* position = &geometry->vertices[vertex * geometry->floats_per_vertex];
+    glm_vec3_minv(min, position, min);
+    glm_vec3_maxv(max, position, max);
+  }
+
+  vec3 center = GLM_VEC3_ZERO_INIT;
+  if (geometry->vertex_count > 0)
+  {
+    glm_vec3_center(min, max, center);
+  }
+
+  float radius = 0.0f;
+  for (uint32_t vertex = 0; vertex < geometry->vertex_count; ++vertex)
+  {
+    radius = fmaxf(radius, glm_vec3_distance(center, &geometry->vertices[vertex * geometry->floats_per_vertex]));
+  }
+
+  glm_vec3_copy(center, geometry->lods.bounds_center);
+  geometry->lods.bounds_radius = radius;
+}
+
+// Returns the number of vertices each submesh uses from its base vertex on
+static uint32_t get_submesh_vertex_count(const struct Geometry* geometry, const struct Submesh* submesh)
+{
+  uint32_t vertex_count = 0;
+  for (uint32_t index = submesh->first_index; index < submesh->first_index + submesh->index_count; ++index)
+  {
+    vertex_count = geometry->indices[index] + 1 > vertex_count ? geometry->indices[index] + 1 : vertex_count;
+  }
+
+  return vertex_count;
+}
+
+bool generate_lods(struct Geometry* geometry)
+{
+  compute_bounds(geometry);
+  geometry->lods.lod_count = 1;
+  geometry->lods.errors[0] = 0.0f;
+
+  const uint32_t full_index_count = geometry->index_count;
+  uint32_t previous_index_count = full_index_count;
+  while (geometry->lods.lod_count < MAX_LOD_COUNT)
+  {
+    const uint32_t lod = geometry->lods.lod_count;
+    const uint32_t submesh_count = geometry->submesh_count;
+
+    // Room for the next level in the worst case that nothing simplifies
+    uint32_t* indices = realloc(geometry->indices, sizeof(uint32_t) * (geometry->index_count + full_index_count));
+    if (!indices)
+    {
+      printf("Ran out of memory while generating levels of detail\n");
+      return false;
+    }
+    geometry->indices = indices;
+
+    struct Submesh* submeshes = realloc(geometry->submeshes, sizeof(struct Submesh) * submesh_count * (lod + 1));
+    if (!submeshes)
+    {
+      printf("Ran out of memory while generating levels of detail\n");
+      return false;
+    }
+    geometry->submeshes = submeshes;
+
+    // Every level is simplified from the full mesh, so that its error is measured against the full mesh as well
+    uint32_t index_count = 0;
+    float error = 0.0f;
+    for (uint32_t index = 0; index < submesh_count; ++index)
+    {
+      const struct Submesh* full = &geometry->submeshes[index];
+      struct Submesh* simplified = &geometry->submeshes[lod * submesh_count + index];
+      const uint32_t vertex_count = get_submesh_vertex_count(geometry, full);
+      const uint32_t target_index_count = (full->index_count >> lod) / 3 * 3;
+
+      float submesh_error;
+      *simplified = *full;
+      simplified->first_index = geometry->index_count + index_count;
+      simplified->index_count = simplify(&geometry->indices[full->first_index], full->index_count,
+                                         &geometry->vertices[full->base_vertex * geometry->floats_per_vertex],
+                                         geometry->floats_per_vertex, vertex_count, target_index_count,
+                                         &geometry->indices[simplified->first_index], &submesh_error);
+
+      // Simplification keeps the order of the triangles, which is not the best one for the vertex cache any more
+      if (!optimize_vertex_cache(&geometry->indices[simplified->first_index], simplified->index_count, vertex_count))
+      {
+        return false;
+      }
+
+      index_count += simplified->index_count;
+      error = fmaxf(error, submesh_error);
+    }
+
+    if ((float)index_count > (float)previous_index_count * LOD_MIN_REDUCTION)
+    {
+      break;
+    }
+
+    geometry->index_count += index_count;
+    geometry->lods.errors[lod] = error;
+    ++geometry->lods.lod_count;
+    previous_index_count = index_count;
+  }
+
+  return true;
+}
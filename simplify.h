@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct Geometry;
+
+// Simplifies a triangle list with the quadric error metric of Garland and Heckbert, collapsing edges onto one of their
+// vertices so that the remaining vertices keep their attributes
+// Vertices on open borders, which includes the seams where differing attributes split a vertex, never move
+// Writes at most index_count indices to destination and returns how many, stopping once target_index_count is reached
+// or nothing else can be collapsed, error is the largest distance of the result from the original surface
+uint32_t simplify(const uint32_t* indices,
+                  uint32_t index_count,
+                  const float* vertices,
+                  uint32_t floats_per_vertex,
+                  uint32_t vertex_count,
+                  uint32_t target_index_count,
+                  uint32_t* destination,
+                  float* error);
+
+// Appends up to MAX_LOD_COUNT - 1 levels of detail with half the triangles of the previous one each to triangle
+// geometry that is still in CPU memory and has no levels of detail yet, and computes its bounding sphere
+// Stops early once a level does not get much smaller than the previous one
+bool generate_lods(struct Geometry* geometry);
@@ -1,20 +1,109 @@
 #include "texture.h"
 
+#include "cooked_texture.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-bool load_texture(const char* filename, GLuint* texture)
+// From EXT_texture_compression_s3tc, which every desktop driver has even though it never became core
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+  #define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+  #define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Either cooked and block-compressed or decoded, depending on what the driver takes
+struct TextureData
 {
+  struct CookedTexture* cooked;
+  stbi_uc* pixels;
   int width, height, channels;
-  stbi_uc* data = stbi_load(filename, &width, &height, &channels, 0);
+};
+
+bool has_compressed_textures()
+{
+  static int supported = -1; // Not checked yet
+  if (supported < 0)
+  {
+    supported = false;
+
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for (GLint extension = 0; extension < extension_count && !supported; ++extension)
+    {
+      const char* name = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)extension);
+      supported = name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0;
+    }
+
+    if (!supported)
+    {
+      printf("Block-compressed textures are not supported, loading them uncompressed instead\n");
+    }
+  }
+
+  return supported;
+}
+
+struct TextureData* load_texture_data(const char* filename, bool compressed)
+{
+  struct TextureData* data = calloc(1, sizeof(struct TextureData));
   if (!data)
+  {
+    printf("Ran out of memory while loading texture \"%s\"\n", filename);
+    return NULL;
+  }
+
+  if (compressed)
+  {
+    data->cooked = load_cooked_texture(filename);
+    if (!data->cooked)
+    {
+      free(data);
+      return NULL;
+    }
+
+    return data;
+  }
+
+  // Decoded as it is, the driver builds the mips
+  data->pixels = stbi_load(filename, &data->width, &data->height, &data->channels, 0);
+  if (!data->pixels)
   {
     printf("Failed to load texture \"%s\"\n", filename);
-    return false;
+    free(data);
+    return NULL;
+  }
+
+  if (data->channels != 1 && data->channels != 3 && data->channels != 4)
+  {
+    printf("Texture \"%s\" has invalid channel count %d, expected 1, 3 or 4\n", filename, data->channels);
+    destroy_texture_data(data);
+    return NULL;
   }
 
+  return data;
+}
+
+void destroy_texture_data(struct TextureData* data)
+{
+  if (data->cooked)
+  {
+    destroy_cooked_texture(data->cooked);
+  }
+
+  if (data->pixels)
+  {
+    stbi_image_free(data->pixels);
+  }
+
+  free(data);
+}
+
+void upload_texture(const struct TextureData* data, GLuint* texture)
+{
   glGenTextures(1, texture);
   glBindTexture(GL_TEXTURE_2D, *texture);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -22,30 +111,43 @@ bool load_texture(const char* filename, GLuint* texture)
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-  GLenum format;
-  if (channels == 1)
+  if (!data->cooked)
   {
-    format = GL_RED;
-  }
-  else if (channels == 3)
-  {
-    format = GL_RGB;
+    const GLenum formats[] = { GL_RED, GL_RED, GL_RGB, GL_RGB, GL_RGBA };
+    const GLenum format = formats[data->channels];
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Rows of RGB and single channel images are not padded to 4 bytes
+    glTexImage2D(GL_TEXTURE_2D, 0, (GLint)format, data->width, data->height, 0, format, GL_UNSIGNED_BYTE, data->pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    return;
   }
-  else if (channels == 4)
+
+  // Straight from the cooked texture to the GPU, with all of its mips
+  const struct CookedTexture* cooked = data->cooked;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)cooked->mip_count - 1);
+
+  const GLenum format = cooked->format == TEXTURE_FORMAT_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+                                                             : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  for (uint32_t mip = 0; mip < cooked->mip_count; ++mip)
   {
-    format = GL_RGBA;
+    const GLsizei width = (GLsizei)(cooked->width >> mip > 0 ? cooked->width >> mip : 1);
+    const GLsizei height = (GLsizei)(cooked->height >> mip > 0 ? cooked->height >> mip : 1);
+    glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)mip, format, width, height, 0, (GLsizei)cooked->mip_sizes[mip],
+                           cooked->mips[mip]);
   }
-  else
+}
+
+bool load_texture(const char* filename, GLuint* texture)
+{
+  struct TextureData* data = load_texture_data(filename, has_compressed_textures());
+  if (!data)
   {
-    printf("Texture \"%s\" has invalid channel count %d, expected 1, 3 or 4\n", filename, channels);
-    stbi_image_free(data);
     return false;
   }
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-  glGenerateMipmap(GL_TEXTURE_2D);
-
-  stbi_image_free(data);
+  upload_texture(data, texture);
+  destroy_texture_data(data);
 
   return true;
 }
@@ -4,5 +4,16 @@
 
 #include <stdbool.h>
 
+struct TextureData;
+
+// Whether the driver takes block-compressed textures, see cooked_texture.h, needs the OpenGL context
+bool has_compressed_textures();
+
+// Loads a texture into memory, either cooked or decoded, without the OpenGL context so that it can happen on any thread
+struct TextureData* load_texture_data(const char* filename, bool compressed);
+void destroy_texture_data(struct TextureData* data);
+void upload_texture(const struct TextureData* data, GLuint* texture);
+
+// Loads and uploads a texture in one go, compressed if the driver takes it
 bool load_texture(const char* filename, GLuint* texture);
 void destroy_texture(GLuint texture);
@@ -0,0 +1,185 @@
+#include "thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+
+struct ThreadStart
+{
+  ThreadFunction function;
+  void* data;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI thread_entry(LPVOID parameter)
+#else
+static void* thread_entry(void* parameter)
+#endif
+{
+  struct ThreadStart start = *(struct ThreadStart*)parameter;
+  free(parameter);
+
+  start.function(start.data);
+
+  return 0;
+}
+
+bool start_thread(Thread* thread, ThreadFunction function, void* data)
+{
+  struct ThreadStart* start = malloc(sizeof(struct ThreadStart));
+  if (!start)
+  {
+    printf("Ran out of memory while starting thread\n");
+    return false;
+  }
+
+  start->function = function;
+  start->data = data;
+
+#ifdef _WIN32
+  *thread = CreateThread(NULL, 0, thread_entry, start, 0, NULL);
+  if (!*thread)
+#else
+  if (pthread_create(thread, NULL, thread_entry, start) != 0)
+#endif
+  {
+    printf("Failed to start thread\n");
+    free(start);
+    return false;
+  }
+
+  return true;
+}
+
+void join_thread(Thread thread)
+{
+#ifdef _WIN32
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  pthread_join(thread, NULL);
+#endif
+}
+
+void init_mutex(Mutex* mutex)
+{
+#ifdef _WIN32
+  InitializeSRWLock((PSRWLOCK)&mutex->lock);
+#else
+  pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void destroy_mutex(Mutex* mutex)
+{
+#ifndef _WIN32
+  pthread_mutex_destroy(mutex);
+#endif
+}
+
+void lock_mutex(Mutex* mutex)
+{
+#ifdef _WIN32
+  AcquireSRWLockExclusive((PSRWLOCK)&mutex->lock);
+#else
+  pthread_mutex_lock(mutex);
+#endif
+}
+
+void unlock_mutex(Mutex* mutex)
+{
+#ifdef _WIN32
+  ReleaseSRWLockExclusive((PSRWLOCK)&mutex->lock);
+#else
+  pthread_mutex_unlock(mutex);
+#endif
+}
+
+void init_condition(Condition* condition)
+{
+#ifdef _WIN32
+  InitializeConditionVariable((PCONDITION_VARIABLE)&condition->condition);
+#else
+  pthread_cond_init(condition, NULL);
+#endif
+}
+
+void destroy_condition(Condition* condition)
+{
+#ifndef _WIN32
+  pthread_cond_destroy(condition);
+#endif
+}
+
+void wait_condition(Condition* condition, Mutex* mutex)
+{
+#ifdef _WIN32
+  SleepConditionVariableSRW((PCONDITION_VARIABLE)&condition->condition, (PSRWLOCK)&mutex->lock, INFINITE, 0);
+#else
+  pthread_cond_wait(condition, mutex);
+#endif
+}
+
+void signal_condition(Condition* condition)
+{
+#ifdef _WIN32
+  WakeConditionVariable((PCONDITION_VARIABLE)&condition->condition);
+#else
+  pthread_cond_signal(condition);
+#endif
+}
+
+void broadcast_condition(Condition* condition)
+{
+#ifdef _WIN32
+  WakeAllConditionVariable((PCONDITION_VARIABLE)&condition->condition);
+#else
+  pthread_cond_broadcast(condition);
+#endif
+}
+
+uint32_t get_cpu_count()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  const long count = (long)info.dwNumberOfProcessors;
+#else
+  const long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+  return count > 0 ? (uint32_t)count : 1;
+}
+
+uint32_t atomic_add_u32(volatile uint32_t* target, uint32_t value)
+{
+#ifdef _WIN32
+  return (uint32_t)InterlockedExchangeAdd((volatile LONG*)target, (LONG)value);
+#else
+  return __atomic_fetch_add(target, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+uint32_t atomic_load_u32(volatile uint32_t* target)
+{
+#ifdef _WIN32
+  return (uint32_t)InterlockedOr((volatile LONG*)target, 0);
+#else
+  return __atomic_load_n(target, __ATOMIC_SEQ_CST);
+#endif
+}
+
+void atomic_store_u32(volatile uint32_t* target, uint32_t value)
+{
+#ifdef _WIN32
+  InterlockedExchange((volatile LONG*)target, (LONG)value);
+#else
+  __atomic_store_n(target, value, __ATOMIC_SEQ_CST);
+#endif
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+// Pointer-sized stand-ins for HANDLE, SRWLOCK and CONDITION_VARIABLE, so that windows.h stays out of this header
+typedef void* Thread;
+typedef struct
+{
+  void* lock;
+} Mutex;
+typedef struct
+{
+  void* condition;
+} Condition;
+
+  #define THREAD_LOCAL __declspec(thread)
+#else
+  #include <pthread.h>
+
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Condition;
+
+  #define THREAD_LOCAL _Thread_local
+#endif
+
+typedef void (*ThreadFunction)(void* data);
+
+bool start_thread(Thread* thread, ThreadFunction function, void* data);
+void join_thread(Thread thread);
+
+void init_mutex(Mutex* mutex);
+void destroy_mutex(Mutex* mutex);
+void lock_mutex(Mutex* mutex);
+void unlock_mutex(Mutex* mutex);
+
+void init_condition(Condition* condition);
+void destroy_condition(Condition* condition);
+void wait_condition(Condition* condition, Mutex* mutex);
+void signal_condition(Condition* condition);
+void broadcast_condition(Condition* condition);
+
+uint32_t get_cpu_count();
+
+// Atomically adds value to target and returns the previous value
+uint32_t atomic_add_u32(volatile uint32_t* target, uint32_t value);
+uint32_t atomic_load_u32(volatile uint32_t* target);
+void atomic_store_u32(volatile uint32_t* target, uint32_t value);
@@ -0,0 +1,16 @@
+#include "transform.h"
+
+#include <cglm/mat4.h>
+#include <cglm/quat.h>
+#include <cglm/vec3.h>
+
+void interpolate_transform(const mat4 previous, const mat4 current, float alpha, mat4 dest)
+{
+  versor previous_rotation, rotation;
+  glm_mat4_quat((vec4*)previous, previous_rotation);
+  glm_mat4_quat((vec4*)current, rotation);
+  glm_quat_slerp(previous_rotation, rotation, alpha, rotation);
+  glm_quat_mat4(rotation, dest);
+
+  glm_vec3_lerp((float*)previous[3], (float*)current[3], alpha, dest[3]);
+}
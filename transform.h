@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cglm/types.h>
+
+// Interpolates between the transform before and after the last update, alpha is the fraction of the way in between
+// Both have to be only a rotation and a translation, which are interpolated separately
+void interpolate_transform(const mat4 previous, const mat4 current, float alpha, mat4 dest);
@@ -22,8 +22,7 @@ static void window_resize_callback(GLFWwindow* window, int width_, int height_)
   height = height_;
 
   // Update the camera projection matrix
-  const float aspect = (float)width / (float)height;
-  update_proj_matrix(aspect);
+  update_proj_matrix((float)width, (float)height);
 }
 
 static void framebuffer_resize_callback(GLFWwindow* window, int width, int height)